@@ -0,0 +1,548 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "ast_cache.h"
+#include "entity_ast.h"
+#include "error.h"
+#include "game_ast.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ========= Writer ==========
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} CacheWriter;
+
+#define OFFSET(type, offset) ((type)(uintptr_t)(offset))
+
+// Every record starts on this boundary; the loader rejects anything else.
+#define CACHE_ALIGN 8
+
+static uint64_t put(CacheWriter* w, const void* bytes, size_t size) {
+    size_t aligned = (w->length + CACHE_ALIGN - 1) & ~(size_t)(CACHE_ALIGN - 1);
+    while (aligned + size > w->capacity) {
+        w->capacity *= 2;
+        char* new_data = realloc(w->data, w->capacity);
+        if (!new_data) error(error_messages[ERROR_REALLOCFAIL].message);
+        w->data = new_data;
+    }
+    memset(w->data + w->length, 0, aligned - w->length);
+    memcpy(w->data + aligned, bytes, size);
+    w->length = aligned + size;
+    return aligned;
+}
+
+static uint64_t put_string(CacheWriter* w, const char* str) {
+    if (!str) return 0;
+    return put(w, str, strlen(str) + 1);
+}
+
+static Token put_token(CacheWriter* w, Token token) {
+    token.lexeme = OFFSET(char*, put_string(w, token.lexeme));
+    if (token.literal.type == LITERAL_STRING) {
+        token.literal.as.string = OFFSET(char*, put_string(w, token.literal.as.string));
+    }
+    return token;
+}
+
+static uint64_t put_expr(CacheWriter* w, Expr* expr);
+static uint64_t put_stmt(CacheWriter* w, Stmt* stmt);
+
+static uint64_t put_expr(CacheWriter* w, Expr* expr) {
+    if (!expr) return 0;
+    Expr copy = *expr;
+
+    switch (expr->type) {
+        case EXPR_BINARY:
+            copy.as.binary.left = OFFSET(Expr*, put_expr(w, expr->as.binary.left));
+            copy.as.binary.oprt = put_token(w, expr->as.binary.oprt);
+            copy.as.binary.right = OFFSET(Expr*, put_expr(w, expr->as.binary.right));
+            break;
+        case EXPR_UNARY:
+            copy.as.unary.oprt = put_token(w, expr->as.unary.oprt);
+            copy.as.unary.right = OFFSET(Expr*, put_expr(w, expr->as.unary.right));
+            break;
+        case EXPR_LITERAL:
+            if (expr->as.literal.value.type == LITERAL_STRING) {
+                copy.as.literal.value.as.string = OFFSET(char*, put_string(w, expr->as.literal.value.as.string));
+            }
+            break;
+        case EXPR_GROUPING:
+            copy.as.grouping.expression = OFFSET(Expr*, put_expr(w, expr->as.grouping.expression));
+            break;
+        case EXPR_VARIABLE:
+            copy.as.variable.name = put_token(w, expr->as.variable.name);
+            break;
+        case EXPR_ASSIGN:
+            copy.as.assign.name = put_token(w, expr->as.assign.name);
+            copy.as.assign.value = OFFSET(Expr*, put_expr(w, expr->as.assign.value));
+            break;
+        case EXPR_GET:
+            copy.as.get.object = OFFSET(Expr*, put_expr(w, expr->as.get.object));
+            copy.as.get.name = put_token(w, expr->as.get.name);
+            break;
+        case EXPR_SET:
+            copy.as.set.object = OFFSET(Expr*, put_expr(w, expr->as.set.object));
+            copy.as.set.name = put_token(w, expr->as.set.name);
+            copy.as.set.value = OFFSET(Expr*, put_expr(w, expr->as.set.value));
+            break;
+        case EXPR_CALL: {
+            copy.as.call.callee = OFFSET(Expr*, put_expr(w, expr->as.call.callee));
+            uintptr_t* args = malloc(sizeof(uintptr_t) * (expr->as.call.argc + 1));
+            if (!args) error(error_messages[ERROR_MALLOCFAIL].message);
+            for (int i = 0; i < expr->as.call.argc; i++) {
+                args[i] = put_expr(w, expr->as.call.argv[i]);
+            }
+            copy.as.call.argv = expr->as.call.argc > 0
+                ? OFFSET(Expr**, put(w, args, sizeof(uintptr_t) * expr->as.call.argc))
+                : NULL;
+            free(args);
+            break;
+        }
+    }
+
+    return put(w, &copy, sizeof(Expr));
+}
+
+static uint64_t put_stmt_array(CacheWriter* w, Stmt** statements, int count) {
+    if (count == 0) return 0;
+    uintptr_t* offsets = malloc(sizeof(uintptr_t) * count);
+    if (!offsets) error(error_messages[ERROR_MALLOCFAIL].message);
+    for (int i = 0; i < count; i++) {
+        offsets[i] = put_stmt(w, statements[i]);
+    }
+    uint64_t at = put(w, offsets, sizeof(uintptr_t) * count);
+    free(offsets);
+    return at;
+}
+
+static uint64_t put_stmt(CacheWriter* w, Stmt* stmt) {
+    if (!stmt) return 0;
+    Stmt copy = *stmt;
+
+    switch (stmt->type) {
+        case STMT_EXPRESSION:
+            copy.as.expr.expr = OFFSET(Expr*, put_expr(w, stmt->as.expr.expr));
+            break;
+        case STMT_PRINT:
+            copy.as.print.expr = OFFSET(Expr*, put_expr(w, stmt->as.print.expr));
+            break;
+        case STMT_VAR:
+            copy.as.var.name = put_token(w, stmt->as.var.name);
+            copy.as.var.initializer = OFFSET(Expr*, put_expr(w, stmt->as.var.initializer));
+            break;
+        case STMT_BLOCK:
+            copy.as.block.statements = OFFSET(Stmt**, put_stmt_array(w, stmt->as.block.statements, stmt->as.block.count));
+            break;
+        case STMT_IF:
+            copy.as.if_stmt.condition = OFFSET(Expr*, put_expr(w, stmt->as.if_stmt.condition));
+            copy.as.if_stmt.then_branch = OFFSET(Stmt*, put_stmt(w, stmt->as.if_stmt.then_branch));
+            copy.as.if_stmt.else_branch = OFFSET(Stmt*, put_stmt(w, stmt->as.if_stmt.else_branch));
+            break;
+        case STMT_WHILE:
+            copy.as.while_stmt.condition = OFFSET(Expr*, put_expr(w, stmt->as.while_stmt.condition));
+            copy.as.while_stmt.body = OFFSET(Stmt*, put_stmt(w, stmt->as.while_stmt.body));
+            break;
+    }
+
+    return put(w, &copy, sizeof(Stmt));
+}
+
+static uint64_t put_entity(CacheWriter* w, EntityDecl* entity) {
+    EntityDecl copy = *entity;
+    copy.name = put_token(w, entity->name);
+
+    EntityField* fields = malloc(sizeof(EntityField) * (entity->field_count + 1));
+    if (!fields) error(error_messages[ERROR_MALLOCFAIL].message);
+    for (int i = 0; i < entity->field_count; i++) {
+        fields[i] = entity->fields[i];
+        fields[i].name = put_token(w, entity->fields[i].name);
+    }
+    copy.fields = entity->field_count > 0
+        ? OFFSET(EntityField*, put(w, fields, sizeof(EntityField) * entity->field_count))
+        : NULL;
+    free(fields);
+
+    copy.init = OFFSET(Stmt*, put_stmt(w, entity->init));
+    copy.on_create = OFFSET(Stmt*, put_stmt(w, entity->on_create));
+    copy.on_update = OFFSET(Stmt*, put_stmt(w, entity->on_update));
+    copy.on_destroy = OFFSET(Stmt*, put_stmt(w, entity->on_destroy));
+    copy.on_collision = OFFSET(Stmt*, put_stmt(w, entity->on_collision));
+    copy.collision_param = put_token(w, entity->collision_param);
+    copy.path = NULL; // same source can live at several paths
+
+    return put(w, &copy, sizeof(EntityDecl));
+}
+
+static uint64_t put_game(CacheWriter* w, GameDecl* game) {
+    if (!game) return 0;
+    GameDecl copy = *game;
+
+    SpawnCall* spawns = malloc(sizeof(SpawnCall) * (game->spawn_count + 1));
+    if (!spawns) error(error_messages[ERROR_MALLOCFAIL].message);
+    for (int i = 0; i < game->spawn_count; i++) {
+        spawns[i] = game->spawns[i];
+        spawns[i].entity_name = put_token(w, game->spawns[i].entity_name);
+    }
+    copy.spawns = game->spawn_count > 0
+        ? OFFSET(SpawnCall*, put(w, spawns, sizeof(SpawnCall) * game->spawn_count))
+        : NULL;
+    free(spawns);
+
+    return put(w, &copy, sizeof(GameDecl));
+}
+
+void ast_cache_path(char* out, size_t size, const char* cache_dir, uint64_t source_hash) {
+    snprintf(out, size, "%s/%016llx.wskc", cache_dir, (unsigned long long)source_hash);
+}
+
+void ast_cache_store(const char* path, uint64_t source_hash, Program* program) {
+    CacheWriter w = { .data = malloc(4096), .length = 0, .capacity = 4096 };
+    if (!w.data) error(error_messages[ERROR_MALLOCFAIL].message);
+
+    AstCacheHeader header = {0};
+    put(&w, &header, sizeof(header));
+
+    Program copy = *program;
+    copy.statements = OFFSET(Stmt**, put_stmt_array(&w, program->statements, program->count));
+
+    uintptr_t* entities = malloc(sizeof(uintptr_t) * (program->entity_count + 1));
+    if (!entities) error(error_messages[ERROR_MALLOCFAIL].message);
+    for (int i = 0; i < program->entity_count; i++) {
+        entities[i] = put_entity(&w, program->entities[i]);
+    }
+    copy.entities = program->entity_count > 0
+        ? OFFSET(EntityDecl**, put(&w, entities, sizeof(uintptr_t) * program->entity_count))
+        : NULL;
+    free(entities);
+
+    copy.game = OFFSET(GameDecl*, put_game(&w, program->game));
+
+    Token* imports = malloc(sizeof(Token) * (program->import_count + 1));
+    if (!imports) error(error_messages[ERROR_MALLOCFAIL].message);
+    for (int i = 0; i < program->import_count; i++) {
+        imports[i] = put_token(&w, program->imports[i]);
+    }
+    copy.imports = program->import_count > 0
+        ? OFFSET(Token*, put(&w, imports, sizeof(Token) * program->import_count))
+        : NULL;
+    free(imports);
+
+    copy.mapped = NULL;
+    copy.mapped_size = 0;
+
+    memcpy(header.magic, "WSKC", 4);
+    header.version = AST_CACHE_VERSION;
+    header.pointer_size = sizeof(void*);
+    header.source_hash = source_hash;
+    header.program = put(&w, &copy, sizeof(Program));
+    header.size = w.length;
+    memcpy(w.data, &header, sizeof(header));
+
+    // Write next to the target and rename, so a reader never sees half a file.
+    char tmp_path[1024];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.%p.tmp", path, (long)getpid(), (void*)w.data);
+
+    FILE* f = fopen(tmp_path, "wb");
+    if (f) {
+        size_t written = fwrite(w.data, 1, w.length, f);
+        fclose(f);
+        if (written != w.length || rename(tmp_path, path) != 0) {
+            remove(tmp_path);
+        }
+    }
+
+    free(w.data);
+}
+
+// ========= Loader ==========
+
+typedef struct {
+    char* base;
+    size_t size;
+    bool ok;
+} Relocator;
+
+// True when `count` elements of `elem` bytes starting at the aligned `offset`
+// lie inside the mapping. A zero offset is NULL: fine for an optional node or an empty
+// array, corrupt anywhere else.
+static bool extent_ok(Relocator* r, uintptr_t offset, long count, size_t elem, bool nullable) {
+    if (count < 0) return false;
+    if (offset == 0) return nullable || count == 0;
+    if (offset < sizeof(AstCacheHeader) || offset >= r->size || offset % CACHE_ALIGN != 0) return false;
+    return (size_t)count <= (r->size - offset) / elem;
+}
+
+// Turn a stored offset back into a pointer, rejecting any extent that would
+// reach outside the mapping.
+#define RELOCATE_EXTENT(r, field, count, nullable) do { \
+    uintptr_t offset_ = (uintptr_t)(field); \
+    if (!(r)->ok || !extent_ok((r), offset_, (count), sizeof(*(field)), (nullable))) { \
+        (r)->ok = false; (field) = NULL; \
+    } else if (offset_ != 0) { (field) = (void*)((r)->base + offset_); } \
+} while (0)
+
+#define RELOCATE(r, field) RELOCATE_EXTENT(r, field, 1, true)
+#define RELOCATE_REQUIRED(r, field) RELOCATE_EXTENT(r, field, 1, false)
+#define RELOCATE_ARRAY(r, field, count) RELOCATE_EXTENT(r, field, count, false)
+
+// Strings must end inside the mapping.
+static void relocate_string(Relocator* r, char** field) {
+    uintptr_t offset = (uintptr_t)*field;
+    if (!r->ok || !extent_ok(r, offset, 1, 1, true) ||
+        (offset != 0 && !memchr(r->base + offset, '\0', r->size - offset))) {
+        r->ok = false;
+        *field = NULL;
+    } else if (offset != 0) {
+        *field = r->base + offset;
+    }
+}
+
+// Stored bools must be 0 or 1; anything else is undefined to read as bool.
+static void check_bool(Relocator* r, const bool* value) {
+    unsigned char byte;
+    memcpy(&byte, value, 1);
+    if (byte > 1) r->ok = false;
+}
+
+static void fix_literal(Relocator* r, Literal* literal) {
+    if (literal->type == LITERAL_STRING) {
+        relocate_string(r, &literal->as.string);
+    } else if (literal->type == LITERAL_BOOLEAN) {
+        check_bool(r, &literal->as.boolean);
+    }
+}
+
+static void fix_token(Relocator* r, Token* token) {
+    relocate_string(r, &token->lexeme);
+    if (!token->lexeme) r->ok = false;
+    fix_literal(r, &token->literal);
+}
+
+// A token the parser may leave zeroed, like an absent collision parameter.
+static void fix_optional_token(Relocator* r, Token* token) {
+    relocate_string(r, &token->lexeme);
+    fix_literal(r, &token->literal);
+}
+
+static void fix_stmt(Relocator* r, Stmt* stmt);
+
+static void fix_expr(Relocator* r, Expr* expr) {
+    if (!expr || !r->ok) return;
+
+    switch (expr->type) {
+        case EXPR_BINARY:
+            RELOCATE_REQUIRED(r, expr->as.binary.left);
+            RELOCATE_REQUIRED(r, expr->as.binary.right);
+            fix_token(r, &expr->as.binary.oprt);
+            fix_expr(r, expr->as.binary.left);
+            fix_expr(r, expr->as.binary.right);
+            break;
+        case EXPR_UNARY:
+            RELOCATE_REQUIRED(r, expr->as.unary.right);
+            fix_token(r, &expr->as.unary.oprt);
+            fix_expr(r, expr->as.unary.right);
+            break;
+        case EXPR_LITERAL:
+            fix_literal(r, &expr->as.literal.value);
+            check_bool(r, &expr->as.literal.integer);
+            break;
+        case EXPR_GROUPING:
+            RELOCATE_REQUIRED(r, expr->as.grouping.expression);
+            fix_expr(r, expr->as.grouping.expression);
+            break;
+        case EXPR_VARIABLE:
+            fix_token(r, &expr->as.variable.name);
+            break;
+        case EXPR_ASSIGN:
+            fix_token(r, &expr->as.assign.name);
+            RELOCATE_REQUIRED(r, expr->as.assign.value);
+            fix_expr(r, expr->as.assign.value);
+            break;
+        case EXPR_GET:
+            fix_token(r, &expr->as.get.name);
+            RELOCATE_REQUIRED(r, expr->as.get.object);
+            fix_expr(r, expr->as.get.object);
+            break;
+        case EXPR_SET:
+            fix_token(r, &expr->as.set.name);
+            RELOCATE_REQUIRED(r, expr->as.set.object);
+            RELOCATE_REQUIRED(r, expr->as.set.value);
+            fix_expr(r, expr->as.set.object);
+            fix_expr(r, expr->as.set.value);
+            break;
+        case EXPR_CALL:
+            RELOCATE_REQUIRED(r, expr->as.call.callee);
+            RELOCATE_ARRAY(r, expr->as.call.argv, expr->as.call.argc);
+            fix_expr(r, expr->as.call.callee);
+            for (int i = 0; i < expr->as.call.argc && r->ok; i++) {
+                RELOCATE_REQUIRED(r, expr->as.call.argv[i]);
+                fix_expr(r, expr->as.call.argv[i]);
+            }
+            break;
+        default:
+            r->ok = false;
+            break;
+    }
+}
+
+static void fix_stmt_array(Relocator* r, Stmt** statements, int count) {
+    for (int i = 0; i < count && r->ok; i++) {
+        RELOCATE_REQUIRED(r, statements[i]);
+        fix_stmt(r, statements[i]);
+    }
+}
+
+static void fix_stmt(Relocator* r, Stmt* stmt) {
+    if (!stmt || !r->ok) return;
+
+    switch (stmt->type) {
+        case STMT_EXPRESSION:
+            RELOCATE_REQUIRED(r, stmt->as.expr.expr);
+            fix_expr(r, stmt->as.expr.expr);
+            break;
+        case STMT_PRINT:
+            RELOCATE_REQUIRED(r, stmt->as.print.expr);
+            fix_expr(r, stmt->as.print.expr);
+            break;
+        case STMT_VAR:
+            fix_token(r, &stmt->as.var.name);
+            RELOCATE(r, stmt->as.var.initializer);
+            fix_expr(r, stmt->as.var.initializer);
+            break;
+        case STMT_BLOCK:
+            RELOCATE_ARRAY(r, stmt->as.block.statements, stmt->as.block.count);
+            fix_stmt_array(r, stmt->as.block.statements, stmt->as.block.count);
+            break;
+        case STMT_IF:
+            RELOCATE_REQUIRED(r, stmt->as.if_stmt.condition);
+            RELOCATE_REQUIRED(r, stmt->as.if_stmt.then_branch);
+            RELOCATE(r, stmt->as.if_stmt.else_branch);
+            fix_expr(r, stmt->as.if_stmt.condition);
+            fix_stmt(r, stmt->as.if_stmt.then_branch);
+            fix_stmt(r, stmt->as.if_stmt.else_branch);
+            break;
+        case STMT_WHILE:
+            RELOCATE_REQUIRED(r, stmt->as.while_stmt.condition);
+            RELOCATE_REQUIRED(r, stmt->as.while_stmt.body);
+            fix_expr(r, stmt->as.while_stmt.condition);
+            fix_stmt(r, stmt->as.while_stmt.body);
+            break;
+        default:
+            r->ok = false;
+            break;
+    }
+}
+
+static void fix_entity(Relocator* r, EntityDecl* entity) {
+    check_bool(r, &entity->pooled);
+    check_bool(r, &entity->singleton);
+    fix_token(r, &entity->name);
+    RELOCATE_ARRAY(r, entity->fields, entity->field_count);
+    for (int i = 0; i < entity->field_count && r->ok; i++) {
+        fix_token(r, &entity->fields[i].name);
+    }
+
+    RELOCATE(r, entity->init);
+    RELOCATE(r, entity->on_create);
+    RELOCATE(r, entity->on_update);
+    RELOCATE(r, entity->on_destroy);
+    RELOCATE(r, entity->on_collision);
+    fix_stmt(r, entity->init);
+    fix_stmt(r, entity->on_create);
+    fix_stmt(r, entity->on_update);
+    fix_stmt(r, entity->on_destroy);
+    fix_stmt(r, entity->on_collision);
+    fix_optional_token(r, &entity->collision_param);
+    entity->path = NULL; // never stored, set again by the module loader
+}
+
+static void fix_game(Relocator* r, GameDecl* game) {
+    if (!game) return;
+    RELOCATE_ARRAY(r, game->spawns, game->spawn_count);
+    for (int i = 0; i < game->spawn_count && r->ok; i++) {
+        fix_token(r, &game->spawns[i].entity_name);
+    }
+}
+
+bool ast_cache_load(const char* path, uint64_t source_hash, Program* out) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(AstCacheHeader)) {
+        close(fd);
+        return false;
+    }
+
+    // Private writable mapping: fix-ups and later passes copy-on-write pages
+    // without ever touching the file.
+    size_t size = st.st_size;
+    char* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return false;
+
+    AstCacheHeader* header = (AstCacheHeader*)base;
+    if (memcmp(header->magic, "WSKC", 4) != 0 ||
+        header->version != AST_CACHE_VERSION ||
+        header->pointer_size != sizeof(void*) ||
+        header->source_hash != source_hash ||
+        header->size != size) {
+        munmap(base, size);
+        return false;
+    }
+
+    Relocator r = { .base = base, .size = size, .ok = true };
+    if (!extent_ok(&r, header->program, 1, sizeof(Program), false)) {
+        munmap(base, size);
+        return false;
+    }
+    Program* program = (Program*)(base + header->program);
+
+    RELOCATE_ARRAY(&r, program->statements, program->count);
+    fix_stmt_array(&r, program->statements, program->count);
+
+    RELOCATE_ARRAY(&r, program->entities, program->entity_count);
+    for (int i = 0; i < program->entity_count && r.ok; i++) {
+        RELOCATE_REQUIRED(&r, program->entities[i]);
+        if (r.ok) fix_entity(&r, program->entities[i]);
+    }
+
+    RELOCATE(&r, program->game);
+    fix_game(&r, program->game);
+
+    RELOCATE_ARRAY(&r, program->imports, program->import_count);
+    for (int i = 0; i < program->import_count && r.ok; i++) {
+        fix_token(&r, &program->imports[i]);
+    }
+
+    if (!r.ok) {
+        munmap(base, size);
+        return false;
+    }
+
+    *out = *program;
+    out->mapped = base;
+    out->mapped_size = size;
+    return true;
+}
+
+void ast_cache_unmap(Program* program) {
+    munmap(program->mapped, program->mapped_size);
+    program->mapped = NULL;
+    program->mapped_size = 0;
+    program->statements = NULL;
+    program->entities = NULL;
+    program->game = NULL;
+    program->imports = NULL;
+    program->count = 0;
+    program->entity_count = 0;
+    program->import_count = 0;
+}
@@ -0,0 +1,30 @@
+#ifndef AST_CACHE_H
+#define AST_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "parser.h"
+
+// Bump whenever an AST struct changes layout.
+#define AST_CACHE_VERSION 9
+
+// Serialized Program: every pointer is stored as an offset from the start of
+// the file (0 means NULL), so the image can be mapped anywhere and fixed up in
+// place without allocating a single node.
+typedef struct {
+    char magic[4];        // "WSKC"
+    uint32_t version;
+    uint32_t pointer_size;
+    uint32_t reserved;
+    uint64_t source_hash;
+    uint64_t size;        // whole file, header included
+    uint64_t program;     // offset of the Program record
+} AstCacheHeader;
+
+void ast_cache_path(char* out, size_t size, const char* cache_dir, uint64_t source_hash);
+bool ast_cache_load(const char* path, uint64_t source_hash, Program* out);
+void ast_cache_store(const char* path, uint64_t source_hash, Program* program);
+void ast_cache_unmap(Program* program);
+
+#endif
@@ -0,0 +1,308 @@
+#define _XOPEN_SOURCE 700
+
+#include "build.h"
+#include "error.h"
+#include "module.h"
+#include "utils.h"
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+typedef struct {
+    char* script;        // as discovered under root_dir
+    ModuleGraph graph;
+    bool library;        // imported by another script: no output of its own
+    bool failed;         // parsing or generating stopped on an error
+    char message[512];   // the error, when failed
+    int written;
+    int unchanged;
+    double parse_ms;
+    double codegen_ms;
+    double write_ms;
+} BuildJob;
+
+typedef struct {
+    BuildJob* jobs;
+    int count;
+    int next;
+    pthread_mutex_t lock;
+    void (*run)(BuildJob* job, BuildOptions* options);
+    BuildOptions* options;
+} JobQueue;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static bool has_suffix(const char* s, const char* suffix) {
+    size_t length = strlen(s);
+    size_t suffix_length = strlen(suffix);
+    return length >= suffix_length && strcmp(s + length - suffix_length, suffix) == 0;
+}
+
+static void add_script(char*** scripts, int* count, int* capacity, const char* path) {
+    if (*count >= *capacity) {
+        *capacity = *capacity == 0 ? 16 : *capacity * 2;
+        char** new_scripts = realloc(*scripts, sizeof(char*) * *capacity);
+        if (!new_scripts) error(error_messages[ERROR_REALLOCFAIL].message);
+        *scripts = new_scripts;
+    }
+    (*scripts)[(*count)++] = my_strndup(path, strlen(path));
+}
+
+// Hidden directories (.git, the usual parse cache) are skipped.
+static void discover(const char* dir, char*** scripts, int* count, int* capacity) {
+    DIR* d = opendir(dir);
+    if (!d) error(error_messages[ERROR_FILELOAD].message);
+
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+
+        struct stat st;
+        if (stat(path, &st) != 0) continue;
+
+        if (S_ISDIR(st.st_mode)) {
+            discover(path, scripts, count, capacity);
+        } else if (S_ISREG(st.st_mode) && has_suffix(entry->d_name, ".wsk")) {
+            add_script(scripts, count, capacity, path);
+        }
+    }
+    closedir(d);
+}
+
+static int compare_paths(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static void make_dirs(const char* path) {
+    char partial[PATH_MAX];
+    snprintf(partial, sizeof(partial), "%s", path);
+    for (char* p = partial + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        mkdir(partial, 0755);
+        *p = '/';
+    }
+    mkdir(partial, 0755);
+}
+
+static void* worker(void* arg) {
+    JobQueue* queue = arg;
+    for (;;) {
+        pthread_mutex_lock(&queue->lock);
+        int index = queue->next++;
+        pthread_mutex_unlock(&queue->lock);
+
+        if (index >= queue->count) break;
+        queue->run(&queue->jobs[index], queue->options);
+    }
+    return NULL;
+}
+
+static void run_jobs(BuildJob* jobs, int count, BuildOptions* options,
+                     void (*run)(BuildJob* job, BuildOptions* options)) {
+    JobQueue queue = {jobs, count, 0, PTHREAD_MUTEX_INITIALIZER, run, options};
+
+    int threads = options->jobs < count ? options->jobs : count;
+    pthread_t* workers = malloc(sizeof(pthread_t) * (threads + 1));
+    if (!workers) error(error_messages[ERROR_MALLOCFAIL].message);
+
+    // The calling thread is one of the workers.
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&workers[i], NULL, worker, &queue) != 0) {
+            error("Failed to start build worker thread.");
+        }
+    }
+    worker(&queue);
+    for (int i = 1; i < threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    free(workers);
+}
+
+// A job that hits an error keeps the message and stops; the others carry on.
+static void job_failed(BuildJob* job, const char* message) {
+    job->failed = true;
+    snprintf(job->message, sizeof(job->message), "%s", message);
+}
+
+static void parse_job(BuildJob* job, BuildOptions* options) {
+    ErrorRecovery recovery;
+    error_push_recovery(&recovery);
+    if (setjmp(recovery.jump) != 0) {
+        job_failed(job, recovery.message);
+        return;
+    }
+
+    double start = now_ms();
+    job->graph = module_graph_load(job->script, options->cache_dir);
+    job->parse_ms = now_ms() - start;
+    error_pop_recovery(&recovery);
+}
+
+static void output_paths(BuildJob* job, BuildOptions* options, char* header_path, char* source_path,
+                         char* header_name, char* blob_name) {
+    const char* slash = strrchr(job->script, '/');
+    const char* file = slash ? slash + 1 : job->script;
+    int stem_length = (int)(strlen(file) - strlen(".wsk"));
+
+    char dir[PATH_MAX];
+    if (options->output_dir) {
+        // Mirror the script's place under root_dir.
+        const char* relative = job->script + strlen(options->root_dir);
+        while (*relative == '/') relative++;
+        const char* relative_slash = strrchr(relative, '/');
+        if (relative_slash) {
+            snprintf(dir, sizeof(dir), "%s/%.*s", options->output_dir, (int)(relative_slash - relative), relative);
+        } else {
+            snprintf(dir, sizeof(dir), "%s", options->output_dir);
+        }
+        make_dirs(dir);
+    } else {
+        snprintf(dir, sizeof(dir), "%.*s", (int)(file - job->script - 1), job->script);
+    }
+
+    snprintf(header_name, PATH_MAX, "%.*s_generated.h", stem_length, file);
+    snprintf(blob_name, PATH_MAX, "%.*s_spawns.bin", stem_length, file);
+    if (snprintf(header_path, PATH_MAX, "%s/%s", dir, header_name) >= PATH_MAX ||
+        snprintf(source_path, PATH_MAX, "%s/%.*s_generated.c", dir, stem_length, file) >= PATH_MAX) {
+        error("Output path is too long.");
+    }
+}
+
+static void generate_job(BuildJob* job, BuildOptions* options) {
+    if (job->failed) return;
+    if (job->library) {
+        module_graph_free(&job->graph);
+        return;
+    }
+
+    ErrorRecovery recovery;
+    error_push_recovery(&recovery);
+    if (setjmp(recovery.jump) != 0) {
+        job_failed(job, recovery.message);
+        module_graph_free(&job->graph);
+        return;
+    }
+
+    char header_path[PATH_MAX];
+    char source_path[PATH_MAX];
+    char header_name[PATH_MAX];
+    char blob_name[PATH_MAX];
+    output_paths(job, options, header_path, source_path, header_name, blob_name);
+
+    double start = now_ms();
+    Program program = module_graph_link(&job->graph);
+    CodeGen codegen = codegen_create();
+    codegen.options = options->codegen;
+    codegen.options.header_name = header_name;
+    codegen.options.source_name = source_path;
+    codegen.options.spawn_blob_name = blob_name;
+    codegen_generate_program(&codegen, &program);
+    double generated = now_ms();
+
+    job->written = codegen_write_changed(&codegen, header_path, source_path);
+    job->unchanged = (codegen.spawn_blob ? 3 : 2) - job->written;
+    job->write_ms = now_ms() - generated;
+    job->codegen_ms = generated - start;
+
+    codegen_free(&codegen);
+    free_linked_program(&program);
+    module_graph_free(&job->graph);
+    error_pop_recovery(&recovery);
+}
+
+// A script that another script imports is a library, not a game of its own.
+static void mark_libraries(BuildJob* jobs, int count) {
+    for (int i = 0; i < count; i++) {
+        if (jobs[i].failed) continue;
+        const char* path = jobs[i].graph.modules[0].path;
+        for (int j = 0; j < count && !jobs[i].library; j++) {
+            for (int k = 1; k < jobs[j].graph.count; k++) {
+                if (strcmp(jobs[j].graph.modules[k].path, path) == 0) {
+                    jobs[i].library = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+int build_directory(BuildOptions* options) {
+    double start = now_ms();
+
+    char** scripts = NULL;
+    int count = 0;
+    int capacity = 0;
+    discover(options->root_dir, &scripts, &count, &capacity);
+    qsort(scripts, count, sizeof(char*), compare_paths);
+
+    if (count == 0) {
+        fprintf(stderr, "No .wsk scripts found under %s\n", options->root_dir);
+        free(scripts);
+        return 1;
+    }
+
+    if (options->cache_dir) mkdir(options->cache_dir, 0755);
+    if (options->output_dir) make_dirs(options->output_dir);
+
+    BuildJob* jobs = calloc(count, sizeof(BuildJob));
+    if (!jobs) error(error_messages[ERROR_MALLOCFAIL].message);
+    for (int i = 0; i < count; i++) {
+        jobs[i].script = scripts[i];
+    }
+
+    // Every graph has to be loaded before we know which scripts are libraries.
+    run_jobs(jobs, count, options, parse_job);
+    mark_libraries(jobs, count);
+    run_jobs(jobs, count, options, generate_job);
+
+    int libraries = 0;
+    int failed = 0;
+    int written = 0;
+    int unchanged = 0;
+    int cache_hits = 0;
+    double parse_ms = 0;
+    double codegen_ms = 0;
+    double write_ms = 0;
+    for (int i = 0; i < count; i++) {
+        if (jobs[i].library) libraries++;
+        if (jobs[i].failed) {
+            fprintf(stderr, "%s: %s\n", jobs[i].script, jobs[i].message);
+            failed++;
+        }
+        written += jobs[i].written;
+        unchanged += jobs[i].unchanged;
+        cache_hits += jobs[i].graph.cache_hits;
+        parse_ms += jobs[i].parse_ms;
+        codegen_ms += jobs[i].codegen_ms;
+        write_ms += jobs[i].write_ms;
+        free(jobs[i].script);
+    }
+
+    printf("Built %d scripts (%d libraries, %d failed) with %d jobs in %.1f ms\n",
+        count - libraries - failed, libraries, failed, options->jobs, now_ms() - start);
+    printf("  scan+parse %9.1f ms  (%d modules from cache)\n", parse_ms, cache_hits);
+    printf("  codegen    %9.1f ms\n", codegen_ms);
+    printf("  write      %9.1f ms  (%d written, %d unchanged)\n", write_ms, written, unchanged);
+
+    free(jobs);
+    free(scripts);
+    return failed > 0 ? 1 : 0;
+}
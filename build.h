@@ -0,0 +1,17 @@
+#ifndef BUILD_H
+#define BUILD_H
+
+#include "codegen.h"
+
+// `whisker build`: transpile every script under a directory in one process.
+typedef struct {
+    const char* root_dir;
+    const char* output_dir; // nullable: write next to each script
+    const char* cache_dir;  // nullable: no on-disk parse cache
+    int jobs;               // worker threads, at least 1
+    CodeGenOptions codegen;
+} BuildOptions;
+
+int build_directory(BuildOptions* options);
+
+#endif
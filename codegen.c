@@ -1,5 +1,11 @@
 #include "codegen.h"
+#include "effects.h"
 #include "error.h"
+#include "typecheck.h"
+#include "typeinfo.h"
+#include "utils.h"
+#include <float.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,9 +16,20 @@
 // Forward declarations
 static void generate_expr(CodeGen* gen, Expr* expr, const char* entity_name);
 static void generate_stmt(CodeGen* gen, Stmt* stmt, const char* entity_name);
+static void generate_branch_condition(CodeGen* gen, Stmt* stmt, const char* entity_name);
+
+CodeGenOptions codegen_default_options(void) {
+    CodeGenOptions options = {0};
+    options.header_name = "game_generated.h";
+    options.source_name = "game_generated.c";
+    options.spawn_blob_name = "game_spawns.bin";
+    return options;
+}
 
 CodeGen codegen_create(void) {
     CodeGen gen = {0};
+    gen.options = codegen_default_options();
+
     gen.header_capacity = INITIAL_CAPACITY;
     gen.header_output = malloc(gen.header_capacity);
     gen.header_output[0] = '\0';
@@ -34,6 +51,13 @@ void codegen_free(CodeGen* gen) {
     gen->header_length = 0;
     gen->source_capacity = 0;
     gen->source_length = 0;
+    free(gen->branches);
+    gen->branches = NULL;
+    gen->branch_count = 0;
+    gen->branch_capacity = 0;
+    free(gen->spawn_blob);
+    gen->spawn_blob = NULL;
+    gen->spawn_blob_length = 0;
 }
 
 //char* codegen_get_output(CodeGen* gen) {
@@ -78,6 +102,10 @@ static void append(CodeGen* gen, const char* str) {
     }
     strcpy(gen->source_output + gen->source_length, str);
     gen->source_length += len;
+
+    for (int i = 0; i < len; i++) {
+        if (str[i] == '\n') gen->source_lines++;
+    }
 }
 
 static void appendf(CodeGen* gen, const char* fmt, ...) {
@@ -96,6 +124,16 @@ static void append_indent(CodeGen* gen) {
     }
 }
 
+static void append_line_directive(CodeGen* gen, int line, const char* file) {
+    appendf(gen, "#line %d \"", line);
+    for (const char* c = file; *c; c++) {
+        if (*c == '"' || *c == '\\') append(gen, "\\");
+        char ch[2] = {*c, '\0'};
+        append(gen, ch);
+    }
+    append(gen, "\"\n");
+}
+
 // Convert FieldType to C type string
 static const char* field_type_to_c(FieldType type) {
     switch (type) {
@@ -103,6 +141,9 @@ static const char* field_type_to_c(FieldType type) {
         case TYPE_INT: return "int";
         case TYPE_BOOL: return "bool";
         case TYPE_UINT32: return "uint32_t";
+        case TYPE_STRING: return "const char*";
+        case TYPE_VOID:
+        case TYPE_UNKNOWN: return "float";
     }
     return "int";
 }
@@ -112,11 +153,11 @@ static void generate_entity_struct_h(CodeGen* gen, EntityDecl* entity) {
     appendf_h(gen, "typedef struct %s {\n", entity->name.lexeme);
     gen->indent_level++;
 
-    append_indent(gen);
+    append_indent_h(gen);
     append_h(gen, "uint32_t entity_id;\n");
 
     for (int i = 0; i < entity->field_count; i++) {
-        append_indent(gen);
+        append_indent_h(gen);
         appendf_h(gen, "%s %s;\n",
                 field_type_to_c(entity->fields[i].type),
                 entity->fields[i].name.lexeme);
@@ -126,17 +167,39 @@ static void generate_entity_struct_h(CodeGen* gen, EntityDecl* entity) {
     appendf_h(gen, "} %s;\n\n", entity->name.lexeme);
 }
 
+static bool program_has_pooled(Program* program) {
+    for (int i = 0; i < program->entity_count; i++) {
+        if (program->entities[i]->pooled) return true;
+    }
+    return false;
+}
+
 // Generate entity array
 static void generate_entity_array_h(CodeGen* gen, EntityDecl* entity) {
     appendf_h(gen, "typedef struct %sArray {\n", entity->name.lexeme);
     gen->indent_level++;
 
-    append_indent(gen);
+    if (entity->singleton) {
+        // The one instance lives inside GameState: no realloc, fixed address.
+        append_indent_h(gen);
+        appendf_h(gen, "%s data[1];\n", entity->name.lexeme);
+        append_indent_h(gen);
+        append_h(gen, "int count;  // 0 or 1\n");
+        gen->indent_level--;
+        appendf_h(gen, "} %sArray;\n\n", entity->name.lexeme);
+        return;
+    }
+
+    append_indent_h(gen);
     appendf_h(gen, "%s* data;\n", entity->name.lexeme);
-    append_indent(gen);
+    append_indent_h(gen);
     append_h(gen, "int count;\n");
-    append_indent(gen);
+    append_indent_h(gen);
     append_h(gen, "int capacity;\n");
+    if (entity->pooled) {
+        append_indent_h(gen);
+        append_h(gen, "int parked;  // destroyed instances, kept after data[count] for reuse\n");
+    }
 
     gen->indent_level--;
     appendf_h(gen, "} %sArray;\n\n", entity->name.lexeme);
@@ -144,30 +207,49 @@ static void generate_entity_array_h(CodeGen* gen, EntityDecl* entity) {
 
 // Generate GameState
 static void generate_game_state_h(CodeGen* gen, Program* program) {
+    append_h(gen, "// Ids passed to instance_destroy, applied by game_flush_destroys.\n");
+    append_h(gen, "typedef struct {\n");
+    append_h(gen, "    uint32_t* data;\n");
+    append_h(gen, "    int count;\n");
+    append_h(gen, "    int capacity;\n");
+    append_h(gen, "    int applying;  // the first `applying` are being flushed\n");
+    append_h(gen, "} DestroyQueue;\n\n");
     append_h(gen, "typedef struct GameState {\n");
     gen->indent_level++;
 
     // Engine components
-    append_indent(gen);
+    append_indent_h(gen);
     append_h(gen, "// Engine components\n");
-    append_indent(gen);
+    append_indent_h(gen);
     append_h(gen, "EntityRegistry registry;\n");
-    append_indent(gen);
+    append_indent_h(gen);
     append_h(gen, "TransformArray transforms;\n");
-    append_indent(gen);
+    append_indent_h(gen);
     append_h(gen, "RenderableArray renderables;\n");
-    append_indent(gen);
+    append_indent_h(gen);
     append_h(gen, "CircleArray circles;\n");
-    append_indent(gen);
+    append_indent_h(gen);
     append_h(gen, "RectangleArray rectangles;\n");
-    append_indent(gen);
+    append_indent_h(gen);
     append_h(gen, "TimerArray timers;\n");
-    append_indent(gen);
-    append_h(gen, "EntityType* entity_types;\n");
+    append_indent_h(gen);
+    append_h(gen, "EntityType* entity_types;  // by entity id\n");
+    if (program_has_pooled(program)) {
+        append_indent_h(gen);
+        append_h(gen, "int* entity_slots;  // by entity id: index into a pooled type's array\n");
+    }
+    append_indent_h(gen);
+    append_h(gen, "int entity_type_capacity;\n");
+    append_indent_h(gen);
+    append_h(gen, "DestroyQueue destroy_queue;\n");
+    if (gen->options.profile) {
+        append_indent_h(gen);
+        append_h(gen, "WhiskerProfile profile;\n");
+    }
     append_h(gen, "\n");
 
     // Entity arrays
-    append_indent(gen);
+    append_indent_h(gen);
     // Game entity arrays
     for (int i = 0; i < program->entity_count; i++) {
         char lower_name[256];
@@ -183,11 +265,302 @@ static void generate_game_state_h(CodeGen* gen, Program* program) {
     append_h(gen, "} GameState;\n\n");
 }
 
+// Single precision literal: 0.1f, 2.0f. A bare 0.1 would be a double and drag
+// the whole expression into double math.
+static void append_float_literal(CodeGen* gen, double value) {
+    char text[64];
+    snprintf(text, sizeof(text), "%g", value);
+    if ((float)strtod(text, NULL) != (float)value) {
+        snprintf(text, sizeof(text), "%.9g", value);
+    }
+    if (!strpbrk(text, ".e")) strcat(text, ".0");
+    appendf(gen, "%sf", text);
+}
+
+static void warn_double_math(CodeGen* gen, int line, const char* message) {
+    char full[256];
+    if (gen->hook_entity) {
+        snprintf(full, sizeof(full), "%s %s: %s", gen->hook_entity->name.lexeme,
+                 hook_kind_name(gen->hook_kind), message);
+    } else {
+        snprintf(full, sizeof(full), "%s", message);
+    }
+    warning_at_line(line, full);
+}
+
+// --strict-float: everything the type checker could not keep in single
+// precision. `discarded` is set for a call whose result nobody reads.
+static void report_double_math(CodeGen* gen, Expr* expr, int line, bool discarded) {
+    char message[192];
+
+    switch (expr->type) {
+        case EXPR_LITERAL:
+            if (expr->as.literal.value.type == LITERAL_NUMBER && expr->value_type == TYPE_FLOAT &&
+                expr->as.literal.value.as.number > FLT_MAX) {
+                snprintf(message, sizeof(message), "%g does not fit in a float.", expr->as.literal.value.as.number);
+                warn_double_math(gen, line, message);
+            }
+            break;
+        case EXPR_GROUPING:
+            report_double_math(gen, expr->as.grouping.expression, line, false);
+            break;
+        case EXPR_UNARY:
+            report_double_math(gen, expr->as.unary.right, line, false);
+            break;
+        case EXPR_BINARY:
+            report_double_math(gen, expr->as.binary.left, line, false);
+            report_double_math(gen, expr->as.binary.right, line, false);
+            break;
+        case EXPR_ASSIGN:
+            report_double_math(gen, expr->as.assign.value, line, false);
+            break;
+        case EXPR_GET:
+            report_double_math(gen, expr->as.get.object, line, false);
+            break;
+        case EXPR_SET:
+            report_double_math(gen, expr->as.set.object, line, false);
+            report_double_math(gen, expr->as.set.value, line, false);
+            break;
+        case EXPR_CALL:
+            if (!discarded && expr->value_type == TYPE_UNKNOWN && expr->as.call.callee->type == EXPR_VARIABLE) {
+                snprintf(message, sizeof(message),
+                         "'%s' has no known signature and may return double; use its float variant (e.g. sqrtf).",
+                         expr->as.call.callee->as.variable.name.lexeme);
+                warn_double_math(gen, line, message);
+            }
+            for (int i = 0; i < expr->as.call.argc; i++) {
+                report_double_math(gen, expr->as.call.argv[i], line, false);
+            }
+            break;
+        case EXPR_VARIABLE:
+            break;
+    }
+}
+
+// Structural equality, for spotting the same subexpression twice.
+static bool expr_equal(Expr* a, Expr* b) {
+    if (a->type != b->type) return false;
+
+    switch (a->type) {
+        case EXPR_LITERAL:
+            if (a->as.literal.value.type != b->as.literal.value.type) return false;
+            if (a->as.literal.value.type == LITERAL_NUMBER) {
+                return a->as.literal.value.as.number == b->as.literal.value.as.number &&
+                       a->value_type == b->value_type;
+            }
+            if (a->as.literal.value.type == LITERAL_BOOLEAN) {
+                return a->as.literal.value.as.boolean == b->as.literal.value.as.boolean;
+            }
+            return false;
+        case EXPR_VARIABLE:
+            return strcmp(a->as.variable.name.lexeme, b->as.variable.name.lexeme) == 0;
+        case EXPR_GROUPING:
+            return expr_equal(a->as.grouping.expression, b->as.grouping.expression);
+        case EXPR_UNARY:
+            return a->as.unary.oprt.type == b->as.unary.oprt.type &&
+                   expr_equal(a->as.unary.right, b->as.unary.right);
+        case EXPR_BINARY:
+            return a->as.binary.oprt.type == b->as.binary.oprt.type &&
+                   expr_equal(a->as.binary.left, b->as.binary.left) &&
+                   expr_equal(a->as.binary.right, b->as.binary.right);
+        case EXPR_GET:
+            return strcmp(a->as.get.name.lexeme, b->as.get.name.lexeme) == 0 &&
+                   expr_equal(a->as.get.object, b->as.get.object);
+        default:
+            return false;
+    }
+}
+
+// Counts the assignments in an expression.
+static int count_writes(Expr* expr) {
+    switch (expr->type) {
+        case EXPR_GROUPING: return count_writes(expr->as.grouping.expression);
+        case EXPR_UNARY: return count_writes(expr->as.unary.right);
+        case EXPR_BINARY: return count_writes(expr->as.binary.left) + count_writes(expr->as.binary.right);
+        case EXPR_GET: return count_writes(expr->as.get.object);
+        case EXPR_ASSIGN: return 1 + count_writes(expr->as.assign.value);
+        case EXPR_SET: return 1 + count_writes(expr->as.set.object) + count_writes(expr->as.set.value);
+        case EXPR_CALL: {
+            int count = 0;
+            for (int i = 0; i < expr->as.call.argc; i++) {
+                count += count_writes(expr->as.call.argv[i]);
+            }
+            return count;
+        }
+        default:
+            return 0;
+    }
+}
+
+// Worth a temporary: an operator over reads only, with no integer division
+// that hoisting could move in front of the check guarding it.
+static bool is_cse_candidate(Expr* expr, bool root) {
+    switch (expr->type) {
+        case EXPR_LITERAL:
+        case EXPR_VARIABLE:
+            return !root;
+        case EXPR_GROUPING:
+            return is_cse_candidate(expr->as.grouping.expression, false);
+        case EXPR_GET:
+            return !root && is_cse_candidate(expr->as.get.object, false);
+        case EXPR_UNARY:
+            return is_cse_candidate(expr->as.unary.right, false);
+        case EXPR_BINARY:
+            if (expr->as.binary.oprt.type == TOKEN_SLASH && expr->value_type != TYPE_FLOAT) return false;
+            return is_cse_candidate(expr->as.binary.left, false) && is_cse_candidate(expr->as.binary.right, false);
+        default:
+            return false;
+    }
+}
+
+static int expr_size(Expr* expr) {
+    switch (expr->type) {
+        case EXPR_GROUPING: return 1 + expr_size(expr->as.grouping.expression);
+        case EXPR_UNARY: return 1 + expr_size(expr->as.unary.right);
+        case EXPR_BINARY: return 1 + expr_size(expr->as.binary.left) + expr_size(expr->as.binary.right);
+        case EXPR_GET: return 1 + expr_size(expr->as.get.object);
+        default: return 1;
+    }
+}
+
+static int count_matches(Expr* root, Expr* expr) {
+    if (!root) return 0;
+    if (expr_equal(root, expr)) return 1;
+
+    switch (root->type) {
+        case EXPR_GROUPING: return count_matches(root->as.grouping.expression, expr);
+        case EXPR_UNARY: return count_matches(root->as.unary.right, expr);
+        case EXPR_BINARY: return count_matches(root->as.binary.left, expr) + count_matches(root->as.binary.right, expr);
+        case EXPR_ASSIGN: return count_matches(root->as.assign.value, expr);
+        case EXPR_GET: return count_matches(root->as.get.object, expr);
+        case EXPR_SET: return count_matches(root->as.set.object, expr) + count_matches(root->as.set.value, expr);
+        case EXPR_CALL: {
+            int count = 0;
+            for (int i = 0; i < root->as.call.argc; i++) {
+                count += count_matches(root->as.call.argv[i], expr);
+            }
+            return count;
+        }
+        default:
+            return 0;
+    }
+}
+
+// Outermost repeated subexpressions first, so `a * b` used twice inside a
+// repeated `(a * b) + c` costs no temporary of its own.
+static void collect_cse(CodeGen* gen, Expr* root, Expr* expr) {
+    if (!expr || gen->cse_count >= CODEGEN_MAX_CSE) return;
+
+    for (int i = 0; i < gen->cse_count; i++) {
+        if (expr_equal(expr, gen->cse[i])) return;
+    }
+
+    FieldType type = expr->value_type;
+    bool typed = type == TYPE_FLOAT || type == TYPE_INT || type == TYPE_UINT32 || type == TYPE_BOOL;
+    if (typed && expr->type != EXPR_GROUPING && is_cse_candidate(expr, true) && count_matches(root, expr) >= 2) {
+        gen->cse[gen->cse_count] = expr;
+        gen->cse_ids[gen->cse_count] = gen->cse_next++;
+        gen->cse_count++;
+        return;
+    }
+
+    switch (expr->type) {
+        case EXPR_GROUPING: collect_cse(gen, root, expr->as.grouping.expression); break;
+        case EXPR_UNARY: collect_cse(gen, root, expr->as.unary.right); break;
+        case EXPR_BINARY:
+            collect_cse(gen, root, expr->as.binary.left);
+            // The right side of and/or may never run.
+            if (expr->as.binary.oprt.type != TOKEN_AND && expr->as.binary.oprt.type != TOKEN_OR) {
+                collect_cse(gen, root, expr->as.binary.right);
+            }
+            break;
+        case EXPR_ASSIGN: collect_cse(gen, root, expr->as.assign.value); break;
+        case EXPR_GET: collect_cse(gen, root, expr->as.get.object); break;
+        case EXPR_SET:
+            collect_cse(gen, root, expr->as.set.object);
+            collect_cse(gen, root, expr->as.set.value);
+            break;
+        case EXPR_CALL:
+            for (int i = 0; i < expr->as.call.argc; i++) {
+                collect_cse(gen, root, expr->as.call.argv[i]);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Hoists repeated subexpressions of one statement into const temporaries.
+// Statements with more than one write, or a call that could change what the
+// subexpressions read, are left alone.
+static void generate_cse_temps(CodeGen* gen, Expr* root, const char* entity_name) {
+    gen->cse_count = 0;
+    gen->cse_active = 0;
+    if (!root) return;
+
+    if (count_writes(root) > 1 || (expr_effects(root) & EFFECTS_MOVING)) return;
+
+    int first = gen->cse_next;
+    collect_cse(gen, root, root);
+
+    // Smaller first: a temporary may be built from earlier ones, never later.
+    for (int i = 1; i < gen->cse_count; i++) {
+        Expr* current = gen->cse[i];
+        int j = i - 1;
+        while (j >= 0 && expr_size(gen->cse[j]) > expr_size(current)) {
+            gen->cse[j + 1] = gen->cse[j];
+            j--;
+        }
+        gen->cse[j + 1] = current;
+    }
+    for (int i = 0; i < gen->cse_count; i++) {
+        gen->cse_ids[i] = first + i;
+    }
+
+    for (int i = 0; i < gen->cse_count; i++) {
+        append_indent(gen);
+        appendf(gen, "const %s _cse%d = ", field_type_to_c(gen->cse[i]->value_type), gen->cse_ids[i]);
+        gen->cse_active = i;
+        generate_expr(gen, gen->cse[i], entity_name);
+        append(gen, ";\n");
+    }
+    gen->cse_active = gen->cse_count;
+}
+
+// Re-derives tf/rd after code that may have moved the component arrays.
+static void generate_component_rebind(CodeGen* gen, Expr* expr) {
+    if (!expr || (!gen->bind_transform && !gen->bind_renderable)) return;
+
+    if (!(expr_effects(expr) & EFFECTS_MOVING)) return;
+
+    if (gen->bind_transform) {
+        append_indent(gen);
+        append(gen, "tf = &game->transforms.data[eid];\n");
+    }
+    if (gen->bind_renderable) {
+        append_indent(gen);
+        append(gen, "rd = &game->renderables.data[eid];\n");
+    }
+}
+
 // Generate expression as C code
 static void generate_expr(CodeGen* gen, Expr* expr, const char* entity_name) {
+    // A hoisted subexpression, possibly in now redundant parentheses.
+    Expr* hoisted = expr->type == EXPR_GROUPING ? expr->as.grouping.expression : expr;
+    for (int i = 0; i < gen->cse_active; i++) {
+        if (expr_equal(expr, gen->cse[i]) || expr_equal(hoisted, gen->cse[i])) {
+            appendf(gen, "_cse%d", gen->cse_ids[i]);
+            return;
+        }
+    }
+
     switch (expr->type) {
         case EXPR_LITERAL:
-            if (expr->as.literal.value.type == LITERAL_NUMBER) {
+            if (expr->as.literal.value.type == LITERAL_NUMBER && expr->value_type == TYPE_FLOAT) {
+                append_float_literal(gen, expr->as.literal.value.as.number);
+            } else if (expr->as.literal.value.type == LITERAL_NUMBER && expr->as.literal.integer) {
+                appendf(gen, "%.0f", expr->as.literal.value.as.number);
+            } else if (expr->as.literal.value.type == LITERAL_NUMBER) {
                 appendf(gen, "%g", expr->as.literal.value.as.number);
             } else if (expr->as.literal.value.type == LITERAL_STRING) {
                 appendf(gen, "\"%s\"", expr->as.literal.value.as.string);
@@ -202,9 +575,9 @@ static void generate_expr(CodeGen* gen, Expr* expr, const char* entity_name) {
             if (strcmp(varname, "self") == 0) {
                 append(gen, "entity");
             } else if (strcmp(varname, "transform") == 0) {
-                append(gen, "(&game->transforms.data[eid])");
+                append(gen, gen->bind_transform ? "tf" : "(&game->transforms.data[eid])");
             } else if (strcmp(varname, "renderable") == 0) {
-                append(gen, "(&game->renderables.data[eid])");
+                append(gen, gen->bind_renderable ? "rd" : "(&game->renderables.data[eid])");
             } else if (strcmp(varname, "collision") == 0) {
                 // Need runtime type check since collision is union
                 append(gen, "/* TODO: collision access needs type checking */");
@@ -216,7 +589,13 @@ static void generate_expr(CodeGen* gen, Expr* expr, const char* entity_name) {
 
         case EXPR_BINARY:
             generate_expr(gen, expr->as.binary.left, entity_name);
-            appendf(gen, " %s ", expr->as.binary.oprt.lexeme);
+            if (expr->as.binary.oprt.type == TOKEN_AND) {
+                append(gen, " && ");
+            } else if (expr->as.binary.oprt.type == TOKEN_OR) {
+                append(gen, " || ");
+            } else {
+                appendf(gen, " %s ", expr->as.binary.oprt.lexeme);
+            }
             generate_expr(gen, expr->as.binary.right, entity_name);
             break;
 
@@ -294,31 +673,76 @@ static void generate_expr(CodeGen* gen, Expr* expr, const char* entity_name) {
     }
 }
 
+// Statements of a hook, if or while body, whose braces are already open
+static void generate_body(CodeGen* gen, Stmt* body, const char* entity_name) {
+    if (body->type != STMT_BLOCK) {
+        generate_stmt(gen, body, entity_name);
+        return;
+    }
+    for (int i = 0; i < body->as.block.count; i++) {
+        generate_stmt(gen, body->as.block.statements[i], entity_name);
+    }
+}
+
 // Generate statement as C code
 static void generate_stmt(CodeGen* gen, Stmt* stmt, const char* entity_name) {
+    if (gen->line_file && stmt->line > 0 && stmt->type != STMT_BLOCK) {
+        append_line_directive(gen, stmt->line, gen->line_file);
+    }
+
+    if (gen->options.strict_float) {
+        switch (stmt->type) {
+            case STMT_EXPRESSION:
+                report_double_math(gen, stmt->as.expr.expr, stmt->line, true);
+                break;
+            case STMT_VAR:
+                if (stmt->as.var.initializer) report_double_math(gen, stmt->as.var.initializer, stmt->line, false);
+                break;
+            case STMT_IF:
+                report_double_math(gen, stmt->as.if_stmt.condition, stmt->line, false);
+                break;
+            case STMT_WHILE:
+                report_double_math(gen, stmt->as.while_stmt.condition, stmt->line, false);
+                break;
+            default:
+                break;
+        }
+    }
+
+    gen->cse_count = 0;
+    gen->cse_active = 0;
+
     switch (stmt->type) {
         case STMT_EXPRESSION:
+            generate_cse_temps(gen, stmt->as.expr.expr, entity_name);
             append_indent(gen);
             generate_expr(gen, stmt->as.expr.expr, entity_name);
             append(gen, ";\n");
+            generate_component_rebind(gen, stmt->as.expr.expr);
             break;
 
         case STMT_VAR:
+            generate_cse_temps(gen, stmt->as.var.initializer, entity_name);
             append_indent(gen);
-            // For now, assume all vars are float - we'll improve this later
-            append(gen, "float ");
-            append(gen, stmt->as.var.name.lexeme);
+            // Declared or inferred by the type checker
+            appendf(gen, "%s %s", field_type_to_c(stmt->as.var.type), stmt->as.var.name.lexeme);
             if (stmt->as.var.initializer) {
                 append(gen, " = ");
                 generate_expr(gen, stmt->as.var.initializer, entity_name);
             }
             append(gen, ";\n");
+            generate_component_rebind(gen, stmt->as.var.initializer);
             break;
 
         case STMT_BLOCK:
-            for (int i = 0; i < stmt->as.block.count; i++) {
-                generate_stmt(gen, stmt->as.block.statements[i], entity_name);
-            }
+            // A nested block is a scope of its own in C too
+            append_indent(gen);
+            append(gen, "{\n");
+            gen->indent_level++;
+            generate_body(gen, stmt, entity_name);
+            gen->indent_level--;
+            append_indent(gen);
+            append(gen, "}\n");
             break;
 
         case STMT_PRINT:
@@ -326,19 +750,22 @@ static void generate_stmt(CodeGen* gen, Stmt* stmt, const char* entity_name) {
             break;
 
         case STMT_IF:
+            generate_cse_temps(gen, stmt->as.if_stmt.condition, entity_name);
             append_indent(gen);
             append(gen, "if (");
-            generate_expr(gen, stmt->as.if_stmt.condition, entity_name);
+            generate_branch_condition(gen, stmt, entity_name);
             append(gen, ") {\n");
             gen->indent_level++;
-            generate_stmt(gen, stmt->as.if_stmt.then_branch, entity_name);
+            generate_component_rebind(gen, stmt->as.if_stmt.condition);
+            generate_body(gen, stmt->as.if_stmt.then_branch, entity_name);
             gen->indent_level--;
             append_indent(gen);
             append(gen, "}");
             if (stmt->as.if_stmt.else_branch) {
                 append(gen, " else {\n");
                 gen->indent_level++;
-                generate_stmt(gen, stmt->as.if_stmt.else_branch, entity_name);
+                generate_component_rebind(gen, stmt->as.if_stmt.condition);
+                generate_body(gen, stmt->as.if_stmt.else_branch, entity_name);
                 gen->indent_level--;
                 append_indent(gen);
                 append(gen, "}");
@@ -347,15 +774,18 @@ static void generate_stmt(CodeGen* gen, Stmt* stmt, const char* entity_name) {
             break;
 
         case STMT_WHILE:
+            // The condition runs again every iteration: nothing to hoist.
             append_indent(gen);
             append(gen, "while (");
             generate_expr(gen, stmt->as.while_stmt.condition, entity_name);
             append(gen, ") {\n");
             gen->indent_level++;
-            generate_stmt(gen, stmt->as.while_stmt.body, entity_name);
+            generate_component_rebind(gen, stmt->as.while_stmt.condition);
+            generate_body(gen, stmt->as.while_stmt.body, entity_name);
             gen->indent_level--;
             append_indent(gen);
             append(gen, "}\n");
+            generate_component_rebind(gen, stmt->as.while_stmt.condition);
             break;
 
         default:
@@ -365,50 +795,213 @@ static void generate_stmt(CodeGen* gen, Stmt* stmt, const char* entity_name) {
     }
 }
 
-static void generate_collision_from_init(CodeGen* gen, EntityDecl* entity) {
-    if (!entity->init) return;
+// Sites are numbered per hook in source order, so a profile matches them up
+// even when two ifs share a line.
+static void collect_branches(CodeGen* gen, EntityDecl* entity, HookKind hook, Stmt* stmt, int* ordinal) {
+    if (!stmt) return;
+
+    switch (stmt->type) {
+        case STMT_IF:
+            if (gen->branch_count >= gen->branch_capacity) {
+                gen->branch_capacity = gen->branch_capacity == 0 ? 16 : gen->branch_capacity * 2;
+                BranchSite* new_branches = realloc(gen->branches, sizeof(BranchSite) * gen->branch_capacity);
+                if (!new_branches) error(error_messages[ERROR_REALLOCFAIL].message);
+                gen->branches = new_branches;
+            }
+            gen->branches[gen->branch_count++] = (BranchSite){stmt, entity, hook, (*ordinal)++};
+            collect_branches(gen, entity, hook, stmt->as.if_stmt.then_branch, ordinal);
+            collect_branches(gen, entity, hook, stmt->as.if_stmt.else_branch, ordinal);
+            break;
+        case STMT_BLOCK:
+            for (int i = 0; i < stmt->as.block.count; i++) {
+                collect_branches(gen, entity, hook, stmt->as.block.statements[i], ordinal);
+            }
+            break;
+        case STMT_WHILE:
+            collect_branches(gen, entity, hook, stmt->as.while_stmt.body, ordinal);
+            break;
+        default:
+            break;
+    }
+}
+
+static void collect_entity_branches(CodeGen* gen, EntityDecl* entity) {
+    Stmt* hooks[HOOK_COUNT] = {entity->on_create, entity->on_update, entity->on_destroy, entity->on_collision};
+    for (int hook = 0; hook < HOOK_COUNT; hook++) {
+        int ordinal = 0;
+        collect_branches(gen, entity, (HookKind)hook, hooks[hook], &ordinal);
+    }
+}
+
+static int find_branch(CodeGen* gen, Stmt* stmt) {
+    for (int i = 0; i < gen->branch_count; i++) {
+        if (gen->branches[i].stmt == stmt) return i;
+    }
+    return -1;
+}
+
+// Below this many evaluations a measured rate is treated as noise.
+#define PROFILE_MIN_BRANCH_SAMPLES 32
+
+// An if condition, counted in profiled builds and given a
+// __builtin_expect hint when the profile shows it is lopsided.
+static void generate_branch_condition(CodeGen* gen, Stmt* stmt, const char* entity_name) {
+    const char* hint = NULL;
+    ProfileData* data = gen->options.profile_use;
+    int site = find_branch(gen, stmt);
+    if (data && gen->hook_entity && site >= 0) {
+        BranchSample* sample = profile_branch(data, gen->hook_entity->name.lexeme, gen->hook_kind,
+                                              gen->branches[site].ordinal, stmt->line);
+        if (sample && sample->total >= PROFILE_MIN_BRANCH_SAMPLES) {
+            double rate = (double)sample->taken / (double)sample->total;
+            if (rate >= 0.9) hint = "WHISKER_LIKELY";
+            if (rate <= 0.1) hint = "WHISKER_UNLIKELY";
+        }
+    }
 
-    // Extract collision configuration from init block
-    int collision_type = 0;  // 0=none, 1=rect, 2=circ
-    float width = 0, height = 0;
+    if (!gen->options.profile) site = -1;
 
-    Stmt* block = entity->init;
-    if (block->type != STMT_BLOCK) return;
+    if (hint) appendf(gen, "%s(", hint);
+    if (site >= 0) appendf(gen, "whisker_branch(game, %d, ", site);
+    generate_expr(gen, stmt->as.if_stmt.condition, entity_name);
+    if (site >= 0) append(gen, ")");
+    if (hint) append(gen, ")");
+}
 
-    // Walk through init statements looking for collision.* assignments
-    for (int i = 0; i < block->as.block.count; i++) {
-        Stmt* stmt = block->as.block.statements[i];
+// Generate a hook's statements. With line directives on, they map back to the
+// script and the code after them maps to the generated file again.
+static void generate_hook_body(CodeGen* gen, EntityDecl* entity, HookKind hook, Stmt* body) {
+    bool lines = gen->options.line_directives && entity->path;
+    gen->line_file = lines ? entity->path : NULL;
+    gen->hook_entity = entity;
+    gen->hook_kind = hook;
+    gen->cse_next = 0;
+
+    // Bound once: GCC cannot tell that game->transforms.data survives calls.
+    HookEffects* effects = &entity->effects[hook];
+    unsigned components = effects->component_reads | effects->component_writes;
+    gen->bind_transform = components & COMPONENT_TRANSFORM;
+    gen->bind_renderable = components & COMPONENT_RENDERABLE;
+    if (gen->bind_transform) {
+        append_indent(gen);
+        append(gen, "transform_t* tf = &game->transforms.data[eid];\n");
+    }
+    if (gen->bind_renderable) {
+        append_indent(gen);
+        append(gen, "Renderable* rd = &game->renderables.data[eid];\n");
+    }
 
-        if (stmt->type == STMT_EXPRESSION &&
-            stmt->as.expr.expr->type == EXPR_SET) {
+    generate_body(gen, body, entity->name.lexeme);
+    gen->hook_entity = NULL;
+    gen->bind_transform = false;
+    gen->bind_renderable = false;
 
-            Expr* set = stmt->as.expr.expr;
+    if (lines) {
+        gen->line_file = NULL;
+        // The directive sits on line source_lines + 1; it names the next one.
+        append_line_directive(gen, gen->source_lines + 2, gen->options.source_name);
+    }
+}
 
-            // Check if it's collision.something
-            if (set->as.set.object->type == EXPR_VARIABLE &&
-                strcmp(set->as.set.object->as.variable.name.lexeme, "collision") == 0) {
+static void generate_trace_event(CodeGen* gen, const char* name, char phase) {
+    if (!gen->options.trace) return;
+    append_indent(gen);
+    appendf(gen, "whisker_trace(\"%s\", '%c');\n", name, phase);
+}
 
-                const char* field = set->as.set.name.lexeme;
-                Expr* value = set->as.set.value;
+// Profiled builds emit each hook as a static `<name>_body` plus a public
+// `<name>` that times it into game->profile.
+static const char* hook_body_suffix(CodeGen* gen) {
+    return gen->options.profile ? "_body" : "";
+}
 
-                if (strcmp(field, "type") == 0 && value->type == EXPR_VARIABLE) {
-                    const char* type_name = value->as.variable.name.lexeme;
-                    if (strcmp(type_name, "COLLISION_RECT") == 0) {
-                        collision_type = 1;
-                    } else if (strcmp(type_name, "COLLISION_CIRC") == 0) {
-                        collision_type = 2;
-                    }
-                } else if (strcmp(field, "width") == 0 && value->type == EXPR_LITERAL) {
-                    width = (float)value->as.literal.value.as.number;
-                } else if (strcmp(field, "height") == 0 && value->type == EXPR_LITERAL) {
-                    height = (float)value->as.literal.value.as.number;
-                }
-            }
+// A hook never called while its type had instances alive is laid out cold.
+// A type that never spawned says nothing about its hooks.
+static bool hook_is_cold(CodeGen* gen, EntityDecl* entity, HookKind hook) {
+    ProfileData* data = gen->options.profile_use;
+    return data && profile_type_peak(data, entity->name.lexeme) > 0 &&
+           profile_hook_calls(data, entity->name.lexeme, hook) == 0;
+}
+
+static void append_hook_prefix(CodeGen* gen, EntityDecl* entity, HookKind hook) {
+    if (hook_is_cold(gen, entity, hook)) append(gen, "WHISKER_COLD ");
+    if (gen->options.profile) append(gen, "static ");
+}
+
+static void generate_profiled_hook(CodeGen* gen, EntityDecl* entity, HookKind hook_kind,
+                                   const char* ret, const char* name, const char* params, const char* args) {
+    char upper_name[256];
+    snprintf(upper_name, sizeof(upper_name), "%s", entity->name.lexeme);
+    for (int i = 0; upper_name[i]; i++) {
+        if (upper_name[i] >= 'a' && upper_name[i] <= 'z') upper_name[i] -= 32;
+    }
+
+    char hook[32];
+    snprintf(hook, sizeof(hook), "%s", hook_kind_name(hook_kind));
+    for (int i = 0; hook[i]; i++) {
+        if (hook[i] >= 'a' && hook[i] <= 'z') hook[i] -= 32;
+    }
+
+    bool returns = strcmp(ret, "void") != 0;
+
+    appendf(gen, "%s %s(%s) {\n", ret, name, params);
+    gen->indent_level++;
+    append_indent(gen);
+    append(gen, "uint64_t start = whisker_cycles();\n");
+    append_indent(gen);
+    if (returns) appendf(gen, "%s result = ", ret);
+    appendf(gen, "%s_body(%s);\n", name, args);
+    append_indent(gen);
+    appendf(gen, "WhiskerTypeProfile* p = &game->profile.types[ENTITY_TYPE_%s];\n", upper_name);
+    append_indent(gen);
+    appendf(gen, "p->cycles[WHISKER_HOOK_%s] += whisker_cycles() - start;\n", hook);
+    append_indent(gen);
+    appendf(gen, "p->calls[WHISKER_HOOK_%s]++;\n", hook);
+    if (hook_kind == HOOK_CREATE) {
+        char lower_name[256];
+        snprintf(lower_name, sizeof(lower_name), "%s", entity->name.lexeme);
+        for (int i = 0; lower_name[i]; i++) {
+            if (lower_name[i] >= 'A' && lower_name[i] <= 'Z') lower_name[i] += 32;
         }
+        append_indent(gen);
+        appendf(gen, "if ((uint32_t)game->%ss.count > p->peak_instances) p->peak_instances = game->%ss.count;\n",
+                lower_name, lower_name);
+    }
+    if (returns) {
+        append_indent(gen);
+        append(gen, "return result;\n");
+    }
+    gen->indent_level--;
+    append(gen, "}\n\n");
+}
+
+// renderable.current_sprite_id as the init block sets it, as C.
+static void sprite_text(TypeInfo* info, char* out, size_t size) {
+    if (!info->has_sprite) snprintf(out, size, "SPRITE_NONE");
+    else if (info->sprite) snprintf(out, size, "%s", info->sprite);
+    else snprintf(out, size, "%d", info->sprite_number);
+}
+
+// The components a type uses: those its hooks touch, plus a shape or a
+// sprite its init block gives it.
+static unsigned type_components(EntityDecl* entity, TypeInfo* info) {
+    unsigned components = 0;
+    for (int h = 0; h < HOOK_COUNT; h++) {
+        components |= entity->effects[h].component_reads | entity->effects[h].component_writes;
     }
+    if (info->shape != SHAPE_NONE) components |= COMPONENT_COLLISION;
+    if (info->has_sprite) components |= COMPONENT_RENDERABLE;
+    return components;
+}
+
+// count_shape is false when a parked pooled instance is reused: its shape
+// slot was counted when the engine entity was first created.
+static void generate_collision_from_init(CodeGen* gen, EntityDecl* entity, bool count_shape) {
+    TypeInfo info = type_info_evaluate(entity);
+    float width = info.width, height = info.height;
 
     // Generate the actual collision setup code
-    if (collision_type == 1) {  // COLLISION_RECT
+    if (info.shape == SHAPE_RECT) {
         append_indent(gen);
         append(gen, "entity_set_collision(&game->registry, entity_id, COLLISION_RECT);\n");
         append_indent(gen);
@@ -417,13 +1010,19 @@ static void generate_collision_from_init(CodeGen* gen, EntityDecl* entity) {
         append_indent(gen);
         append(gen, ".owner_id = entity_id,\n");
         append_indent(gen);
-        appendf(gen, ".rect = {x, y, %g, %g}\n", width, height);
+        append(gen, ".rect = {x, y, ");
+        append_float_literal(gen, width);
+        append(gen, ", ");
+        append_float_literal(gen, height);
+        append(gen, "}\n");
         gen->indent_level--;
         append_indent(gen);
         append(gen, "};\n");
-        append_indent(gen);
-        append(gen, "game->rectangles.count++;\n");
-    } else if (collision_type == 2) {  // COLLISION_CIRC
+        if (count_shape) {
+            append_indent(gen);
+            append(gen, "game->rectangles.count++;\n");
+        }
+    } else if (info.shape == SHAPE_CIRC) {
         append_indent(gen);
         append(gen, "entity_set_collision(&game->registry, entity_id, COLLISION_CIRC);\n");
         append_indent(gen);
@@ -434,29 +1033,152 @@ static void generate_collision_from_init(CodeGen* gen, EntityDecl* entity) {
         append_indent(gen);
         appendf(gen, ".position = {x, y},\n");
         append_indent(gen);
-        appendf(gen, ".radius = %g\n", width);  // Use width as radius
+        append(gen, ".radius = ");
+        append_float_literal(gen, width);  // Use width as radius
+        append(gen, "\n");
         gen->indent_level--;
         append_indent(gen);
         append(gen, "};\n");
-        append_indent(gen);
-        append(gen, "game->circles.count++;\n");
+        if (count_shape) {
+            append_indent(gen);
+            append(gen, "game->circles.count++;\n");
+        }
     }
 }
 
-static void generate_entity_create(CodeGen* gen, EntityDecl* entity) {
-    // Lowercase the entity name for the function
-    char lower_name[256];
-    snprintf(lower_name, sizeof(lower_name), "%s", entity->name.lexeme);
-    for (int i = 0; lower_name[i]; i++) {
-        if (lower_name[i] >= 'A' && lower_name[i] <= 'Z') {
-            lower_name[i] = lower_name[i] + 32;  // to lowercase
-        }
+static void lower_entity_name(EntityDecl* entity, char* out, size_t size) {
+    snprintf(out, size, "%s", entity->name.lexeme);
+    for (int j = 0; out[j]; j++) {
+        if (out[j] >= 'A' && out[j] <= 'Z') out[j] += 32;
     }
+}
 
-    appendf(gen, "uint32_t %s_create(GameState* game, float x, float y) {\n", lower_name);
-    gen->indent_level++;
+// on_create stores of a constant into a field (`self.speed = 4;`) are done
+// at compile time: they go into a static const prototype that every new
+// instance is copied from, and only the rest of on_create runs per instance.
+// A store folds only if nothing left in front of it touches that field.
+typedef struct {
+    Expr** values;  // per field, the folded constant or NULL for zero
+    Stmt residual;  // what still runs, as a block
+} CreatePlan;
+
+static bool expr_touches_field(Expr* expr, const char* field) {
+    if (!expr) return false;
+
+    switch (expr->type) {
+        case EXPR_GROUPING: return expr_touches_field(expr->as.grouping.expression, field);
+        case EXPR_UNARY: return expr_touches_field(expr->as.unary.right, field);
+        case EXPR_BINARY:
+            return expr_touches_field(expr->as.binary.left, field) ||
+                   expr_touches_field(expr->as.binary.right, field);
+        case EXPR_ASSIGN: return expr_touches_field(expr->as.assign.value, field);
+        case EXPR_GET:
+            if (expr->as.get.object->type == EXPR_VARIABLE &&
+                strcmp(expr->as.get.object->as.variable.name.lexeme, "self") == 0 &&
+                strcmp(expr->as.get.name.lexeme, field) == 0) return true;
+            return expr_touches_field(expr->as.get.object, field);
+        case EXPR_SET:
+            if (expr->as.set.object->type == EXPR_VARIABLE &&
+                strcmp(expr->as.set.object->as.variable.name.lexeme, "self") == 0 &&
+                strcmp(expr->as.set.name.lexeme, field) == 0) return true;
+            return expr_touches_field(expr->as.set.object, field) ||
+                   expr_touches_field(expr->as.set.value, field);
+        case EXPR_CALL:
+            for (int i = 0; i < expr->as.call.argc; i++) {
+                if (expr_touches_field(expr->as.call.argv[i], field)) return true;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+static bool stmt_touches_field(Stmt* stmt, const char* field) {
+    if (!stmt) return false;
+
+    switch (stmt->type) {
+        case STMT_EXPRESSION: return expr_touches_field(stmt->as.expr.expr, field);
+        case STMT_PRINT: return expr_touches_field(stmt->as.print.expr, field);
+        case STMT_VAR: return expr_touches_field(stmt->as.var.initializer, field);
+        case STMT_BLOCK:
+            for (int i = 0; i < stmt->as.block.count; i++) {
+                if (stmt_touches_field(stmt->as.block.statements[i], field)) return true;
+            }
+            return false;
+        case STMT_IF:
+            return expr_touches_field(stmt->as.if_stmt.condition, field) ||
+                   stmt_touches_field(stmt->as.if_stmt.then_branch, field) ||
+                   stmt_touches_field(stmt->as.if_stmt.else_branch, field);
+        case STMT_WHILE:
+            return expr_touches_field(stmt->as.while_stmt.condition, field) ||
+                   stmt_touches_field(stmt->as.while_stmt.body, field);
+    }
+    return false;
+}
+
+// The field `self.name = <literal>;` stores into, or -1.
+static int constant_store(EntityDecl* entity, Stmt* stmt) {
+    if (stmt->type != STMT_EXPRESSION || stmt->as.expr.expr->type != EXPR_SET) return -1;
+
+    Expr* set = stmt->as.expr.expr;
+    if (set->as.set.object->type != EXPR_VARIABLE ||
+        strcmp(set->as.set.object->as.variable.name.lexeme, "self") != 0 ||
+        set->as.set.value->type != EXPR_LITERAL) return -1;
+
+    for (int i = 0; i < entity->field_count; i++) {
+        if (strcmp(entity->fields[i].name.lexeme, set->as.set.name.lexeme) == 0) return i;
+    }
+    return -1;
+}
+
+static CreatePlan plan_create(EntityDecl* entity) {
+    CreatePlan plan = {0};
+    plan.values = calloc(entity->field_count > 0 ? entity->field_count : 1, sizeof(Expr*));
+    if (!plan.values) error(error_messages[ERROR_MALLOCFAIL].message);
+    plan.residual.type = STMT_BLOCK;
+
+    Stmt* body = entity->on_create;
+    if (!body) return plan;
+
+    int count = body->type == STMT_BLOCK ? body->as.block.count : 1;
+    Stmt** kept = malloc(sizeof(Stmt*) * (count > 0 ? count : 1));
+    if (!kept) error(error_messages[ERROR_MALLOCFAIL].message);
+    plan.residual.line = body->line;
+    plan.residual.as.block = (BlockStmt){kept, 0};
+
+    for (int i = 0; i < count; i++) {
+        Stmt* stmt = body->type == STMT_BLOCK ? body->as.block.statements[i] : body;
+        int field = constant_store(entity, stmt);
+        for (int k = 0; field >= 0 && k < plan.residual.as.block.count; k++) {
+            if (stmt_touches_field(kept[k], entity->fields[field].name.lexeme)) field = -1;
+        }
+
+        if (field >= 0) plan.values[field] = stmt->as.expr.expr->as.set.value;
+        else kept[plan.residual.as.block.count++] = stmt;
+    }
+    return plan;
+}
+
+static void free_create_plan(CreatePlan* plan) {
+    free(plan->values);
+    free(plan->residual.as.block.statements);
+}
+
+static void generate_prototype(CodeGen* gen, EntityDecl* entity, CreatePlan* plan, const char* lower_name) {
+    appendf(gen, "static const %s %s_prototype = {", entity->name.lexeme, lower_name);
+    bool any = false;
+    for (int i = 0; i < entity->field_count; i++) {
+        if (!plan->values[i]) continue;
+        append(gen, any ? ", " : "");
+        appendf(gen, ".%s = ", entity->fields[i].name.lexeme);
+        generate_expr(gen, plan->values[i], entity->name.lexeme);
+        any = true;
+    }
+    append(gen, any ? "};\n\n" : "0};\n\n");
+}
 
-    // Create entity in engine
+// A fresh engine entity with its collision shape, registered in the type table.
+static void generate_engine_entity(CodeGen* gen, EntityDecl* entity, const char* upper_name) {
     append_indent(gen);
     append(gen, "uint32_t entity_id = entity_create(&game->registry, &game->transforms,\n");
     append_indent(gen);
@@ -464,19 +1186,23 @@ static void generate_entity_create(CodeGen* gen, EntityDecl* entity) {
     append(gen, "\n");
 
     // Generate collision setup from init block
-    generate_collision_from_init(gen, entity);
+    generate_collision_from_init(gen, entity, true);
     append(gen, "\n");
 
     append_indent(gen);
-    char upper_name[256];
-    snprintf(upper_name, sizeof(upper_name), "%s", entity->name.lexeme);
-    for (int i = 0; upper_name[i]; i++) {
-        if (upper_name[i] >= 'a' && upper_name[i] <= 'z') upper_name[i] -= 32;
-    }
+    append(gen, "if (entity_id >= (uint32_t)game->entity_type_capacity) whisker_grow_entity_types(game, entity_id);\n");
+    append_indent(gen);
     appendf(gen, "game->entity_types[entity_id] = ENTITY_TYPE_%s;\n", upper_name);
     append(gen, "\n");
+}
+
+// Initialize engine components with defaults. A type that never shows a
+// sprite only gets SPRITE_NONE, so the renderer passes over it.
+static void generate_default_components(CodeGen* gen, EntityDecl* entity) {
+    TypeInfo info = type_info_evaluate(entity);
+    char sprite[256];
+    sprite_text(&info, sprite, sizeof(sprite));
 
-    // Initialize engine components with defaults
     append_indent(gen);
     append(gen, "game->transforms.data[entity_id] = (transform_t){\n");
     gen->indent_level++;
@@ -491,11 +1217,18 @@ static void generate_entity_create(CodeGen* gen, EntityDecl* entity) {
     append(gen, "};\n");
     append(gen, "\n");
 
+    if (!(type_components(entity, &info) & COMPONENT_RENDERABLE)) {
+        append_indent(gen);
+        append(gen, "game->renderables.data[entity_id].current_sprite_id = SPRITE_NONE;\n");
+        append(gen, "\n");
+        return;
+    }
+
     append_indent(gen);
     append(gen, "game->renderables.data[entity_id] = (Renderable){\n");
     gen->indent_level++;
     append_indent(gen);
-    append(gen, ".current_sprite_id = SPRITE_NONE,\n");
+    appendf(gen, ".current_sprite_id = %s,\n", sprite);
     append_indent(gen);
     append(gen, ".image_index = 0,\n");
     append_indent(gen);
@@ -506,242 +1239,890 @@ static void generate_entity_create(CodeGen* gen, EntityDecl* entity) {
     append_indent(gen);
     append(gen, "};\n");
     append(gen, "\n");
+}
 
-    // Add to game-specific array (with realloc if needed)
-    appendf(gen, "    if (game->%ss.count >= game->%ss.capacity) {\n", lower_name, lower_name);
-    appendf(gen, "        game->%ss.capacity = game->%ss.capacity == 0 ? 8 : game->%ss.capacity * 2;\n",
-            lower_name, lower_name, lower_name);
-    appendf(gen, "        game->%ss.data = realloc(game->%ss.data, sizeof(%s) * game->%ss.capacity);\n",
-            lower_name, lower_name, entity->name.lexeme, lower_name);
-    append(gen, "    }\n");
-    append(gen, "\n");
+// What is left of on_create, for the instance `record` points at.
+static void generate_create_body(CodeGen* gen, EntityDecl* entity, CreatePlan* plan, const char* record) {
+    if (plan->residual.as.block.count == 0) return;
 
-    // Initialize entity struct
-    appendf(gen, "    game->%ss.data[game->%ss.count++] = (%s){\n",
-            lower_name, lower_name, entity->name.lexeme);
-    gen->indent_level++;
     append_indent(gen);
-    append(gen, ".entity_id = entity_id");
-
-    // Initialize custom fields to zero
-    for (int i = 0; i < entity->field_count; i++) {
-        append(gen, ",\n");
-        append_indent(gen);
-        appendf(gen, ".%s = 0", entity->fields[i].name.lexeme);
-    }
-    append(gen, "\n");
-
-    gen->indent_level--;
+    appendf(gen, "// on_create\n");
     append_indent(gen);
-    append(gen, "};\n");
-    append(gen, "\n");
-
-    // Generate on_create code
-    if (entity->on_create) {
-        append_indent(gen);
-        appendf(gen, "// on_create\n");
-        append_indent(gen);
-        appendf(gen, "%s* entity = &game->%ss.data[game->%ss.count - 1];\n",
-                entity->name.lexeme, lower_name, lower_name);
-        append_indent(gen);
-        append(gen, "uint32_t eid = entity->entity_id;  // For component access\n");
-
-        // Generate statements with eid available
-        generate_stmt(gen, entity->on_create, entity->name.lexeme);
-    }
-
+    appendf(gen, "%s* entity = %s;\n", entity->name.lexeme, record);
     append_indent(gen);
-    append(gen, "return entity_id;\n");
+    append(gen, "uint32_t eid = entity->entity_id;  // For component access\n");
 
-    gen->indent_level--;
-    append(gen, "}\n\n");
+    // Generate statements with eid available
+    generate_hook_body(gen, entity, HOOK_CREATE, &plan->residual);
 }
 
-// Generate entity update function
-static void generate_entity_update(CodeGen* gen, EntityDecl* entity) {
-    if (!entity->on_update) return;  // Skip if no on_update
-
+static void generate_entity_create(CodeGen* gen, EntityDecl* entity, CreatePlan* plan) {
+    // Lowercase the entity name for the function
     char lower_name[256];
     snprintf(lower_name, sizeof(lower_name), "%s", entity->name.lexeme);
     for (int i = 0; lower_name[i]; i++) {
         if (lower_name[i] >= 'A' && lower_name[i] <= 'Z') {
-            lower_name[i] = lower_name[i] + 32;
+            lower_name[i] = lower_name[i] + 32;  // to lowercase
         }
     }
 
-    appendf(gen, "void %s_update(GameState* game, uint32_t entity_id) {\n", lower_name);
-    gen->indent_level++;
+    generate_prototype(gen, entity, plan, lower_name);
 
-    // Find the entity by entity_id
-    append_indent(gen);
-    appendf(gen, "%s* entity = NULL;\n", entity->name.lexeme);
-    append_indent(gen);
-    appendf(gen, "for (int i = 0; i < game->%ss.count; i++) {\n", lower_name);
+    append_hook_prefix(gen, entity, HOOK_CREATE);
+    appendf(gen, "uint32_t %s_create%s(GameState* game, float x, float y) {\n", lower_name, hook_body_suffix(gen));
     gen->indent_level++;
+
+    if (entity->singleton) {
+        append_indent(gen);
+        appendf(gen, "if (game->%ss.count > 0) return game->%ss.data[0].entity_id;  // singleton\n",
+                lower_name, lower_name);
+        append(gen, "\n");
+    }
+
+    char upper_name[256];
+    snprintf(upper_name, sizeof(upper_name), "%s", entity->name.lexeme);
+    for (int i = 0; upper_name[i]; i++) {
+        if (upper_name[i] >= 'a' && upper_name[i] <= 'z') upper_name[i] -= 32;
+    }
+
+    if (entity->pooled) {
+        append_indent(gen);
+        append(gen, "uint32_t entity_id;\n");
+        append_indent(gen);
+        appendf(gen, "if (game->%ss.parked > 0) {\n", lower_name);
+        gen->indent_level++;
+        append_indent(gen);
+        append(gen, "// Reuse a parked instance: its engine entity never went away\n");
+        append_indent(gen);
+        appendf(gen, "game->%ss.parked--;\n", lower_name);
+        append_indent(gen);
+        appendf(gen, "entity_id = game->%ss.data[game->%ss.count].entity_id;\n", lower_name, lower_name);
+        generate_collision_from_init(gen, entity, false);
+        gen->indent_level--;
+        append_indent(gen);
+        append(gen, "} else {\n");
+        gen->indent_level++;
+        append_indent(gen);
+        append(gen, "entity_id = entity_create(&game->registry, &game->transforms,\n");
+        append_indent(gen);
+        append(gen, "    &game->renderables, &game->circles, &game->rectangles);\n");
+        generate_collision_from_init(gen, entity, true);
+        append_indent(gen);
+        append(gen, "if (entity_id >= (uint32_t)game->entity_type_capacity) whisker_grow_entity_types(game, entity_id);\n");
+        append_indent(gen);
+        appendf(gen, "game->entity_types[entity_id] = ENTITY_TYPE_%s;\n", upper_name);
+        append_indent(gen);
+        appendf(gen, "if (game->%ss.count >= game->%ss.capacity) {\n", lower_name, lower_name);
+        gen->indent_level++;
+        append_indent(gen);
+        appendf(gen, "game->%ss.capacity = game->%ss.capacity == 0 ? 8 : game->%ss.capacity * 2;\n",
+                lower_name, lower_name, lower_name);
+        append_indent(gen);
+        appendf(gen, "game->%ss.data = realloc(game->%ss.data, sizeof(%s) * game->%ss.capacity);\n",
+                lower_name, lower_name, entity->name.lexeme, lower_name);
+        gen->indent_level--;
+        append_indent(gen);
+        append(gen, "}\n");
+        gen->indent_level--;
+        append_indent(gen);
+        append(gen, "}\n");
+        append(gen, "\n");
+    } else {
+        generate_engine_entity(gen, entity, upper_name);
+    }
+
+    generate_default_components(gen, entity);
+
+    // Add to game-specific array (with realloc if needed)
+    if (entity->pooled) {
+        append_indent(gen);
+        appendf(gen, "game->entity_slots[entity_id] = game->%ss.count;\n", lower_name);
+    } else if (!entity->singleton) {
+        appendf(gen, "    if (game->%ss.count >= game->%ss.capacity) {\n", lower_name, lower_name);
+        appendf(gen, "        game->%ss.capacity = game->%ss.capacity == 0 ? 8 : game->%ss.capacity * 2;\n",
+                lower_name, lower_name, lower_name);
+        appendf(gen, "        game->%ss.data = realloc(game->%ss.data, sizeof(%s) * game->%ss.capacity);\n",
+                lower_name, lower_name, entity->name.lexeme, lower_name);
+        append(gen, "    }\n");
+        append(gen, "\n");
+    }
+
+    // Initialize entity struct from the prototype
     append_indent(gen);
-    appendf(gen, "if (game->%ss.data[i].entity_id == entity_id) {\n", lower_name);
-    gen->indent_level++;
-    append_indent(gen);
-    appendf(gen, "entity = &game->%ss.data[i];\n", lower_name);
-    append_indent(gen);
-    append(gen, "break;\n");
-    gen->indent_level--;
-    append_indent(gen);
-    append(gen, "}\n");
-    gen->indent_level--;
-    append_indent(gen);
-    append(gen, "}\n");
+    appendf(gen, "game->%ss.data[game->%ss.count] = %s_prototype;\n", lower_name, lower_name, lower_name);
     append_indent(gen);
-    append(gen, "if (!entity) return;\n");
+    appendf(gen, "game->%ss.data[game->%ss.count++].entity_id = entity_id;\n", lower_name, lower_name);
     append(gen, "\n");
 
-    // Make eid available for component access
-    append_indent(gen);
-    append(gen, "uint32_t eid = entity_id;\n");
-    append(gen, "\n");
+    char record[600];
+    snprintf(record, sizeof(record), "&game->%ss.data[game->%ss.count - 1]", lower_name, lower_name);
+    generate_create_body(gen, entity, plan, record);
 
-    // Generate on_update code
     append_indent(gen);
-    append(gen, "// on_update\n");
-    generate_stmt(gen, entity->on_update, entity->name.lexeme);
+    append(gen, "return entity_id;\n");
 
     gen->indent_level--;
     append(gen, "}\n\n");
+
+    if (gen->options.profile) {
+        char name[300];
+        snprintf(name, sizeof(name), "%s_create", lower_name);
+        generate_profiled_hook(gen, entity, HOOK_CREATE, "uint32_t", name,
+                               "GameState* game, float x, float y", "game, x, y");
+    }
 }
 
-static void generate_entity_destroy(CodeGen* gen, EntityDecl* entity, Program* program) {
+// X_spawn_many(game, n, xs, ys) creates n instances at once: the array
+// grows once and the prototype is stamped into all n slots with memcpy
+// before the engine entities are made. on_create still runs per instance,
+// in order. When on_create spawns (which can move the array under us), the
+// type is pooled or a singleton, or hooks are profiled, it falls back to n
+// X_create calls.
+static void generate_entity_spawn_many(CodeGen* gen, EntityDecl* entity, CreatePlan* plan) {
     char lower_name[256];
-    snprintf(lower_name, sizeof(lower_name), "%s", entity->name.lexeme);
-    for (int i = 0; lower_name[i]; i++) {
-        if (lower_name[i] >= 'A' && lower_name[i] <= 'Z') {
-            lower_name[i] = lower_name[i] + 32;
-        }
+    lower_entity_name(entity, lower_name, sizeof(lower_name));
+    char upper_name[256];
+    snprintf(upper_name, sizeof(upper_name), "%s", entity->name.lexeme);
+    for (int i = 0; upper_name[i]; i++) {
+        if (upper_name[i] >= 'a' && upper_name[i] <= 'z') upper_name[i] -= 32;
     }
 
-    appendf(gen, "void %s_destroy(GameState* game, uint32_t entity_id) {\n", lower_name);
+    appendf(gen, "void %s_spawn_many(GameState* game, int n, const float* xs, const float* ys) {\n", lower_name);
     gen->indent_level++;
+    append_indent(gen);
+    append(gen, "if (n <= 0) return;\n");
 
-    // Run on_destroy user code first
-    if (entity->on_destroy) {
+    if (!entity->pooled && !entity->singleton) {
         append_indent(gen);
-        appendf(gen, "%s* entity = NULL;\n", entity->name.lexeme);
+        appendf(gen, "int first = game->%ss.count;\n", lower_name);
         append_indent(gen);
-        appendf(gen, "for (int i = 0; i < game->%ss.count; i++) {\n", lower_name);
+        appendf(gen, "if (first + n > game->%ss.capacity) {\n", lower_name);
         gen->indent_level++;
         append_indent(gen);
-        appendf(gen, "if (game->%ss.data[i].entity_id == entity_id) {\n", lower_name);
-        gen->indent_level++;
+        appendf(gen, "int capacity = game->%ss.capacity == 0 ? 8 : game->%ss.capacity;\n", lower_name, lower_name);
         append_indent(gen);
-        appendf(gen, "entity = &game->%ss.data[i];\n", lower_name);
+        append(gen, "while (capacity < first + n) capacity *= 2;\n");
         append_indent(gen);
-        append(gen, "break;\n");
-        gen->indent_level--;
+        appendf(gen, "game->%ss.capacity = capacity;\n", lower_name);
         append_indent(gen);
-        append(gen, "}\n");
+        appendf(gen, "game->%ss.data = realloc(game->%ss.data, sizeof(%s) * capacity);\n",
+                lower_name, lower_name, entity->name.lexeme);
         gen->indent_level--;
         append_indent(gen);
         append(gen, "}\n");
+    }
+    append(gen, "\n");
 
+    bool batched = !entity->pooled && !entity->singleton && !gen->options.profile &&
+                   !(entity->effects[HOOK_CREATE].effects & EFFECTS_MOVING);
+    if (!batched) {
         append_indent(gen);
-        append(gen, "if (!entity) return;\n");
+        append(gen, "for (int i = 0; i < n; i++) {\n");
         append_indent(gen);
-        append(gen, "uint32_t eid = entity_id;\n");
+        appendf(gen, "    %s_create(game, xs[i], ys[i]);\n", lower_name);
         append_indent(gen);
-        append(gen, "// on_destroy\n");
-        generate_stmt(gen, entity->on_destroy, entity->name.lexeme);
-        append(gen, "\n");
+        append(gen, "}\n");
+        gen->indent_level--;
+        append(gen, "}\n\n");
+        return;
     }
 
-    // Call engine destroy (swap-and-pop)
     append_indent(gen);
-    append(gen, "int moved_id = entity_destroy(&game->registry, entity_id,\n");
+    appendf(gen, "%s* records = &game->%ss.data[first];\n", entity->name.lexeme, lower_name);
     append_indent(gen);
-    append(gen, "    &game->transforms, &game->renderables,\n");
+    appendf(gen, "records[0] = %s_prototype;\n", lower_name);
     append_indent(gen);
-    append(gen, "    &game->circles, &game->rectangles);\n");
+    append(gen, "for (int done = 1; done < n; done *= 2) {\n");
+    append_indent(gen);
+    appendf(gen, "    memcpy(records + done, records, sizeof(%s) * (size_t)(done < n - done ? done : n - done));\n",
+            entity->name.lexeme);
+    append_indent(gen);
+    append(gen, "}\n");
     append(gen, "\n");
 
-    // Remove from this entity's array
-    append_indent(gen);
-    appendf(gen, "for (int i = 0; i < game->%ss.count; i++) {\n", lower_name);
-    gen->indent_level++;
     append_indent(gen);
-    appendf(gen, "if (game->%ss.data[i].entity_id == entity_id) {\n", lower_name);
+    append(gen, "for (int i = 0; i < n; i++) {\n");
     gen->indent_level++;
     append_indent(gen);
-    appendf(gen, "game->%ss.data[i] = game->%ss.data[game->%ss.count - 1];\n",
-            lower_name, lower_name, lower_name);
+    append(gen, "float x = xs[i], y = ys[i];\n");
+    generate_engine_entity(gen, entity, upper_name);
+    generate_default_components(gen, entity);
     append_indent(gen);
-    appendf(gen, "game->%ss.count--;\n", lower_name);
+    append(gen, "records[i].entity_id = entity_id;\n");
     append_indent(gen);
-    append(gen, "break;\n");
+    appendf(gen, "game->%ss.count++;\n", lower_name);
+    generate_create_body(gen, entity, plan, "&records[i]");
     gen->indent_level--;
     append_indent(gen);
     append(gen, "}\n");
+
     gen->indent_level--;
-    append_indent(gen);
-    append(gen, "}\n");
-    append(gen, "\n");
+    append(gen, "}\n\n");
+}
 
-    // Update moved entity references in ALL entity arrays
-    append_indent(gen);
-    append(gen, "// Fix moved entity references (swap-and-pop)\n");
-    append_indent(gen);
-    append(gen, "if (moved_id != -1) {\n");
-    gen->indent_level++;
+// --parallel: an update hook that only touches its own instance (its fields
+// and component slots) can run on the pool. Anything that destroys, spawns,
+// looks at other entities or calls unknown C stays on the calling
+// thread, in order. Profiled builds stay serial: the counters are not atomic.
+// A singleton has nothing to split.
+static bool can_schedule(CodeGen* gen) {
+    return gen->options.parallel && !gen->options.profile;
+}
+
+static bool update_is_parallel(CodeGen* gen, EntityDecl* entity) {
+    if (!can_schedule(gen) || !entity->on_update || entity->singleton) return false;
+    return (entity->effects[HOOK_UPDATE].effects & ~(unsigned)EFFECT_INPUT) == 0;
+}
 
+// Whether two types' update loops must keep their program order. Component
+// slots belong to one entity each, so writing your own transform never races
+// with another type touching its own; place_meeting, though, reads every
+// entity's transform and collision shape.
+static bool updates_conflict(EntityDecl* a, EntityDecl* b) {
+    HookEffects* x = &a->effects[HOOK_UPDATE];
+    HookEffects* y = &b->effects[HOOK_UPDATE];
+    if ((x->effects | y->effects) & (EFFECTS_MOVING | EFFECT_DESTROY)) return true;
+
+    unsigned shapes = COMPONENT_TRANSFORM | COMPONENT_COLLISION;
+    if ((x->effects & EFFECT_QUERY) && (y->component_writes & shapes)) return true;
+    if ((y->effects & EFFECT_QUERY) && (x->component_writes & shapes)) return true;
+    return false;
+}
+
+// Puts each type with an update hook into the earliest stage after every
+// earlier type it conflicts with; types sharing a stage run concurrently.
+// stage_of[i] is -1 for types without one. Returns the number of stages.
+static int schedule_updates(CodeGen* gen, Program* program, int* stage_of) {
+    int stage_count = 0;
     for (int i = 0; i < program->entity_count; i++) {
-        char other_lower[256];
-        snprintf(other_lower, sizeof(other_lower), "%s", program->entities[i]->name.lexeme);
-        for (int j = 0; other_lower[j]; j++) {
-            if (other_lower[j] >= 'A' && other_lower[j] <= 'Z') {
-                other_lower[j] = other_lower[j] + 32;
+        stage_of[i] = -1;
+        if (!program->entities[i]->on_update) continue;
+
+        int stage = 0;
+        for (int j = 0; j < i; j++) {
+            if (stage_of[j] < 0) continue;
+            if (!can_schedule(gen) || updates_conflict(program->entities[i], program->entities[j])) {
+                if (stage_of[j] + 1 > stage) stage = stage_of[j] + 1;
             }
         }
-
-        append_indent(gen);
-        appendf(gen, "for (int i = 0; i < game->%ss.count; i++) {\n", other_lower);
-        gen->indent_level++;
-        append_indent(gen);
-        appendf(gen, "if (game->%ss.data[i].entity_id == (uint32_t)moved_id) {\n", other_lower);
-        gen->indent_level++;
-        append_indent(gen);
-        appendf(gen, "game->%ss.data[i].entity_id = entity_id;\n", other_lower);
-        append_indent(gen);
-        append(gen, "break;\n");
-        gen->indent_level--;
-        append_indent(gen);
-        append(gen, "}\n");
-        gen->indent_level--;
-        append_indent(gen);
-        append(gen, "}\n");
+        stage_of[i] = stage;
+        if (stage + 1 > stage_count) stage_count = stage + 1;
     }
-
-    gen->indent_level--;
-    append_indent(gen);
-    append(gen, "}\n");
-
-    gen->indent_level--;
-    append(gen, "}\n\n");
+    return stage_count;
 }
 
-//dispatcher
-static void generate_instance_destroy(CodeGen* gen, Program* program) {
-    append(gen, "void instance_destroy(GameState* game, uint32_t entity_id) {\n");
-    gen->indent_level++;
+static int stage_size(Program* program, int* stage_of, int stage) {
+    int size = 0;
+    for (int i = 0; i < program->entity_count; i++) {
+        if (stage_of[i] == stage) size++;
+    }
+    return size;
+}
 
-    //append_indent(gen);
-    //append(gen, "printf(\"instance_destroy called on entity %d\\n\", entity_id);\n");
+// Whether the generated source needs the thread pool at all.
+static bool program_has_parallel(CodeGen* gen, Program* program) {
+    if (!can_schedule(gen)) return false;
 
-    append_indent(gen);
-    append(gen, "switch (game->entity_types[entity_id]) {\n");
+    int* stage_of = malloc(sizeof(int) * (program->entity_count ? program->entity_count : 1));
+    if (!stage_of) error(error_messages[ERROR_MALLOCFAIL].message);
+    int stage_count = schedule_updates(gen, program, stage_of);
 
+    bool used = false;
     for (int i = 0; i < program->entity_count; i++) {
-        char upper_name[256];
-        snprintf(upper_name, sizeof(upper_name), "%s", program->entities[i]->name.lexeme);
-        for (int j = 0; upper_name[j]; j++) {
-            if (upper_name[j] >= 'a' && upper_name[j] <= 'z') upper_name[j] -= 32;
-        }
+        if (update_is_parallel(gen, program->entities[i])) used = true;
+    }
+    for (int s = 0; s < stage_count; s++) {
+        if (stage_size(program, stage_of, s) > 1) used = true;
+    }
+    free(stage_of);
+    return used;
+}
+
+// A fixed pool of worker threads, started on first use. Each parallel-for
+// hands every worker (the caller included) an even slice of the index range;
+// a worker takes chunks off the front of its own slice and, once that is
+// empty, steals chunks from the others' slices.
+static void generate_parallel_runtime(CodeGen* gen) {
+    append(gen, "#include <pthread.h>\n");
+    append(gen, "#include <unistd.h>\n\n");
+    append(gen, "#define WHISKER_MAX_WORKERS 64\n");
+    append(gen, "#define WHISKER_PARALLEL_MIN 1024  // fewer instances run inline\n");
+    append(gen, "#define WHISKER_PARALLEL_CHUNK 64\n\n");
+    append(gen, "typedef void (*WhiskerRangeFn)(GameState* game, int begin, int end);\n\n");
+    append(gen, "typedef struct {\n");
+    append(gen, "    int next;  // claimed with an atomic add, by the owner and by thieves\n");
+    append(gen, "    int end;\n");
+    append(gen, "    char pad[56];\n");
+    append(gen, "} WhiskerSlice;\n\n");
+    append(gen, "typedef struct {\n");
+    append(gen, "    pthread_t threads[WHISKER_MAX_WORKERS];\n");
+    append(gen, "    int workers;  // including the thread that calls game_update\n");
+    append(gen, "    pthread_mutex_t lock;\n");
+    append(gen, "    pthread_cond_t start;\n");
+    append(gen, "    pthread_cond_t done;\n");
+    append(gen, "    unsigned generation;\n");
+    append(gen, "    int running;\n");
+    append(gen, "    bool quit;\n");
+    append(gen, "    WhiskerRangeFn fn;\n");
+    append(gen, "    GameState* game;\n");
+    append(gen, "    WhiskerSlice slices[WHISKER_MAX_WORKERS];\n");
+    append(gen, "} WhiskerPool;\n\n");
+    append(gen, "static WhiskerPool whisker_pool = {.lock = PTHREAD_MUTEX_INITIALIZER,\n");
+    append(gen, "                                   .start = PTHREAD_COND_INITIALIZER,\n");
+    append(gen, "                                   .done = PTHREAD_COND_INITIALIZER};\n\n");
+    append(gen, "static bool whisker_steal(WhiskerSlice* slice, int* begin, int* end) {\n");
+    append(gen, "    if (__atomic_load_n(&slice->next, __ATOMIC_RELAXED) >= slice->end) return false;\n");
+    append(gen, "    int b = __atomic_fetch_add(&slice->next, WHISKER_PARALLEL_CHUNK, __ATOMIC_RELAXED);\n");
+    append(gen, "    if (b >= slice->end) return false;\n");
+    append(gen, "    *begin = b;\n");
+    append(gen, "    *end = b + WHISKER_PARALLEL_CHUNK < slice->end ? b + WHISKER_PARALLEL_CHUNK : slice->end;\n");
+    append(gen, "    return true;\n");
+    append(gen, "}\n\n");
+    append(gen, "static void whisker_work(int self) {\n");
+    append(gen, "    WhiskerPool* pool = &whisker_pool;\n");
+    append(gen, "    int begin, end;\n");
+    append(gen, "    for (int v = 0; v < pool->workers; v++) {\n");
+    append(gen, "        WhiskerSlice* slice = &pool->slices[(self + v) % pool->workers];\n");
+    append(gen, "        while (whisker_steal(slice, &begin, &end)) {\n");
+    append(gen, "            pool->fn(pool->game, begin, end);\n");
+    append(gen, "        }\n");
+    append(gen, "    }\n");
+    append(gen, "}\n\n");
+    append(gen, "static void* whisker_worker(void* arg) {\n");
+    append(gen, "    WhiskerPool* pool = &whisker_pool;\n");
+    append(gen, "    int self = (int)(intptr_t)arg;\n");
+    append(gen, "    unsigned seen = 0;\n");
+    append(gen, "    pthread_mutex_lock(&pool->lock);\n");
+    append(gen, "    for (;;) {\n");
+    append(gen, "        while (pool->generation == seen && !pool->quit) pthread_cond_wait(&pool->start, &pool->lock);\n");
+    append(gen, "        if (pool->quit) break;\n");
+    append(gen, "        seen = pool->generation;\n");
+    append(gen, "        pthread_mutex_unlock(&pool->lock);\n");
+    append(gen, "        whisker_work(self);\n");
+    append(gen, "        pthread_mutex_lock(&pool->lock);\n");
+    append(gen, "        if (--pool->running == 0) pthread_cond_signal(&pool->done);\n");
+    append(gen, "    }\n");
+    append(gen, "    pthread_mutex_unlock(&pool->lock);\n");
+    append(gen, "    return NULL;\n");
+    append(gen, "}\n\n");
+    append(gen, "static void whisker_pool_start(void) {\n");
+    append(gen, "    WhiskerPool* pool = &whisker_pool;\n");
+    append(gen, "    const char* env = getenv(\"WHISKER_THREADS\");\n");
+    append(gen, "    long cpus = env ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);\n");
+    append(gen, "    pool->workers = cpus < 1 ? 1 : cpus > WHISKER_MAX_WORKERS ? WHISKER_MAX_WORKERS : (int)cpus;\n");
+    append(gen, "    for (int i = 1; i < pool->workers; i++) {\n");
+    append(gen, "        if (pthread_create(&pool->threads[i], NULL, whisker_worker, (void*)(intptr_t)i) != 0) {\n");
+    append(gen, "            pool->workers = i;  // run with what we got\n");
+    append(gen, "            break;\n");
+    append(gen, "        }\n");
+    append(gen, "    }\n");
+    append(gen, "}\n\n");
+    append(gen, "static void whisker_pool_stop(void) {\n");
+    append(gen, "    WhiskerPool* pool = &whisker_pool;\n");
+    append(gen, "    if (pool->workers == 0) return;\n");
+    append(gen, "    pthread_mutex_lock(&pool->lock);\n");
+    append(gen, "    pool->quit = true;\n");
+    append(gen, "    pthread_cond_broadcast(&pool->start);\n");
+    append(gen, "    pthread_mutex_unlock(&pool->lock);\n");
+    append(gen, "    for (int i = 1; i < pool->workers; i++) {\n");
+    append(gen, "        pthread_join(pool->threads[i], NULL);\n");
+    append(gen, "    }\n");
+    append(gen, "    pool->workers = 0;\n");
+    append(gen, "    pool->quit = false;\n");
+    append(gen, "}\n\n");
+    append(gen, "// Runs the part of [begin, end) that falls in [base, base + count) as fn's\n");
+    append(gen, "// own indices; lets one parallel-for cover several types' loops.\n");
+    append(gen, "static inline void whisker_run_slice(GameState* game, int begin, int end, int base, int count, WhiskerRangeFn fn) {\n");
+    append(gen, "    int b = begin > base ? begin : base;\n");
+    append(gen, "    int e = end < base + count ? end : base + count;\n");
+    append(gen, "    if (b < e) fn(game, b - base, e - base);\n");
+    append(gen, "}\n\n");
+    append(gen, "// Returns once fn has covered [0, count). Chunks start on multiples of\n");
+    append(gen, "// WHISKER_PARALLEL_CHUNK. Fewer than min indices run inline.\n");
+    append(gen, "static void whisker_parallel_for(GameState* game, int count, int min, WhiskerRangeFn fn) {\n");
+    append(gen, "    WhiskerPool* pool = &whisker_pool;\n");
+    append(gen, "    if (count < min) {\n");
+    append(gen, "        fn(game, 0, count);\n");
+    append(gen, "        return;\n");
+    append(gen, "    }\n");
+    append(gen, "    if (pool->workers == 0) whisker_pool_start();\n");
+    append(gen, "    if (pool->workers == 1) {\n");
+    append(gen, "        fn(game, 0, count);\n");
+    append(gen, "        return;\n");
+    append(gen, "    }\n\n");
+    append(gen, "    for (int i = 0; i < pool->workers; i++) {\n");
+    append(gen, "        int chunks = (count + WHISKER_PARALLEL_CHUNK - 1) / WHISKER_PARALLEL_CHUNK;\n");
+    append(gen, "        int first = (int)((long long)chunks * i / pool->workers);\n");
+    append(gen, "        int last = (int)((long long)chunks * (i + 1) / pool->workers);\n");
+    append(gen, "        pool->slices[i].next = first * WHISKER_PARALLEL_CHUNK;\n");
+    append(gen, "        pool->slices[i].end = last * WHISKER_PARALLEL_CHUNK < count ? last * WHISKER_PARALLEL_CHUNK : count;\n");
+    append(gen, "    }\n");
+    append(gen, "    pthread_mutex_lock(&pool->lock);\n");
+    append(gen, "    pool->fn = fn;\n");
+    append(gen, "    pool->game = game;\n");
+    append(gen, "    pool->running = pool->workers - 1;\n");
+    append(gen, "    pool->generation++;\n");
+    append(gen, "    pthread_cond_broadcast(&pool->start);\n");
+    append(gen, "    pthread_mutex_unlock(&pool->lock);\n\n");
+    append(gen, "    whisker_work(0);\n\n");
+    append(gen, "    pthread_mutex_lock(&pool->lock);\n");
+    append(gen, "    while (pool->running > 0) pthread_cond_wait(&pool->done, &pool->lock);\n");
+    append(gen, "    pthread_mutex_unlock(&pool->lock);\n");
+    append(gen, "}\n\n");
+}
+
+// Generate entity update function
+// `entity` = the instance with entity_id, or return if it is gone. A
+// singleton's instance sits at a fixed address, so there is no search.
+static void generate_find_entity(CodeGen* gen, EntityDecl* entity, const char* lower_name) {
+    if (entity->singleton) {
+        append_indent(gen);
+        appendf(gen, "if (game->%ss.count == 0 || game->%ss.data[0].entity_id != entity_id) return;\n",
+                lower_name, lower_name);
+        append_indent(gen);
+        appendf(gen, "%s* entity = &game->%ss.data[0];\n", entity->name.lexeme, lower_name);
+        return;
+    }
+    append_indent(gen);
+    appendf(gen, "%s* entity = NULL;\n", entity->name.lexeme);
+    append_indent(gen);
+    appendf(gen, "for (int i = 0; i < game->%ss.count; i++) {\n", lower_name);
+    gen->indent_level++;
+    append_indent(gen);
+    appendf(gen, "if (game->%ss.data[i].entity_id == entity_id) {\n", lower_name);
+    gen->indent_level++;
+    append_indent(gen);
+    appendf(gen, "entity = &game->%ss.data[i];\n", lower_name);
+    append_indent(gen);
+    append(gen, "break;\n");
+    gen->indent_level--;
+    append_indent(gen);
+    append(gen, "}\n");
+    gen->indent_level--;
+    append_indent(gen);
+    append(gen, "}\n");
+    append_indent(gen);
+    append(gen, "if (!entity) return;\n");
+}
+
+static void generate_entity_update(CodeGen* gen, EntityDecl* entity) {
+    if (!entity->on_update) return;  // Skip if no on_update
+
+    char lower_name[256];
+    snprintf(lower_name, sizeof(lower_name), "%s", entity->name.lexeme);
+    for (int i = 0; lower_name[i]; i++) {
+        if (lower_name[i] >= 'A' && lower_name[i] <= 'Z') {
+            lower_name[i] = lower_name[i] + 32;
+        }
+    }
+
+    bool parallel = update_is_parallel(gen, entity);
+    if (parallel) {
+        // The body takes the instance directly, so the pool can walk the
+        // dense array without looking each id up.
+        append_hook_prefix(gen, entity, HOOK_UPDATE);
+        appendf(gen, "static void %s_update_entity(GameState* game, %s* entity) {\n",
+                lower_name, entity->name.lexeme);
+        gen->indent_level++;
+        append_indent(gen);
+        append(gen, "uint32_t eid = entity->entity_id;\n");
+        append(gen, "\n");
+        append_indent(gen);
+        append(gen, "// on_update\n");
+        generate_hook_body(gen, entity, HOOK_UPDATE, entity->on_update);
+        gen->indent_level--;
+        append(gen, "}\n\n");
+
+        appendf(gen, "static void %s_update_range(GameState* game, int begin, int end) {\n", lower_name);
+        gen->indent_level++;
+        append_indent(gen);
+        append(gen, "for (int i = begin; i < end; i++) {\n");
+        gen->indent_level++;
+        append_indent(gen);
+        appendf(gen, "%s_update_entity(game, &game->%ss.data[i]);\n", lower_name, lower_name);
+        gen->indent_level--;
+        append_indent(gen);
+        append(gen, "}\n");
+        gen->indent_level--;
+        append(gen, "}\n\n");
+    } else {
+        append_hook_prefix(gen, entity, HOOK_UPDATE);
+    }
+    appendf(gen, "void %s_update%s(GameState* game, uint32_t entity_id) {\n", lower_name, hook_body_suffix(gen));
+    gen->indent_level++;
+
+    // Find the entity by entity_id
+    generate_find_entity(gen, entity, lower_name);
+
+    if (parallel) {
+        append_indent(gen);
+        appendf(gen, "%s_update_entity(game, entity);\n", lower_name);
+    } else {
+        append(gen, "\n");
+
+        // Make eid available for component access
+        append_indent(gen);
+        append(gen, "uint32_t eid = entity_id;\n");
+        append(gen, "\n");
+
+        // Generate on_update code
+        append_indent(gen);
+        append(gen, "// on_update\n");
+        generate_hook_body(gen, entity, HOOK_UPDATE, entity->on_update);
+    }
+
+    gen->indent_level--;
+    append(gen, "}\n\n");
+
+    if (gen->options.profile) {
+        char name[300];
+        snprintf(name, sizeof(name), "%s_update", lower_name);
+        generate_profiled_hook(gen, entity, HOOK_UPDATE, "void", name,
+                               "GameState* game, uint32_t entity_id", "game, entity_id");
+    }
+}
+
+// Parks the instance instead of destroying it: the engine entity stays, with
+// no collision and no sprite, and the record moves to the front of the parked
+// tail after data[count] for the next X_create to pick up.
+static void generate_pooled_destroy(CodeGen* gen, EntityDecl* entity, const char* lower_name) {
+    append_indent(gen);
+    append(gen, "int slot = game->entity_slots[entity_id];\n");
+    append_indent(gen);
+    appendf(gen, "if (slot >= game->%ss.count) return;  // already parked\n", lower_name);
+
+    if (entity->on_destroy) {
+        append_indent(gen);
+        appendf(gen, "%s* entity = &game->%ss.data[slot];\n", entity->name.lexeme, lower_name);
+        append_indent(gen);
+        append(gen, "uint32_t eid = entity_id;\n");
+        append_indent(gen);
+        append(gen, "// on_destroy\n");
+        generate_hook_body(gen, entity, HOOK_DESTROY, entity->on_destroy);
+    }
+    append(gen, "\n");
+
+    // Hide the parked instance; a type without a shape or sprite has neither to clear.
+    TypeInfo info = type_info_evaluate(entity);
+    unsigned components = type_components(entity, &info);
+    if (components & COMPONENT_COLLISION) {
+        append_indent(gen);
+        append(gen, "entity_set_collision(&game->registry, entity_id, COLLISION_NONE);\n");
+    }
+    if (components & COMPONENT_RENDERABLE) {
+        append_indent(gen);
+        append(gen, "game->renderables.data[entity_id].current_sprite_id = SPRITE_NONE;\n");
+    }
+    append_indent(gen);
+    appendf(gen, "int last = --game->%ss.count;\n", lower_name);
+    append_indent(gen);
+    appendf(gen, "%s parked = game->%ss.data[slot];\n", entity->name.lexeme, lower_name);
+    append_indent(gen);
+    appendf(gen, "game->%ss.data[slot] = game->%ss.data[last];\n", lower_name, lower_name);
+    append_indent(gen);
+    appendf(gen, "game->%ss.data[last] = parked;\n", lower_name);
+    append_indent(gen);
+    appendf(gen, "game->entity_slots[game->%ss.data[slot].entity_id] = slot;\n", lower_name);
+    append_indent(gen);
+    append(gen, "game->entity_slots[entity_id] = last;\n");
+    append_indent(gen);
+    appendf(gen, "game->%ss.parked++;\n", lower_name);
+    append_indent(gen);
+    append(gen, "whisker_retarget_destroys(game, entity_id, UINT32_MAX);\n");
+}
+
+static void generate_engine_destroy(CodeGen* gen, EntityDecl* entity, Program* program, const char* lower_name) {
+    // Run on_destroy user code first
+    if (entity->on_destroy) {
+        generate_find_entity(gen, entity, lower_name);
+        append_indent(gen);
+        append(gen, "uint32_t eid = entity_id;\n");
+        append_indent(gen);
+        append(gen, "// on_destroy\n");
+        generate_hook_body(gen, entity, HOOK_DESTROY, entity->on_destroy);
+        append(gen, "\n");
+    }
+
+    // A stale id must not empty the singleton; with on_destroy,
+    // generate_find_entity has already checked it.
+    if (entity->singleton && !entity->on_destroy) {
+        append_indent(gen);
+        appendf(gen, "if (game->%ss.count == 0 || game->%ss.data[0].entity_id != entity_id) return;\n",
+                lower_name, lower_name);
+        append(gen, "\n");
+    }
+
+    // Call engine destroy (swap-and-pop)
+    append_indent(gen);
+    append(gen, "int moved_id = entity_destroy(&game->registry, entity_id,\n");
+    append_indent(gen);
+    append(gen, "    &game->transforms, &game->renderables,\n");
+    append_indent(gen);
+    append(gen, "    &game->circles, &game->rectangles);\n");
+    append(gen, "\n");
+
+    // Remove from this entity's array
+    if (entity->singleton) {
+        append_indent(gen);
+        appendf(gen, "game->%ss.count = 0;\n", lower_name);
+    } else {
+        append_indent(gen);
+        appendf(gen, "for (int i = 0; i < game->%ss.count; i++) {\n", lower_name);
+        gen->indent_level++;
+        append_indent(gen);
+        appendf(gen, "if (game->%ss.data[i].entity_id == entity_id) {\n", lower_name);
+        gen->indent_level++;
+        append_indent(gen);
+        appendf(gen, "game->%ss.data[i] = game->%ss.data[game->%ss.count - 1];\n",
+                lower_name, lower_name, lower_name);
+        append_indent(gen);
+        appendf(gen, "game->%ss.count--;\n", lower_name);
+        append_indent(gen);
+        append(gen, "break;\n");
+        gen->indent_level--;
+        append_indent(gen);
+        append(gen, "}\n");
+        gen->indent_level--;
+        append_indent(gen);
+        append(gen, "}\n");
+    }
+    append(gen, "\n");
+
+    // Only the moved entity's own array refers to moved_id
+    append_indent(gen);
+    append(gen, "// Fix moved entity references (swap-and-pop)\n");
+    append_indent(gen);
+    append(gen, "if (moved_id != -1) {\n");
+    gen->indent_level++;
+    append_indent(gen);
+    append(gen, "EntityType moved_type = game->entity_types[moved_id];\n");
+    append_indent(gen);
+    append(gen, "game->entity_types[entity_id] = moved_type;\n");
+    append_indent(gen);
+    append(gen, "switch (moved_type) {\n");
+
+    for (int i = 0; i < program->entity_count; i++) {
+        char other_lower[256];
+        char other_upper[256];
+        snprintf(other_lower, sizeof(other_lower), "%s", program->entities[i]->name.lexeme);
+        snprintf(other_upper, sizeof(other_upper), "%s", program->entities[i]->name.lexeme);
+        for (int j = 0; other_lower[j]; j++) {
+            if (other_lower[j] >= 'A' && other_lower[j] <= 'Z') {
+                other_lower[j] = other_lower[j] + 32;
+            }
+            if (other_upper[j] >= 'a' && other_upper[j] <= 'z') {
+                other_upper[j] = other_upper[j] - 32;
+            }
+        }
+
+        append_indent(gen);
+        appendf(gen, "case ENTITY_TYPE_%s:\n", other_upper);
+        gen->indent_level++;
+        if (program->entities[i]->pooled) {
+            // Parked instances move too; entity_slots finds either kind.
+            append_indent(gen);
+            append(gen, "game->entity_slots[entity_id] = game->entity_slots[moved_id];\n");
+            append_indent(gen);
+            appendf(gen, "game->%ss.data[game->entity_slots[entity_id]].entity_id = entity_id;\n", other_lower);
+            append_indent(gen);
+            append(gen, "break;\n");
+            gen->indent_level--;
+            continue;
+        }
+        if (program->entities[i]->singleton) {
+            // The moved entity is the singleton's one instance.
+            append_indent(gen);
+            appendf(gen, "game->%ss.data[0].entity_id = entity_id;\n", other_lower);
+            append_indent(gen);
+            append(gen, "break;\n");
+            gen->indent_level--;
+            continue;
+        }
+        append_indent(gen);
+        appendf(gen, "for (int i = 0; i < game->%ss.count; i++) {\n", other_lower);
+        gen->indent_level++;
+        append_indent(gen);
+        appendf(gen, "if (game->%ss.data[i].entity_id == (uint32_t)moved_id) {\n", other_lower);
+        gen->indent_level++;
+        append_indent(gen);
+        appendf(gen, "game->%ss.data[i].entity_id = entity_id;\n", other_lower);
+        append_indent(gen);
+        append(gen, "break;\n");
+        gen->indent_level--;
+        append_indent(gen);
+        append(gen, "}\n");
+        gen->indent_level--;
+        append_indent(gen);
+        append(gen, "}\n");
+        append_indent(gen);
+        append(gen, "break;\n");
+        gen->indent_level--;
+    }
+
+    append_indent(gen);
+    append(gen, "default:\n");
+    gen->indent_level++;
+    append_indent(gen);
+    append(gen, "break;\n");
+    gen->indent_level--;
+    append_indent(gen);
+    append(gen, "}\n");
+
+    gen->indent_level--;
+    append_indent(gen);
+    append(gen, "}\n");
+    append_indent(gen);
+    append(gen, "whisker_retarget_destroys(game, entity_id, (uint32_t)moved_id);\n");
+}
+
+static void generate_entity_destroy(CodeGen* gen, EntityDecl* entity, Program* program) {
+    char lower_name[256];
+    snprintf(lower_name, sizeof(lower_name), "%s", entity->name.lexeme);
+    for (int i = 0; lower_name[i]; i++) {
+        if (lower_name[i] >= 'A' && lower_name[i] <= 'Z') {
+            lower_name[i] = lower_name[i] + 32;
+        }
+    }
+
+    append_hook_prefix(gen, entity, HOOK_DESTROY);
+    appendf(gen, "void %s_destroy%s(GameState* game, uint32_t entity_id) {\n", lower_name, hook_body_suffix(gen));
+    gen->indent_level++;
+
+    if (entity->pooled) {
+        generate_pooled_destroy(gen, entity, lower_name);
+    } else {
+        generate_engine_destroy(gen, entity, program, lower_name);
+    }
+
+    gen->indent_level--;
+    append(gen, "}\n\n");
+
+    if (gen->options.profile) {
+        char name[300];
+        snprintf(name, sizeof(name), "%s_destroy", lower_name);
+        generate_profiled_hook(gen, entity, HOOK_DESTROY, "void", name,
+                               "GameState* game, uint32_t entity_id", "game, entity_id");
+    }
+}
+
+// Switch arms in declaration order, or hottest first under --profile-use.
+static int* case_order(CodeGen* gen, Program* program, HookKind hook) {
+    int* order = malloc(sizeof(int) * (program->entity_count + 1));
+    if (!order) error(error_messages[ERROR_MALLOCFAIL].message);
+    for (int i = 0; i < program->entity_count; i++) {
+        order[i] = i;
+    }
+
+    ProfileData* data = gen->options.profile_use;
+    if (!data) return order;
+
+    // Insertion sort keeps ties in declaration order.
+    for (int i = 1; i < program->entity_count; i++) {
+        int current = order[i];
+        uint64_t calls = profile_hook_calls(data, program->entities[current]->name.lexeme, hook);
+        int j = i - 1;
+        while (j >= 0 && profile_hook_calls(data, program->entities[order[j]]->name.lexeme, hook) < calls) {
+            order[j + 1] = order[j];
+            j--;
+        }
+        order[j + 1] = current;
+    }
+    return order;
+}
+
+// Bookkeeping keyed by entity id, used by the X_create and X_destroy
+// functions. instance_destroy only queues the id; the swap-and-pop happens in
+// game_flush_destroys, once no update loop is walking the arrays.
+static void generate_id_helpers(CodeGen* gen, Program* program) {
+    append(gen, "// Ids come from the engine, so entity_types grows to whatever it hands out.\n");
+    append(gen, "static void whisker_grow_entity_types(GameState* game, uint32_t entity_id) {\n");
+    append(gen, "    int capacity = game->entity_type_capacity;\n");
+    append(gen, "    while ((uint32_t)capacity <= entity_id) capacity *= 2;\n");
+    append(gen, "    game->entity_types = realloc(game->entity_types, sizeof(EntityType) * capacity);\n");
+    if (program_has_pooled(program)) {
+        append(gen, "    game->entity_slots = realloc(game->entity_slots, sizeof(int) * capacity);\n");
+    }
+    append(gen, "    game->entity_type_capacity = capacity;\n");
+    append(gen, "}\n\n");
+    append(gen, "// X_destroy moved moved_id into entity_id's slot: keep requests queued since\n");
+    append(gen, "// the flush began pointing at the same entities.\n");
+    append(gen, "static void whisker_retarget_destroys(GameState* game, uint32_t entity_id, uint32_t moved_id) {\n");
+    append(gen, "    DestroyQueue* q = &game->destroy_queue;\n");
+    append(gen, "    for (int i = q->applying; i < q->count; i++) {\n");
+    append(gen, "        if (q->data[i] == entity_id) q->data[i] = UINT32_MAX;\n");
+    append(gen, "        else if (moved_id != UINT32_MAX && q->data[i] == moved_id) q->data[i] = entity_id;\n");
+    append(gen, "    }\n");
+    append(gen, "}\n\n");
+}
+
+//dispatcher
+static void generate_instance_destroy(CodeGen* gen, Program* program) {
+    append(gen, "void instance_destroy(GameState* game, uint32_t entity_id) {\n");
+    gen->indent_level++;
+    generate_trace_event(gen, "instance_destroy", 'B');
+
+    //append_indent(gen);
+    //append(gen, "printf(\"instance_destroy called on entity %d\\n\", entity_id);\n");
+
+    append_indent(gen);
+    append(gen, "DestroyQueue* q = &game->destroy_queue;\n");
+    append_indent(gen);
+    append(gen, "if (q->count >= q->capacity) {\n");
+    gen->indent_level++;
+    append_indent(gen);
+    append(gen, "q->capacity = q->capacity == 0 ? 64 : q->capacity * 2;\n");
+    append_indent(gen);
+    append(gen, "q->data = realloc(q->data, sizeof(uint32_t) * q->capacity);\n");
+    gen->indent_level--;
+    append_indent(gen);
+    append(gen, "}\n");
+    append_indent(gen);
+    append(gen, "q->data[q->count++] = entity_id;\n");
+
+    generate_trace_event(gen, "instance_destroy", 'E');
+    gen->indent_level--;
+    append(gen, "}\n\n");
+
+    append(gen, "static int whisker_compare_ids_desc(const void* a, const void* b) {\n");
+    append(gen, "    uint32_t x = *(const uint32_t*)a;\n");
+    append(gen, "    uint32_t y = *(const uint32_t*)b;\n");
+    append(gen, "    return (x < y) - (x > y);\n");
+    append(gen, "}\n\n");
+
+    // Highest id first: swap-and-pop only ever moves the last entity, and by
+    // then every pending id above it is gone, so the rest stay valid.
+    append(gen, "void game_flush_destroys(GameState* game) {\n");
+    gen->indent_level++;
+    generate_trace_event(gen, "game_flush_destroys", 'B');
+    append_indent(gen);
+    append(gen, "DestroyQueue* q = &game->destroy_queue;\n");
+    append_indent(gen);
+    append(gen, "while (q->count > 0) {\n");
+    gen->indent_level++;
+    append_indent(gen);
+    append(gen, "int count = q->count;\n");
+    append_indent(gen);
+    append(gen, "qsort(q->data, count, sizeof(uint32_t), whisker_compare_ids_desc);\n");
+    append_indent(gen);
+    append(gen, "q->applying = count;\n");
+    append_indent(gen);
+    append(gen, "for (int n = 0; n < count; n++) {\n");
+    gen->indent_level++;
+    append_indent(gen);
+    append(gen, "uint32_t entity_id = q->data[n];\n");
+    append_indent(gen);
+    append(gen, "if (entity_id == UINT32_MAX || (n > 0 && entity_id == q->data[n - 1])) continue;\n");
+    append_indent(gen);
+    append(gen, "switch (game->entity_types[entity_id]) {\n");
+
+    int* order = case_order(gen, program, HOOK_DESTROY);
+    for (int n = 0; n < program->entity_count; n++) {
+        int i = order[n];
+        char upper_name[256];
+        snprintf(upper_name, sizeof(upper_name), "%s", program->entities[i]->name.lexeme);
+        for (int j = 0; upper_name[j]; j++) {
+            if (upper_name[j] >= 'a' && upper_name[j] <= 'z') upper_name[j] -= 32;
+        }
 
         char lower_name[256];
         snprintf(lower_name, sizeof(lower_name), "%s", program->entities[i]->name.lexeme);
@@ -758,6 +2139,7 @@ static void generate_instance_destroy(CodeGen* gen, Program* program) {
         append(gen, "break;\n");
         gen->indent_level--;
     }
+    free(order);
 
     append_indent(gen);
     append(gen, "default:\n");
@@ -766,9 +2148,23 @@ static void generate_instance_destroy(CodeGen* gen, Program* program) {
     append(gen, "break;\n");
     gen->indent_level--;
 
+    append_indent(gen);
+    append(gen, "}\n");
+    gen->indent_level--;
     append_indent(gen);
     append(gen, "}\n");
 
+    // Anything on_destroy queued is the next round
+    append_indent(gen);
+    append(gen, "memmove(q->data, q->data + count, sizeof(uint32_t) * (q->count - count));\n");
+    append_indent(gen);
+    append(gen, "q->count -= count;\n");
+    append_indent(gen);
+    append(gen, "q->applying = 0;\n");
+    gen->indent_level--;
+    append_indent(gen);
+    append(gen, "}\n");
+    generate_trace_event(gen, "game_flush_destroys", 'E');
     gen->indent_level--;
     append(gen, "}\n\n");
 }
@@ -782,50 +2178,559 @@ static void generate_entity_collision(CodeGen* gen, EntityDecl* entity) {
         if (lower_name[i] >= 'A' && lower_name[i] <= 'Z') lower_name[i] += 32;
     }
 
-    appendf(gen, "void %s_on_collision(GameState* game, uint32_t entity_id, uint32_t other_id) {\n", lower_name);
+    append_hook_prefix(gen, entity, HOOK_COLLISION);
+    appendf(gen, "void %s_on_collision%s(GameState* game, uint32_t entity_id, uint32_t other_id) {\n", lower_name, hook_body_suffix(gen));
     gen->indent_level++;
 
     // Find entity
+    generate_find_entity(gen, entity, lower_name);
+    append(gen, "\n");
+
     append_indent(gen);
-    appendf(gen, "%s* entity = NULL;\n", entity->name.lexeme);
+    append(gen, "uint32_t eid = entity_id;\n");
     append_indent(gen);
-    appendf(gen, "for (int i = 0; i < game->%ss.count; i++) {\n", lower_name);
-    gen->indent_level++;
+    appendf(gen, "uint32_t %s = other_id;\n", entity->collision_param.lexeme);
+    append(gen, "\n");
+
+    // Generate collision code
+    generate_hook_body(gen, entity, HOOK_COLLISION, entity->on_collision);
+
+    gen->indent_level--;
+    append(gen, "}\n\n");
+
+    if (gen->options.profile) {
+        char name[300];
+        snprintf(name, sizeof(name), "%s_on_collision", lower_name);
+        generate_profiled_hook(gen, entity, HOOK_COLLISION, "void", name,
+                               "GameState* game, uint32_t entity_id, uint32_t other_id", "game, entity_id, other_id");
+    }
+}
+
+#define DEFAULT_TYPE_CAPACITY 8
+#define DEFAULT_ENTITY_TYPE_CAPACITY 128
+
+// Instances a type's array starts with: its `capacity`, if declared.
+static int type_capacity(EntityDecl* entity) {
+    return entity->capacity ? entity->capacity : DEFAULT_TYPE_CAPACITY;
+}
+
+// Ids entity_types starts with: the game block's `capacity`, or enough for
+// every type's array to fill up.
+static int entity_type_capacity(Program* program) {
+    if (program->game && program->game->capacity) return program->game->capacity;
+
+    long long total = 0;
+    for (int i = 0; i < program->entity_count; i++) {
+        total += type_capacity(program->entities[i]);
+    }
+    if (total < DEFAULT_ENTITY_TYPE_CAPACITY) return DEFAULT_ENTITY_TYPE_CAPACITY;
+    return total > INT_MAX / 2 ? INT_MAX / 2 : (int)total;
+}
+
+// The game block's spawns grouped by type: types in declaration order,
+// each type's spawns in script order. game_init hands every group to
+// X_spawn_many, so a level is data rather than one call per spawn.
+typedef struct {
+    int* counts;  // per entity type
+    float* xs;    // every spawn, type after type
+    float* ys;
+    int total;
+} SpawnTable;
+
+static SpawnTable build_spawn_table(Program* program) {
+    SpawnTable table = {0};
+    table.counts = calloc(program->entity_count > 0 ? program->entity_count : 1, sizeof(int));
+    if (!table.counts) error(error_messages[ERROR_MALLOCFAIL].message);
+    if (!program->game) return table;
+
+    GameDecl* game = program->game;
+    int* types = malloc(sizeof(int) * (game->spawn_count > 0 ? game->spawn_count : 1));
+    table.xs = malloc(sizeof(float) * (game->spawn_count > 0 ? game->spawn_count : 1));
+    table.ys = malloc(sizeof(float) * (game->spawn_count > 0 ? game->spawn_count : 1));
+    if (!types || !table.xs || !table.ys) error(error_messages[ERROR_MALLOCFAIL].message);
+
+    for (int i = 0; i < game->spawn_count; i++) {
+        types[i] = -1;
+        for (int t = 0; t < program->entity_count; t++) {
+            if (strcmp(program->entities[t]->name.lexeme, game->spawns[i].entity_name.lexeme) == 0) {
+                types[i] = t;
+                break;
+            }
+        }
+        if (types[i] < 0) error_at_token(game->spawns[i].entity_name, "Spawn of an unknown entity type.");
+        if (program->entities[types[i]]->singleton && table.counts[types[i]] > 0) {
+            error_at_token(game->spawns[i].entity_name, "Second spawn of a singleton entity.");
+        }
+        table.counts[types[i]]++;
+    }
+
+    // Counting sort: where each type's group starts, then fill in order.
+    int* next = malloc(sizeof(int) * (program->entity_count > 0 ? program->entity_count : 1));
+    if (!next) error(error_messages[ERROR_MALLOCFAIL].message);
+    for (int t = 0, first = 0; t < program->entity_count; t++) {
+        next[t] = first;
+        first += table.counts[t];
+    }
+    for (int i = 0; i < game->spawn_count; i++) {
+        int slot = next[types[i]]++;
+        table.xs[slot] = game->spawns[i].x;
+        table.ys[slot] = game->spawns[i].y;
+    }
+    table.total = game->spawn_count;
+
+    free(next);
+    free(types);
+    return table;
+}
+
+static void free_spawn_table(SpawnTable* table) {
+    free(table->counts);
+    free(table->xs);
+    free(table->ys);
+}
+
+static void generate_float_array(CodeGen* gen, const char* name, const float* values, int count) {
+    appendf(gen, "static const float %s[%d] = {", name, count);
+    for (int i = 0; i < count; i++) {
+        append(gen, i % 8 == 0 ? "\n    " : " ");
+        append_float_literal(gen, values[i]);
+        append(gen, ",");
+    }
+    append(gen, "\n};\n\n");
+}
+
+static void generate_spawn_arrays(CodeGen* gen, SpawnTable* table) {
+    generate_float_array(gen, "whisker_spawn_xs", table->xs, table->total);
+    generate_float_array(gen, "whisker_spawn_ys", table->ys, table->total);
+}
+
+static void append_blob(CodeGen* gen, size_t* at, const void* data, size_t length) {
+    memcpy(gen->spawn_blob + *at, data, length);
+    *at += length;
+}
+
+// Identifies the ordered list of entity types, so a blob written for another
+// set, or the same types in another order, is refused.
+static uint64_t spawn_types_hash(Program* program) {
+    size_t length = 0;
+    for (int i = 0; i < program->entity_count; i++) {
+        length += strlen(program->entities[i]->name.lexeme) + 1;
+    }
+    char* names = malloc(length + 1);
+    if (!names) error(error_messages[ERROR_MALLOCFAIL].message);
+    size_t at = 0;
+    for (int i = 0; i < program->entity_count; i++) {
+        size_t name_length = strlen(program->entities[i]->name.lexeme) + 1;
+        memcpy(names + at, program->entities[i]->name.lexeme, name_length);
+        at += name_length;
+    }
+    uint64_t hash = hash_bytes(names, length);
+    free(names);
+    return hash;
+}
+
+// "WSKS", the number of entity types (uint32), spawn_types_hash (uint64) and
+// one spawn count per type (uint32), then each type's xs followed by its ys,
+// as floats in the host's byte order.
+static void build_spawn_blob(CodeGen* gen, Program* program, SpawnTable* table) {
+    size_t length = 16 + sizeof(uint32_t) * program->entity_count + sizeof(float) * 2 * table->total;
+    free(gen->spawn_blob);
+    gen->spawn_blob = malloc(length);
+    if (!gen->spawn_blob) error(error_messages[ERROR_MALLOCFAIL].message);
+    gen->spawn_blob_length = length;
+
+    size_t at = 0;
+    uint32_t types = (uint32_t)program->entity_count;
+    uint64_t types_hash = spawn_types_hash(program);
+    append_blob(gen, &at, "WSKS", 4);
+    append_blob(gen, &at, &types, sizeof(types));
+    append_blob(gen, &at, &types_hash, sizeof(types_hash));
+    for (int t = 0; t < program->entity_count; t++) {
+        uint32_t count = (uint32_t)table->counts[t];
+        append_blob(gen, &at, &count, sizeof(count));
+    }
+    for (int t = 0, first = 0; t < program->entity_count; t++) {
+        append_blob(gen, &at, table->xs + first, sizeof(float) * table->counts[t]);
+        append_blob(gen, &at, table->ys + first, sizeof(float) * table->counts[t]);
+        first += table->counts[t];
+    }
+}
+
+static void generate_spawn_loader(CodeGen* gen, Program* program) {
+    append(gen, "#include <stdio.h>\n\n");
+    append(gen, "#ifndef WHISKER_SPAWN_BLOB\n");
+    appendf(gen, "#define WHISKER_SPAWN_BLOB \"%s\"\n", gen->options.spawn_blob_name);
+    append(gen, "#endif\n\n");
+    appendf(gen, "#define WHISKER_SPAWN_TYPES_HASH 0x%016llxULL  // entity type names, in order\n\n",
+            (unsigned long long)spawn_types_hash(program));
+
+    append(gen, "bool game_load_spawns(GameState* game, const char* path) {\n");
+    append(gen, "    FILE* f = fopen(path, \"rb\");\n");
+    append(gen, "    if (!f) {\n");
+    append(gen, "        fprintf(stderr, \"whisker: cannot open spawn table %s\\n\", path);\n");
+    append(gen, "        return false;\n");
+    append(gen, "    }\n");
+    append(gen, "    fseek(f, 0, SEEK_END);\n");
+    append(gen, "    long size = ftell(f);\n");
+    append(gen, "    fseek(f, 0, SEEK_SET);\n");
+    append(gen, "    unsigned char* blob = size > 0 ? malloc((size_t)size) : NULL;\n");
+    append(gen, "    bool ok = blob && fread(blob, 1, (size_t)size, f) == (size_t)size;\n");
+    append(gen, "    fclose(f);\n\n");
+
+    append(gen, "    // The header must match this build's entity types, and the size its counts.\n");
+    append(gen, "    uint32_t counts[ENTITY_TYPE_COUNT];\n");
+    append(gen, "    size_t header = 16 + sizeof(counts);\n");
+    append(gen, "    ok = ok && (size_t)size >= header && memcmp(blob, \"WSKS\", 4) == 0;\n");
+    append(gen, "    if (ok) {\n");
+    append(gen, "        uint32_t types;\n");
+    append(gen, "        uint64_t types_hash;\n");
+    append(gen, "        memcpy(&types, blob + 4, sizeof(types));\n");
+    append(gen, "        memcpy(&types_hash, blob + 8, sizeof(types_hash));\n");
+    append(gen, "        memcpy(counts, blob + 16, sizeof(counts));\n");
+    append(gen, "        size_t expected = header;\n");
+    append(gen, "        for (int i = 0; i < ENTITY_TYPE_COUNT; i++) expected += sizeof(float) * 2 * (size_t)counts[i];\n");
+    append(gen, "        ok = types == ENTITY_TYPE_COUNT && types_hash == WHISKER_SPAWN_TYPES_HASH &&\n");
+    append(gen, "             expected == (size_t)size;\n");
+    append(gen, "    }\n");
+    append(gen, "    if (!ok) {\n");
+    append(gen, "        fprintf(stderr, \"whisker: %s is not a spawn table for this game\\n\", path);\n");
+    append(gen, "        free(blob);\n");
+    append(gen, "        return false;\n");
+    append(gen, "    }\n\n");
+
+    append(gen, "    const float* at = (const float*)(blob + header);\n");
+    for (int i = 0; i < program->entity_count; i++) {
+        char lower_name[256];
+        lower_entity_name(program->entities[i], lower_name, sizeof(lower_name));
+        char upper_name[256];
+        snprintf(upper_name, sizeof(upper_name), "%s", program->entities[i]->name.lexeme);
+        for (int j = 0; upper_name[j]; j++) {
+            if (upper_name[j] >= 'a' && upper_name[j] <= 'z') upper_name[j] -= 32;
+        }
+        appendf(gen, "    %s_spawn_many(game, (int)counts[ENTITY_TYPE_%s], at, at + counts[ENTITY_TYPE_%s]);\n",
+                lower_name, upper_name, upper_name);
+        appendf(gen, "    at += 2 * (size_t)counts[ENTITY_TYPE_%s];\n", upper_name);
+    }
+    append(gen, "    free(blob);\n");
+    append(gen, "    return true;\n");
+    append(gen, "}\n\n");
+}
+
+// --bake: when every type the game block spawns has an on_create that
+// comes down to constants, the whole block is evaluated here. game_init
+// then makes the engine entities and copies in the finished transforms,
+// renderables, shapes, type table and entity arrays. A fresh registry hands
+// out ids 0, 1, 2, ... (ids are dense indices into its arrays), so the
+// image can name every entity by id up front.
+
+// `transform.f = <constant>;` or `renderable.f = <constant>;`
+static bool is_component_store(Stmt* stmt) {
+    if (stmt->type != STMT_EXPRESSION || stmt->as.expr.expr->type != EXPR_SET) return false;
+
+    Expr* set = stmt->as.expr.expr;
+    if (set->as.set.object->type != EXPR_VARIABLE) return false;
+    const char* owner = set->as.set.object->as.variable.name.lexeme;
+    if (strcmp(owner, "transform") != 0 && strcmp(owner, "renderable") != 0) return false;
+
+    Expr* value = set->as.set.value;
+    return value->type == EXPR_LITERAL ||
+           (value->type == EXPR_VARIABLE && is_constant_name(value->as.variable.name.lexeme));
+}
+
+// Why a type cannot be baked, or NULL.
+static const char* bake_blocker(EntityDecl* entity) {
+    if (entity->pooled) return "pooled types are created at run time";
+
+    CreatePlan plan = plan_create(entity);
+    bool constant = true;
+    for (int i = 0; i < plan.residual.as.block.count; i++) {
+        if (!is_component_store(plan.residual.as.block.statements[i])) constant = false;
+    }
+    free_create_plan(&plan);
+    return constant ? NULL : "its on_create does more than store constants";
+}
+
+static bool can_bake(CodeGen* gen, Program* program, SpawnTable* table) {
+    if (!gen->options.bake || gen->options.profile || table->total == 0) return false;
+    for (int i = 0; i < program->entity_count; i++) {
+        if (table->counts[i] > 0 && bake_blocker(program->entities[i])) return false;
+    }
+    return true;
+}
+
+// --spawn-blob, unless --bake already compiles the spawns in.
+static bool uses_spawn_blob(CodeGen* gen, Program* program) {
+    if (!gen->options.spawn_blob || !program->game || program->game->spawn_count == 0) return false;
+
+    SpawnTable table = build_spawn_table(program);
+    bool baked = can_bake(gen, program, &table);
+    free_spawn_table(&table);
+    return !baked;
+}
+
+// The last constant the residual on_create stores into owner.field, if any.
+static Expr* baked_store(CreatePlan* plan, const char* owner, const char* field) {
+    Expr* value = NULL;
+    for (int i = 0; i < plan->residual.as.block.count; i++) {
+        Expr* set = plan->residual.as.block.statements[i]->as.expr.expr;
+        if (strcmp(set->as.set.object->as.variable.name.lexeme, owner) == 0 &&
+            strcmp(set->as.set.name.lexeme, field) == 0) {
+            value = set->as.set.value;
+        }
+    }
+    return value;
+}
+
+// A component initializer: create's defaults (name/C text pairs, NULL
+// terminated) with on_create's stores into `owner` on top.
+static void generate_baked_component(CodeGen* gen, EntityDecl* entity, CreatePlan* plan,
+                                     const char* owner, const char* const* defaults) {
+    append(gen, "{");
+    for (int i = 0; defaults[i]; i += 2) {
+        appendf(gen, "%s.%s = ", i > 0 ? ", " : "", defaults[i]);
+        Expr* value = baked_store(plan, owner, defaults[i]);
+        if (value) generate_expr(gen, value, entity->name.lexeme);
+        else append(gen, defaults[i + 1]);
+    }
+    append(gen, "}");
+}
+
+static void generate_baked_image(CodeGen* gen, Program* program, SpawnTable* table) {
+    static const char* const transform_defaults[] = {
+        "x", "(px)", "y", "(py)", "image_xscale", "1.0f", "image_yscale", "1.0f",
+        "up", "1", "right", "1", "rotation_rad", "0.0f", NULL
+    };
+    gen->cse_active = 0;
+
+    // What every instance of a type starts as, as macros
+    bool rects = false, circles = false;
+    for (int t = 0; t < program->entity_count; t++) {
+        if (table->counts[t] == 0) continue;
+        EntityDecl* entity = program->entities[t];
+        char upper_name[256];
+        snprintf(upper_name, sizeof(upper_name), "%s", entity->name.lexeme);
+        for (int j = 0; upper_name[j]; j++) {
+            if (upper_name[j] >= 'a' && upper_name[j] <= 'z') upper_name[j] -= 32;
+        }
+        CreatePlan plan = plan_create(entity);
+
+        appendf(gen, "#define WHISKER_BAKED_%s(id) {.entity_id = (id)", upper_name);
+        for (int i = 0; i < entity->field_count; i++) {
+            if (!plan.values[i]) continue;
+            appendf(gen, ", .%s = ", entity->fields[i].name.lexeme);
+            generate_expr(gen, plan.values[i], entity->name.lexeme);
+        }
+        append(gen, "}\n");
+        appendf(gen, "#define WHISKER_BAKED_%s_TRANSFORM(px, py) ", upper_name);
+        generate_baked_component(gen, entity, &plan, "transform", transform_defaults);
+        append(gen, "\n");
+        TypeInfo info = type_info_evaluate(entity);
+        char sprite[256];
+        sprite_text(&info, sprite, sizeof(sprite));
+        const char* const renderable_defaults[] = {
+            "current_sprite_id", sprite, "image_index", "0",
+            "frame_counter", "0.0f", "image_speed", "0.0f", NULL
+        };
+        appendf(gen, "#define WHISKER_BAKED_%s_RENDERABLE ", upper_name);
+        generate_baked_component(gen, entity, &plan, "renderable", renderable_defaults);
+        append(gen, "\n");
+        free_create_plan(&plan);
+
+        rects = rects || info.shape == SHAPE_RECT;
+        circles = circles || info.shape == SHAPE_CIRC;
+    }
+    append(gen, "\n");
+
+    appendf(gen, "#define WHISKER_BAKED_COUNT %d\n\n", table->total);
+
+    // Per entity, by id
+    append(gen, "static const EntityType whisker_baked_types[WHISKER_BAKED_COUNT] = {");
+    for (int t = 0, id = 0; t < program->entity_count; t++) {
+        char upper_name[256];
+        snprintf(upper_name, sizeof(upper_name), "%s", program->entities[t]->name.lexeme);
+        for (int j = 0; upper_name[j]; j++) {
+            if (upper_name[j] >= 'a' && upper_name[j] <= 'z') upper_name[j] -= 32;
+        }
+        for (int i = 0; i < table->counts[t]; i++, id++) {
+            appendf(gen, "%sENTITY_TYPE_%s,", id % 8 == 0 ? "\n    " : " ", upper_name);
+        }
+    }
+    append(gen, "\n};\n\n");
+
+    const char* arrays[] = {"transforms", "renderables", "rectangles", "circles"};
+    const char* types[] = {"transform_t", "Renderable", "RectWrapper", "Circle"};
+    for (int a = 0; a < 4; a++) {
+        if ((a == 2 && !rects) || (a == 3 && !circles)) continue;
+        appendf(gen, "static const %s whisker_baked_%s[WHISKER_BAKED_COUNT] = {\n", types[a], arrays[a]);
+        for (int t = 0, id = 0; t < program->entity_count; t++) {
+            char upper_name[256];
+            snprintf(upper_name, sizeof(upper_name), "%s", program->entities[t]->name.lexeme);
+            for (int j = 0; upper_name[j]; j++) {
+                if (upper_name[j] >= 'a' && upper_name[j] <= 'z') upper_name[j] -= 32;
+            }
+            TypeInfo shape = type_info_evaluate(program->entities[t]);
+            for (int i = 0; i < table->counts[t]; i++, id++) {
+                float x = table->xs[id], y = table->ys[id];
+                append(gen, "    ");
+                if (a == 0) {
+                    appendf(gen, "WHISKER_BAKED_%s_TRANSFORM(", upper_name);
+                    append_float_literal(gen, x);
+                    append(gen, ", ");
+                    append_float_literal(gen, y);
+                    append(gen, ")");
+                } else if (a == 1) {
+                    appendf(gen, "WHISKER_BAKED_%s_RENDERABLE", upper_name);
+                } else if (a == 2 && shape.shape == SHAPE_RECT) {
+                    appendf(gen, "{.owner_id = %d, .rect = {", id);
+                    append_float_literal(gen, x);
+                    append(gen, ", ");
+                    append_float_literal(gen, y);
+                    append(gen, ", ");
+                    append_float_literal(gen, shape.width);
+                    append(gen, ", ");
+                    append_float_literal(gen, shape.height);
+                    append(gen, "}}");
+                } else if (a == 3 && shape.shape == SHAPE_CIRC) {
+                    appendf(gen, "{.owner_id = %d, .position = {", id);
+                    append_float_literal(gen, x);
+                    append(gen, ", ");
+                    append_float_literal(gen, y);
+                    append(gen, "}, .radius = ");
+                    append_float_literal(gen, shape.width);
+                    append(gen, "}");
+                } else {
+                    append(gen, "{0}");
+                }
+                append(gen, ",\n");
+            }
+        }
+        append(gen, "};\n\n");
+    }
+
+    // Each type's instances, ids counting up from the type's first
+    for (int t = 0, first = 0; t < program->entity_count; t++) {
+        if (table->counts[t] == 0) continue;
+        EntityDecl* entity = program->entities[t];
+        char lower_name[256];
+        lower_entity_name(entity, lower_name, sizeof(lower_name));
+        char upper_name[256];
+        snprintf(upper_name, sizeof(upper_name), "%s", entity->name.lexeme);
+        for (int j = 0; upper_name[j]; j++) {
+            if (upper_name[j] >= 'a' && upper_name[j] <= 'z') upper_name[j] -= 32;
+        }
+        appendf(gen, "static const %s whisker_baked_%ss[%d] = {", entity->name.lexeme, lower_name, table->counts[t]);
+        for (int i = 0; i < table->counts[t]; i++) {
+            appendf(gen, "%sWHISKER_BAKED_%s(%d),", i % 8 == 0 ? "\n    " : " ", upper_name, first + i);
+        }
+        append(gen, "\n};\n\n");
+        first += table->counts[t];
+    }
+}
+
+// game_init's half of the image.
+static void generate_baked_spawns(CodeGen* gen, Program* program, SpawnTable* table) {
     append_indent(gen);
-    appendf(gen, "if (game->%ss.data[i].entity_id == entity_id) {\n", lower_name);
-    gen->indent_level++;
+    append(gen, "// The game block, baked: make its engine entities, then copy their state in\n");
     append_indent(gen);
-    appendf(gen, "entity = &game->%ss.data[i];\n", lower_name);
+    append(gen, "for (int i = 0; i < WHISKER_BAKED_COUNT; i++) {\n");
     append_indent(gen);
-    append(gen, "break;\n");
-    gen->indent_level--;
+    append(gen, "    entity_create(&game->registry, &game->transforms,\n");
     append_indent(gen);
-    append(gen, "}\n");
-    gen->indent_level--;
+    append(gen, "        &game->renderables, &game->circles, &game->rectangles);\n");
     append_indent(gen);
     append(gen, "}\n");
-    append_indent(gen);
-    append(gen, "if (!entity) return;\n\n");
+
+    int rects = 0, circles = 0;
+    for (int t = 0, first = 0; t < program->entity_count; t++) {
+        if (table->counts[t] == 0) continue;
+        TypeInfo shape = type_info_evaluate(program->entities[t]);
+        if (shape.shape != SHAPE_NONE) {
+            append_indent(gen);
+            appendf(gen, "for (uint32_t id = %d; id < %d; id++) entity_set_collision(&game->registry, id, %s);\n",
+                    first, first + table->counts[t], shape.shape == SHAPE_RECT ? "COLLISION_RECT" : "COLLISION_CIRC");
+        }
+        if (shape.shape == SHAPE_RECT) rects += table->counts[t];
+        if (shape.shape == SHAPE_CIRC) circles += table->counts[t];
+        first += table->counts[t];
+    }
 
     append_indent(gen);
-    append(gen, "uint32_t eid = entity_id;\n");
+    append(gen, "memcpy(game->transforms.data, whisker_baked_transforms, sizeof(whisker_baked_transforms));\n");
     append_indent(gen);
-    appendf(gen, "uint32_t %s = other_id;\n", entity->collision_param.lexeme);
-    append(gen, "\n");
+    append(gen, "memcpy(game->renderables.data, whisker_baked_renderables, sizeof(whisker_baked_renderables));\n");
+    if (rects > 0) {
+        append_indent(gen);
+        append(gen, "memcpy(game->rectangles.data, whisker_baked_rectangles, sizeof(whisker_baked_rectangles));\n");
+        append_indent(gen);
+        appendf(gen, "game->rectangles.count += %d;\n", rects);
+    }
+    if (circles > 0) {
+        append_indent(gen);
+        append(gen, "memcpy(game->circles.data, whisker_baked_circles, sizeof(whisker_baked_circles));\n");
+        append_indent(gen);
+        appendf(gen, "game->circles.count += %d;\n", circles);
+    }
+    append_indent(gen);
+    append(gen, "memcpy(game->entity_types, whisker_baked_types, sizeof(whisker_baked_types));\n");
 
-    // Generate collision code
-    generate_stmt(gen, entity->on_collision, entity->name.lexeme);
+    for (int t = 0; t < program->entity_count; t++) {
+        if (table->counts[t] == 0) continue;
+        char lower_name[256];
+        lower_entity_name(program->entities[t], lower_name, sizeof(lower_name));
+        append_indent(gen);
+        appendf(gen, "memcpy(game->%ss.data, whisker_baked_%ss, sizeof(whisker_baked_%ss));\n",
+                lower_name, lower_name, lower_name);
+        append_indent(gen);
+        appendf(gen, "game->%ss.count = %d;\n", lower_name, table->counts[t]);
+    }
+}
 
-    gen->indent_level--;
-    append(gen, "}\n\n");
+static void warn_unbakeable(CodeGen* gen, Program* program, SpawnTable* table) {
+    if (!gen->options.bake || gen->options.profile || table->total == 0) return;
+    for (int i = 0; i < program->entity_count; i++) {
+        const char* reason = table->counts[i] > 0 ? bake_blocker(program->entities[i]) : NULL;
+        if (!reason) continue;
+        char message[512];
+        snprintf(message, sizeof(message), "--bake: %s is spawned in the game block, but %s; spawning the game block at run time instead.",
+                 program->entities[i]->name.lexeme, reason);
+        warning_at_line(program->entities[i]->name.line, message);
+        return;
+    }
 }
 
 static void generate_game_init(CodeGen* gen, Program* program) {
+    SpawnTable table = build_spawn_table(program);
+    bool baked = can_bake(gen, program, &table);
+    warn_unbakeable(gen, program, &table);
+    if (baked) {
+        generate_baked_image(gen, program, &table);
+    } else if (uses_spawn_blob(gen, program)) {
+        build_spawn_blob(gen, program, &table);
+        generate_spawn_loader(gen, program);
+    } else if (table.total > 0) {
+        generate_spawn_arrays(gen, &table);
+    }
+
     append(gen, "void game_init(GameState* game) {\n");
     gen->indent_level++;
 
+    if (gen->options.profile) {
+        append_indent(gen);
+        append(gen, "game->profile = (WhiskerProfile){0};\n");
+    }
+
+    append_indent(gen);
+    int id_capacity = entity_type_capacity(program);
+    if (baked && table.total > id_capacity) id_capacity = table.total;
+    appendf(gen, "game->entity_type_capacity = %d;\n", id_capacity);
     append_indent(gen);
-    append(gen, "game->entity_types = malloc(sizeof(EntityType) * 128);\n");
+    append(gen, "game->entity_types = malloc(sizeof(EntityType) * game->entity_type_capacity);\n");
+    if (program_has_pooled(program)) {
+        append_indent(gen);
+        append(gen, "game->entity_slots = malloc(sizeof(int) * game->entity_type_capacity);\n");
+    }
+    append_indent(gen);
+    append(gen, "game->destroy_queue = (DestroyQueue){0};\n");
     append(gen, "\n");
 
     // Initialize all entity arrays
@@ -836,61 +2741,208 @@ static void generate_game_init(CodeGen* gen, Program* program) {
             if (lower_name[j] >= 'A' && lower_name[j] <= 'Z') lower_name[j] += 32;
         }
 
+        if (program->entities[i]->singleton) {
+            append_indent(gen);
+            appendf(gen, "game->%ss.count = 0;\n\n", lower_name);
+            continue;
+        }
+
+        int capacity = type_capacity(program->entities[i]);
+        if (baked && table.counts[i] > capacity) capacity = table.counts[i];
         append_indent(gen);
-        appendf(gen, "game->%ss.data = malloc(sizeof(%s) * 8);\n",
-                lower_name, program->entities[i]->name.lexeme);
+        appendf(gen, "game->%ss.data = malloc(sizeof(%s) * %d);\n",
+                lower_name, program->entities[i]->name.lexeme, capacity);
         append_indent(gen);
-        appendf(gen, "game->%ss.capacity = 8;\n", lower_name);
+        appendf(gen, "game->%ss.capacity = %d;\n", lower_name, capacity);
         append_indent(gen);
         appendf(gen, "game->%ss.count = 0;\n", lower_name);
+        if (program->entities[i]->pooled) {
+            append_indent(gen);
+            appendf(gen, "game->%ss.parked = 0;\n", lower_name);
+        }
         append(gen, "\n");
     }
 
-    // Generate spawn calls from game block
-    if (program->game) {
-        for (int i = 0; i < program->game->spawn_count; i++) {
-            SpawnCall spawn = program->game->spawns[i];
+    // Spawn the game block's entities, a type at a time
+    if (baked) {
+        generate_baked_spawns(gen, program, &table);
+    } else if (uses_spawn_blob(gen, program)) {
+        append_indent(gen);
+        append(gen, "game_load_spawns(game, WHISKER_SPAWN_BLOB);\n");
+    } else {
+        int first = 0;
+        for (int i = 0; i < program->entity_count; i++) {
+            if (table.counts[i] == 0) continue;
             char lower_name[256];
-            snprintf(lower_name, sizeof(lower_name), "%s", spawn.entity_name.lexeme);
-            for (int j = 0; lower_name[j]; j++) {
-                if (lower_name[j] >= 'A' && lower_name[j] <= 'Z') lower_name[j] += 32;
-            }
-
+            lower_entity_name(program->entities[i], lower_name, sizeof(lower_name));
             append_indent(gen);
-            appendf(gen, "%s_create(game, %g, %g);\n",
-                    lower_name, spawn.x, spawn.y);
+            appendf(gen, "%s_spawn_many(game, %d, whisker_spawn_xs + %d, whisker_spawn_ys + %d);\n",
+                    lower_name, table.counts[i], first, first);
+            first += table.counts[i];
         }
     }
 
     gen->indent_level--;
     append(gen, "}\n\n");
+    free_spawn_table(&table);
 }
 
-static void generate_game_update(CodeGen* gen, Program* program) {
-    append(gen, "void game_update(GameState* game) {\n");
+// One update loop on the calling thread, as in a serial build.
+static void generate_update_loop(CodeGen* gen, EntityDecl* entity) {
+    char lower_name[256];
+    lower_entity_name(entity, lower_name, sizeof(lower_name));
+
+    if (update_is_parallel(gen, entity)) {
+        // Self-contained instances: any order gives the serial result.
+        append_indent(gen);
+        appendf(gen, "whisker_parallel_for(game, game->%ss.count, WHISKER_PARALLEL_MIN, %s_update_range);\n",
+                lower_name, lower_name);
+        return;
+    }
+    if (entity->singleton) {
+        append_indent(gen);
+        appendf(gen, "if (game->%ss.count > 0) %s_update(game, game->%ss.data[0].entity_id);\n",
+                lower_name, lower_name, lower_name);
+        return;
+    }
+    append_indent(gen);
+    appendf(gen, "for (int i = 0; i < game->%ss.count; i++) {\n", lower_name);
     gen->indent_level++;
+    append_indent(gen);
+    appendf(gen, "%s_update(game, game->%ss.data[i].entity_id);\n",
+            lower_name, lower_name);
+    gen->indent_level--;
+    append_indent(gen);
+    append(gen, "}\n");
+}
 
-    // Update all entity types
+// A stage with several types is one parallel-for over their loops laid end
+// to end. A type that can run on the pool contributes one index per
+// instance. Any other type runs its whole loop from a chunk of its own at
+// the front.
+static void generate_update_stage(CodeGen* gen, Program* program, int* stage_of, int stage) {
     for (int i = 0; i < program->entity_count; i++) {
-        if (!program->entities[i]->on_update) continue;
+        EntityDecl* entity = program->entities[i];
+        if (stage_of[i] != stage || update_is_parallel(gen, entity)) continue;
 
         char lower_name[256];
-        snprintf(lower_name, sizeof(lower_name), "%s", program->entities[i]->name.lexeme);
-        for (int j = 0; lower_name[j]; j++) {
-            if (lower_name[j] >= 'A' && lower_name[j] <= 'Z') lower_name[j] += 32;
-        }
-
-        append_indent(gen);
-        appendf(gen, "for (int i = 0; i < game->%ss.count; i++) {\n", lower_name);
+        lower_entity_name(entity, lower_name, sizeof(lower_name));
+        appendf(gen, "static void %s_update_all(GameState* game, int begin, int end) {\n", lower_name);
         gen->indent_level++;
         append_indent(gen);
-        appendf(gen, "%s_update(game, game->%ss.data[i].entity_id);\n",
-                lower_name, lower_name);
+        append(gen, "(void)begin;\n");
+        append_indent(gen);
+        append(gen, "(void)end;\n");
+        generate_update_loop(gen, entity);
         gen->indent_level--;
+        append(gen, "}\n\n");
+    }
+
+    appendf(gen, "static void whisker_update_stage%d(GameState* game, int begin, int end) {\n", stage);
+    gen->indent_level++;
+    int loops = 0;
+    for (int i = 0; i < program->entity_count; i++) {
+        if (stage_of[i] != stage || update_is_parallel(gen, program->entities[i])) continue;
+        char lower_name[256];
+        lower_entity_name(program->entities[i], lower_name, sizeof(lower_name));
         append_indent(gen);
-        append(gen, "}\n");
+        appendf(gen, "whisker_run_slice(game, begin, end, %d * WHISKER_PARALLEL_CHUNK, 1, %s_update_all);\n",
+                loops++, lower_name);
+    }
+
+    char previous[256] = "";
+    for (int i = 0; i < program->entity_count; i++) {
+        if (stage_of[i] != stage || !update_is_parallel(gen, program->entities[i])) continue;
+        char lower_name[256];
+        lower_entity_name(program->entities[i], lower_name, sizeof(lower_name));
+        append_indent(gen);
+        if (previous[0]) appendf(gen, "base += game->%ss.count;\n", previous);
+        else if (loops) appendf(gen, "int base = %d * WHISKER_PARALLEL_CHUNK;\n", loops);
+        else append(gen, "int base = 0;\n");
+        append_indent(gen);
+        appendf(gen, "whisker_run_slice(game, begin, end, base, game->%ss.count, %s_update_range);\n",
+                lower_name, lower_name);
+        snprintf(previous, sizeof(previous), "%s", lower_name);
+    }
+    gen->indent_level--;
+    append(gen, "}\n\n");
+}
+
+static void generate_game_update(CodeGen* gen, Program* program) {
+    int* stage_of = malloc(sizeof(int) * (program->entity_count ? program->entity_count : 1));
+    if (!stage_of) error(error_messages[ERROR_MALLOCFAIL].message);
+    int stage_count = schedule_updates(gen, program, stage_of);
+
+    for (int s = 0; s < stage_count; s++) {
+        if (stage_size(program, stage_of, s) > 1) generate_update_stage(gen, program, stage_of, s);
+    }
+
+    append(gen, "void game_update(GameState* game) {\n");
+    gen->indent_level++;
+    generate_trace_event(gen, "game_update", 'B');
+    append_indent(gen);
+    append(gen, "game_flush_destroys(game);  // left over from collisions\n");
+
+    // Update all entity types, stage by stage
+    for (int s = 0; s < stage_count; s++) {
+        if (stage_size(program, stage_of, s) > 1) {
+            char event[64];
+            snprintf(event, sizeof(event), "update.stage%d", s);
+            generate_trace_event(gen, event, 'B');
+            // Whether to wake the pool depends on how many instances the stage
+            // really has, not on its index space, where each serial loop
+            // takes a whole chunk.
+            append_indent(gen);
+            appendf(gen, "int stage%d_live = ", s);
+            bool first = true;
+            for (int i = 0; i < program->entity_count; i++) {
+                if (stage_of[i] != s) continue;
+                char lower_name[256];
+                lower_entity_name(program->entities[i], lower_name, sizeof(lower_name));
+                appendf(gen, "%sgame->%ss.count", first ? "" : " + ", lower_name);
+                first = false;
+            }
+            append(gen, ";\n");
+
+            int loops = 0;
+            for (int i = 0; i < program->entity_count; i++) {
+                if (stage_of[i] == s && !update_is_parallel(gen, program->entities[i])) loops++;
+            }
+            append_indent(gen);
+            appendf(gen, "int stage%d_slots = ", s);
+            if (loops) appendf(gen, "%d * WHISKER_PARALLEL_CHUNK", loops);
+            first = loops == 0;
+            for (int i = 0; i < program->entity_count; i++) {
+                if (stage_of[i] != s || !update_is_parallel(gen, program->entities[i])) continue;
+                char lower_name[256];
+                lower_entity_name(program->entities[i], lower_name, sizeof(lower_name));
+                appendf(gen, "%sgame->%ss.count", first ? "" : " + ", lower_name);
+                first = false;
+            }
+            append(gen, ";\n");
+            append_indent(gen);
+            appendf(gen, "if (stage%d_live < WHISKER_PARALLEL_MIN) whisker_update_stage%d(game, 0, stage%d_slots);\n",
+                    s, s, s);
+            append_indent(gen);
+            appendf(gen, "else whisker_parallel_for(game, stage%d_slots, 0, whisker_update_stage%d);\n", s, s);
+            generate_trace_event(gen, event, 'E');
+            continue;
+        }
+
+        for (int i = 0; i < program->entity_count; i++) {
+            if (stage_of[i] != s) continue;
+            char event[300];
+            snprintf(event, sizeof(event), "%s.update", program->entities[i]->name.lexeme);
+            generate_trace_event(gen, event, 'B');
+            generate_update_loop(gen, program->entities[i]);
+            generate_trace_event(gen, event, 'E');
+        }
     }
+    free(stage_of);
 
+    append_indent(gen);
+    append(gen, "game_flush_destroys(game);\n");
+    generate_trace_event(gen, "game_update", 'E');
     gen->indent_level--;
     append(gen, "}\n\n");
 }
@@ -899,6 +2951,11 @@ static void generate_game_cleanup(CodeGen* gen, Program* program) {
     append(gen, "void game_cleanup(GameState* game) {\n");
     gen->indent_level++;
 
+    if (program_has_parallel(gen, program)) {
+        append_indent(gen);
+        append(gen, "whisker_pool_stop();\n");
+    }
+
     // Free all entity arrays
     for (int i = 0; i < program->entity_count; i++) {
         char lower_name[256];
@@ -907,9 +2964,16 @@ static void generate_game_cleanup(CodeGen* gen, Program* program) {
             if (lower_name[j] >= 'A' && lower_name[j] <= 'Z') lower_name[j] += 32;
         }
 
+        if (program->entities[i]->singleton) continue;
         append_indent(gen);
         appendf(gen, "free(game->%ss.data);\n", lower_name);
     }
+    append_indent(gen);
+    append(gen, "free(game->destroy_queue.data);\n");
+    if (program_has_pooled(program)) {
+        append_indent(gen);
+        append(gen, "free(game->entity_slots);\n");
+    }
 
     gen->indent_level--;
     append(gen, "}\n\n");
@@ -918,11 +2982,28 @@ static void generate_game_cleanup(CodeGen* gen, Program* program) {
 static void generate_collision_dispatcher(CodeGen* gen, Program* program) {
     append(gen, "void dispatch_collision(GameState* game, uint32_t id1, uint32_t id2) {\n");
     gen->indent_level++;
+    generate_trace_event(gen, "dispatch_collision", 'B');
+
+    // No type reacts to collisions: nothing to switch on.
+    bool any = false;
+    for (int i = 0; i < program->entity_count; i++) {
+        if (program->entities[i]->on_collision) any = true;
+    }
+    if (!any) {
+        append_indent(gen);
+        append(gen, "(void)game; (void)id1; (void)id2;\n");
+        generate_trace_event(gen, "dispatch_collision", 'E');
+        gen->indent_level--;
+        append(gen, "}\n\n");
+        return;
+    }
 
     append_indent(gen);
     append(gen, "switch (game->entity_types[id1]) {\n");
 
-    for (int i = 0; i < program->entity_count; i++) {
+    int* order = case_order(gen, program, HOOK_COLLISION);
+    for (int n = 0; n < program->entity_count; n++) {
+        int i = order[n];
         if (!program->entities[i]->on_collision) continue;
 
         char upper_name[256];
@@ -946,6 +3027,7 @@ static void generate_collision_dispatcher(CodeGen* gen, Program* program) {
         append(gen, "break;\n");
         gen->indent_level--;
     }
+    free(order);
 
     append_indent(gen);
     append(gen, "default:\n");
@@ -957,11 +3039,364 @@ static void generate_collision_dispatcher(CodeGen* gen, Program* program) {
     append_indent(gen);
     append(gen, "}\n");
 
+    generate_trace_event(gen, "dispatch_collision", 'E');
+    gen->indent_level--;
+    append(gen, "}\n\n");
+}
+
+// Read/write sets from effects.c, for the game and for tools.
+static void generate_effects_types_h(CodeGen* gen) {
+    append_h(gen, "#define WHISKER_COMPONENT_TRANSFORM 0x1u\n");
+    append_h(gen, "#define WHISKER_COMPONENT_RENDERABLE 0x2u\n");
+    append_h(gen, "#define WHISKER_COMPONENT_COLLISION 0x4u\n\n");
+    append_h(gen, "#define WHISKER_EFFECT_DESTROY 0x1u\n");
+    append_h(gen, "#define WHISKER_EFFECT_SPAWN 0x2u\n");
+    append_h(gen, "#define WHISKER_EFFECT_INPUT 0x4u\n");
+    append_h(gen, "#define WHISKER_EFFECT_QUERY 0x8u\n");
+    append_h(gen, "#define WHISKER_EFFECT_OTHER 0x10u\n");
+    append_h(gen, "#define WHISKER_EFFECT_UNKNOWN 0x20u\n\n");
+    append_h(gen, "// What each generated hook reads and writes. Bit i of the field masks is\n");
+    append_h(gen, "// the type's i-th declared field.\n");
+    append_h(gen, "typedef struct {\n");
+    append_h(gen, "    EntityType type;\n");
+    append_h(gen, "    const char* hook;\n");
+    append_h(gen, "    uint64_t field_reads;\n");
+    append_h(gen, "    uint64_t field_writes;\n");
+    append_h(gen, "    uint32_t component_reads;\n");
+    append_h(gen, "    uint32_t component_writes;\n");
+    append_h(gen, "    uint32_t effects;\n");
+    append_h(gen, "} WhiskerHookEffects;\n\n");
+    append_h(gen, "extern const WhiskerHookEffects whisker_hook_effects[];\n");
+    append_h(gen, "extern const int whisker_hook_effect_count;\n\n");
+}
+
+// Per-type metadata, from each type's compile-time-evaluated init block.
+static void generate_type_info_h(CodeGen* gen) {
+    append_h(gen, "#define WHISKER_TYPE_POOLED 0x1u\n");
+    append_h(gen, "#define WHISKER_TYPE_UPDATES 0x2u\n");
+    append_h(gen, "#define WHISKER_TYPE_ON_COLLISION 0x4u\n");
+    append_h(gen, "#define WHISKER_TYPE_SINGLETON 0x8u\n\n");
+    append_h(gen, "// What every instance of a type starts with. width is the radius for\n");
+    append_h(gen, "// COLLISION_CIRC types.\n");
+    append_h(gen, "typedef struct {\n");
+    append_h(gen, "    const char* name;\n");
+    append_h(gen, "    CollisionType collision;\n");
+    append_h(gen, "    float width;\n");
+    append_h(gen, "    float height;\n");
+    append_h(gen, "    int sprite;\n");
+    append_h(gen, "    uint32_t components;  // WHISKER_COMPONENT_* the type uses\n");
+    append_h(gen, "    uint32_t flags;\n");
+    append_h(gen, "} EntityTypeInfo;\n\n");
+    append_h(gen, "extern const EntityTypeInfo entity_type_info[];\n\n");
+}
+
+static void generate_type_info_table(CodeGen* gen, Program* program) {
+    append(gen, "const EntityTypeInfo entity_type_info[] = {\n");
+    for (int i = 0; i < program->entity_count; i++) {
+        EntityDecl* entity = program->entities[i];
+        TypeInfo info = type_info_evaluate(entity);
+        char upper_name[256];
+        char sprite[128];
+        snprintf(upper_name, sizeof(upper_name), "%s", entity->name.lexeme);
+        for (int j = 0; upper_name[j]; j++) {
+            if (upper_name[j] >= 'a' && upper_name[j] <= 'z') upper_name[j] -= 32;
+        }
+        sprite_text(&info, sprite, sizeof(sprite));
+
+        appendf(gen, "    [ENTITY_TYPE_%s] = {\"%s\", %s, ", upper_name, entity->name.lexeme,
+                info.shape == SHAPE_RECT ? "COLLISION_RECT" :
+                info.shape == SHAPE_CIRC ? "COLLISION_CIRC" : "COLLISION_NONE");
+        append_float_literal(gen, info.width);
+        append(gen, ", ");
+        append_float_literal(gen, info.height);
+        appendf(gen, ", %s, 0x%xu, ", sprite, type_components(entity, &info));
+        const char* separator = "";
+        if (entity->pooled) { append(gen, "WHISKER_TYPE_POOLED"); separator = " | "; }
+        if (entity->on_update) { appendf(gen, "%sWHISKER_TYPE_UPDATES", separator); separator = " | "; }
+        if (entity->on_collision) { appendf(gen, "%sWHISKER_TYPE_ON_COLLISION", separator); separator = " | "; }
+        if (entity->singleton) { appendf(gen, "%sWHISKER_TYPE_SINGLETON", separator); separator = " | "; }
+        if (!*separator) append(gen, "0");
+        append(gen, "},\n");
+    }
+    if (program->entity_count == 0) {
+        append(gen, "    {0}\n");
+    }
+    append(gen, "};\n\n");
+}
+
+static void append_field_names(CodeGen* gen, EntityDecl* entity, uint64_t mask) {
+    bool first = true;
+    for (int i = 0; i < entity->field_count && i < 64; i++) {
+        if (!(mask & (1ull << i))) continue;
+        appendf(gen, "%s%s", first ? "" : " ", entity->fields[i].name.lexeme);
+        first = false;
+    }
+    if (first) append(gen, "-");
+}
+
+static void generate_effects_table(CodeGen* gen, Program* program) {
+    Stmt* hooks[HOOK_COUNT];
+    int count = 0;
+
+    append(gen, "const WhiskerHookEffects whisker_hook_effects[] = {\n");
+    for (int i = 0; i < program->entity_count; i++) {
+        EntityDecl* entity = program->entities[i];
+        hooks[HOOK_CREATE] = entity->on_create;
+        hooks[HOOK_UPDATE] = entity->on_update;
+        hooks[HOOK_DESTROY] = entity->on_destroy;
+        hooks[HOOK_COLLISION] = entity->on_collision;
+
+        char upper_name[256];
+        snprintf(upper_name, sizeof(upper_name), "%s", entity->name.lexeme);
+        for (int j = 0; upper_name[j]; j++) {
+            if (upper_name[j] >= 'a' && upper_name[j] <= 'z') upper_name[j] -= 32;
+        }
+
+        for (int h = 0; h < HOOK_COUNT; h++) {
+            if (!hooks[h]) continue;
+            HookEffects* effects = &entity->effects[h];
+
+            appendf(gen, "    // %s %s: reads ", entity->name.lexeme, hook_kind_name((HookKind)h));
+            append_field_names(gen, entity, effects->field_reads);
+            append(gen, ", writes ");
+            append_field_names(gen, entity, effects->field_writes);
+            append(gen, "\n");
+            appendf(gen, "    {ENTITY_TYPE_%s, \"%s\", 0x%llxull, 0x%llxull, 0x%xu, 0x%xu, 0x%xu},\n",
+                    upper_name, hook_kind_name((HookKind)h),
+                    (unsigned long long)effects->field_reads, (unsigned long long)effects->field_writes,
+                    effects->component_reads, effects->component_writes, effects->effects);
+            count++;
+        }
+    }
+    if (count == 0) {
+        append(gen, "    {0}\n");
+    }
+    append(gen, "};\n");
+    appendf(gen, "const int whisker_hook_effect_count = %d;\n\n", count);
+}
+
+// Per-type, per-hook counters for --profile builds.
+static void generate_profile_types_h(CodeGen* gen) {
+    append_h(gen, "typedef enum {\n");
+    append_h(gen, "    WHISKER_HOOK_CREATE,\n");
+    append_h(gen, "    WHISKER_HOOK_UPDATE,\n");
+    append_h(gen, "    WHISKER_HOOK_DESTROY,\n");
+    append_h(gen, "    WHISKER_HOOK_COLLISION,\n");
+    append_h(gen, "    WHISKER_HOOK_COUNT\n");
+    append_h(gen, "} WhiskerHook;\n\n");
+
+    append_h(gen, "typedef struct {\n");
+    append_h(gen, "    uint64_t calls[WHISKER_HOOK_COUNT];\n");
+    append_h(gen, "    uint64_t cycles[WHISKER_HOOK_COUNT];\n");
+    append_h(gen, "    uint32_t peak_instances;\n");
+    append_h(gen, "} WhiskerTypeProfile;\n\n");
+
+    appendf_h(gen, "#define WHISKER_BRANCH_COUNT %d\n\n", gen->branch_count);
+    append_h(gen, "typedef struct {\n");
+    append_h(gen, "    WhiskerTypeProfile types[ENTITY_TYPE_COUNT];\n");
+    append_h(gen, "    uint64_t branch_taken[WHISKER_BRANCH_COUNT + 1];\n");
+    append_h(gen, "    uint64_t branch_total[WHISKER_BRANCH_COUNT + 1];\n");
+    append_h(gen, "} WhiskerProfile;\n\n");
+}
+
+// rdtsc where we have it, a monotonic clock in nanoseconds elsewhere, plus
+// the branch counter and the script line behind every branch site.
+static void generate_profile_runtime(CodeGen* gen) {
+    append(gen, "#include <time.h>\n\n");
+    append(gen, "static inline uint64_t whisker_cycles(void) {\n");
+    append(gen, "#if defined(__x86_64__) || defined(__i386__)\n");
+    append(gen, "    return __builtin_ia32_rdtsc();\n");
+    append(gen, "#else\n");
+    append(gen, "    struct timespec ts;\n");
+    append(gen, "    clock_gettime(CLOCK_MONOTONIC, &ts);\n");
+    append(gen, "    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;\n");
+    append(gen, "#endif\n");
+    append(gen, "}\n\n");
+
+    append(gen, "static inline bool whisker_branch(GameState* game, int site, bool taken) {\n");
+    append(gen, "    game->profile.branch_total[site]++;\n");
+    append(gen, "    if (taken) game->profile.branch_taken[site]++;\n");
+    append(gen, "    return taken;\n");
+    append(gen, "}\n\n");
+
+    append(gen, "static const struct {\n");
+    append(gen, "    EntityType type;\n");
+    append(gen, "    WhiskerHook hook;\n");
+    append(gen, "    int ordinal;\n");
+    append(gen, "    int line;\n");
+    append(gen, "} whisker_branch_sites[WHISKER_BRANCH_COUNT + 1] = {\n");
+    for (int i = 0; i < gen->branch_count; i++) {
+        BranchSite* site = &gen->branches[i];
+        char upper_name[256];
+        snprintf(upper_name, sizeof(upper_name), "%s", site->entity->name.lexeme);
+        for (int j = 0; upper_name[j]; j++) {
+            if (upper_name[j] >= 'a' && upper_name[j] <= 'z') upper_name[j] -= 32;
+        }
+        char hook[32];
+        snprintf(hook, sizeof(hook), "%s", hook_kind_name(site->hook));
+        for (int j = 0; hook[j]; j++) {
+            if (hook[j] >= 'a' && hook[j] <= 'z') hook[j] -= 32;
+        }
+        appendf(gen, "    {ENTITY_TYPE_%s, WHISKER_HOOK_%s, %d, %d},\n", upper_name, hook, site->ordinal, site->stmt->line);
+    }
+    append(gen, "    {0}\n");
+    append(gen, "};\n\n");
+}
+
+static void generate_profile_use_macros(CodeGen* gen) {
+    append(gen, "#if defined(__GNUC__)\n");
+    append(gen, "#define WHISKER_LIKELY(x) __builtin_expect(!!(x), 1)\n");
+    append(gen, "#define WHISKER_UNLIKELY(x) __builtin_expect(!!(x), 0)\n");
+    append(gen, "#define WHISKER_COLD __attribute__((cold))\n");
+    append(gen, "#else\n");
+    append(gen, "#define WHISKER_LIKELY(x) (x)\n");
+    append(gen, "#define WHISKER_UNLIKELY(x) (x)\n");
+    append(gen, "#define WHISKER_COLD\n");
+    append(gen, "#endif\n\n");
+}
+
+// Plain text, one record per line, so tools (and --profile-use) can read it:
+//   whisker-profile 2
+//   type <Name> instances <now> peak <max>
+//   hook <Name> <create|update|destroy|collision> calls <n> cycles <n>
+//   branch <Name> <hook> <ordinal> line <line> taken <n> total <n>
+static void generate_profile_dump(CodeGen* gen, Program* program) {
+    append(gen, "void game_profile_dump(GameState* game, FILE* out) {\n");
+    gen->indent_level++;
+
+    append_indent(gen);
+    append(gen, "static const char* hook_names[WHISKER_HOOK_COUNT] = {\"create\", \"update\", \"destroy\", \"collision\"};\n");
+    append_indent(gen);
+    append(gen, "static const char* type_names[ENTITY_TYPE_COUNT + 1] = {");
+    for (int i = 0; i < program->entity_count; i++) {
+        appendf(gen, "\"%s\", ", program->entities[i]->name.lexeme);
+    }
+    append(gen, "NULL};\n");
+    append_indent(gen);
+    append(gen, "int instances[ENTITY_TYPE_COUNT + 1] = {");
+    for (int i = 0; i < program->entity_count; i++) {
+        char lower_name[256];
+        snprintf(lower_name, sizeof(lower_name), "%s", program->entities[i]->name.lexeme);
+        for (int j = 0; lower_name[j]; j++) {
+            if (lower_name[j] >= 'A' && lower_name[j] <= 'Z') lower_name[j] += 32;
+        }
+        appendf(gen, "game->%ss.count, ", lower_name);
+    }
+    append(gen, "0};\n\n");
+
+    append_indent(gen);
+    append(gen, "fprintf(out, \"whisker-profile 2\\n\");\n");
+    append_indent(gen);
+    append(gen, "for (int t = 0; t < ENTITY_TYPE_COUNT; t++) {\n");
+    gen->indent_level++;
+    append_indent(gen);
+    append(gen, "WhiskerTypeProfile* p = &game->profile.types[t];\n");
+    append_indent(gen);
+    append(gen, "fprintf(out, \"type %s instances %d peak %u\\n\", type_names[t], instances[t], p->peak_instances);\n");
+    append_indent(gen);
+    append(gen, "for (int h = 0; h < WHISKER_HOOK_COUNT; h++) {\n");
+    gen->indent_level++;
+    append_indent(gen);
+    append(gen, "if (p->calls[h] == 0) continue;\n");
+    append_indent(gen);
+    append(gen, "fprintf(out, \"hook %s %s calls %llu cycles %llu\\n\", type_names[t], hook_names[h],\n");
+    append_indent(gen);
+    append(gen, "        (unsigned long long)p->calls[h], (unsigned long long)p->cycles[h]);\n");
+    gen->indent_level--;
+    append_indent(gen);
+    append(gen, "}\n");
+    gen->indent_level--;
+    append_indent(gen);
+    append(gen, "}\n");
+
+    append_indent(gen);
+    append(gen, "for (int b = 0; b < WHISKER_BRANCH_COUNT; b++) {\n");
+    gen->indent_level++;
+    append_indent(gen);
+    append(gen, "if (game->profile.branch_total[b] == 0) continue;\n");
+    append_indent(gen);
+    append(gen, "fprintf(out, \"branch %s %s %d line %d taken %llu total %llu\\n\",\n");
+    append_indent(gen);
+    append(gen, "        type_names[whisker_branch_sites[b].type], hook_names[whisker_branch_sites[b].hook],\n");
+    append_indent(gen);
+    append(gen, "        whisker_branch_sites[b].ordinal, whisker_branch_sites[b].line,\n");
+    append_indent(gen);
+    append(gen, "        (unsigned long long)game->profile.branch_taken[b], (unsigned long long)game->profile.branch_total[b]);\n");
+    gen->indent_level--;
+    append_indent(gen);
+    append(gen, "}\n");
+
+    gen->indent_level--;
+    append(gen, "}\n\n");
+}
+
+// Lock-free ring of begin/end events for --trace builds. Writers claim a slot
+// with one atomic add; once the ring wraps, the oldest events are overwritten.
+static void generate_trace_runtime(CodeGen* gen) {
+    append(gen, "#include <stdio.h>\n");
+    append(gen, "#include <time.h>\n\n");
+    append(gen, "#define WHISKER_TRACE_CAPACITY 65536  // power of two\n\n");
+    append(gen, "typedef struct {\n");
+    append(gen, "    uint64_t ns;\n");
+    append(gen, "    const char* name;\n");
+    append(gen, "    char phase;  // 'B' or 'E'\n");
+    append(gen, "} WhiskerTraceEvent;\n\n");
+    append(gen, "static WhiskerTraceEvent whisker_trace_events[WHISKER_TRACE_CAPACITY];\n");
+    append(gen, "static uint64_t whisker_trace_head;\n\n");
+    append(gen, "static inline void whisker_trace(const char* name, char phase) {\n");
+    append(gen, "    struct timespec ts;\n");
+    append(gen, "    clock_gettime(CLOCK_MONOTONIC, &ts);\n");
+    append(gen, "    uint64_t slot = __atomic_fetch_add(&whisker_trace_head, 1, __ATOMIC_RELAXED);\n");
+    append(gen, "    WhiskerTraceEvent* e = &whisker_trace_events[slot & (WHISKER_TRACE_CAPACITY - 1)];\n");
+    append(gen, "    e->ns = (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;\n");
+    append(gen, "    e->name = name;\n");
+    append(gen, "    e->phase = phase;\n");
+    append(gen, "}\n\n");
+}
+
+// Chrome trace-event JSON, loadable in chrome://tracing and Perfetto.
+static void generate_trace_write(CodeGen* gen) {
+    append(gen, "bool game_trace_write(const char* path) {\n");
+    gen->indent_level++;
+    append_indent(gen);
+    append(gen, "FILE* out = fopen(path, \"w\");\n");
+    append_indent(gen);
+    append(gen, "if (!out) return false;\n\n");
+    append_indent(gen);
+    append(gen, "uint64_t head = __atomic_load_n(&whisker_trace_head, __ATOMIC_ACQUIRE);\n");
+    append_indent(gen);
+    append(gen, "uint64_t first = head > WHISKER_TRACE_CAPACITY ? head - WHISKER_TRACE_CAPACITY : 0;\n");
+    append_indent(gen);
+    append(gen, "uint64_t origin = head > first ? whisker_trace_events[first & (WHISKER_TRACE_CAPACITY - 1)].ns : 0;\n\n");
+    append_indent(gen);
+    append(gen, "fprintf(out, \"{\\\"traceEvents\\\":[\\n\");\n");
+    append_indent(gen);
+    append(gen, "for (uint64_t i = first; i < head; i++) {\n");
+    gen->indent_level++;
+    append_indent(gen);
+    append(gen, "WhiskerTraceEvent* e = &whisker_trace_events[i & (WHISKER_TRACE_CAPACITY - 1)];\n");
+    append_indent(gen);
+    append(gen, "fprintf(out, \"%s{\\\"name\\\":\\\"%s\\\",\\\"ph\\\":\\\"%c\\\",\\\"ts\\\":%.3f,\\\"pid\\\":1,\\\"tid\\\":1}\\n\",\n");
+    append_indent(gen);
+    append(gen, "        i == first ? \"\" : \",\", e->name, e->phase, (double)(e->ns - origin) / 1000.0);\n");
+    gen->indent_level--;
+    append_indent(gen);
+    append(gen, "}\n");
+    append_indent(gen);
+    append(gen, "fprintf(out, \"]}\\n\");\n");
+    append_indent(gen);
+    append(gen, "return fclose(out) == 0;\n");
     gen->indent_level--;
     append(gen, "}\n\n");
 }
 
 void codegen_generate_program(CodeGen* gen, Program* program) {
+    if (gen->options.profile || gen->options.profile_use) {
+        for (int i = 0; i < program->entity_count; i++) {
+            collect_entity_branches(gen, program->entities[i]);
+        }
+    }
+
     // ===== HEADER =====
     append_h(gen, "#ifndef GAME_GENERATED_H\n");
     append_h(gen, "#define GAME_GENERATED_H\n\n");
@@ -976,6 +3411,9 @@ void codegen_generate_program(CodeGen* gen, Program* program) {
     append_h(gen, "#include \"collision.h\"\n");
     append_h(gen, "#include \"timer.h\"\n\n");
     append_h(gen, "#include \"sprite.h\"\n\n");
+    if (gen->options.profile) {
+        append_h(gen, "#include <stdio.h>\n\n");
+    }
 
     append_h(gen, "typedef enum {\n");
     for (int i = 0; i < program->entity_count; i++) {
@@ -989,6 +3427,13 @@ void codegen_generate_program(CodeGen* gen, Program* program) {
     append_h(gen, "    ENTITY_TYPE_COUNT\n");
     append_h(gen, "} EntityType;\n\n");
 
+    generate_effects_types_h(gen);
+    generate_type_info_h(gen);
+
+    if (gen->options.profile) {
+        generate_profile_types_h(gen);
+    }
+
     // Entity structs and arrays go in header
     for (int i = 0; i < program->entity_count; i++) {
         generate_entity_struct_h(gen, program->entities[i]);
@@ -1006,7 +3451,10 @@ void codegen_generate_program(CodeGen* gen, Program* program) {
             if (lower_name[j] >= 'A' && lower_name[j] <= 'Z') lower_name[j] += 32;
         }
         appendf_h(gen, "uint32_t %s_create(GameState* game, float x, float y);\n", lower_name);
-        appendf_h(gen, "void %s_update(GameState* game, uint32_t entity_id);\n", lower_name);
+        appendf_h(gen, "void %s_spawn_many(GameState* game, int n, const float* xs, const float* ys);\n", lower_name);
+        if (program->entities[i]->on_update) {
+            appendf_h(gen, "void %s_update(GameState* game, uint32_t entity_id);\n", lower_name);
+        }
         appendf_h(gen, "void %s_destroy(GameState* game, uint32_t entity_id);\n", lower_name);
     }
 
@@ -1014,20 +3462,57 @@ void codegen_generate_program(CodeGen* gen, Program* program) {
     append_h(gen, "bool place_meeting(GameState* game, uint32_t entity_id, float x, float y, EntityType type);\n\n");
 
     append_h(gen, "void instance_destroy(GameState* game, uint32_t entity_id);\n");
+    append_h(gen, "void game_flush_destroys(GameState* game);\n");
+    if (uses_spawn_blob(gen, program)) {
+        append_h(gen, "bool game_load_spawns(GameState* game, const char* path);\n");
+    }
 
     append_h(gen,"void game_init(GameState* game);");
     append_h(gen,"void game_update(GameState* game);");
     append_h(gen,"void game_cleanup(GameState* game);");
     append_h(gen,"void dispatch_collision(GameState* game, uint32_t id1, uint32_t id2);");
+    if (gen->options.profile) {
+        append_h(gen, "\nvoid game_profile_dump(GameState* game, FILE* out);");
+    }
+    if (gen->options.trace) {
+        append_h(gen, "\nbool game_trace_write(const char* path);");
+    }
 
     append_h(gen, "\n#endif // GAME_GENERATED_H\n");
 
     // ===== SOURCE =====
-    append(gen, "#include \"game_generated.h\"\n\n");
+    // The trace clock and the profile clock fallback need clock_gettime,
+    // which -std=c99 hides.
+    if (gen->options.profile || gen->options.trace) {
+        append(gen, "#ifndef _POSIX_C_SOURCE\n");
+        append(gen, "#define _POSIX_C_SOURCE 199309L\n");
+        append(gen, "#endif\n");
+    }
+    appendf(gen, "#include \"%s\"\n", gen->options.header_name);
+    append(gen, "#include <string.h>\n\n");
+    if (gen->options.profile) {
+        generate_profile_runtime(gen);
+    }
+    if (gen->options.profile_use) {
+        generate_profile_use_macros(gen);
+    }
+    if (gen->options.trace) {
+        generate_trace_runtime(gen);
+    }
+    if (program_has_parallel(gen, program)) {
+        generate_parallel_runtime(gen);
+    }
+
+    generate_effects_table(gen, program);
+    generate_type_info_table(gen, program);
+    generate_id_helpers(gen, program);
 
     // Function implementations go in source
     for (int i = 0; i < program->entity_count; i++) {
-        generate_entity_create(gen, program->entities[i]);
+        CreatePlan plan = plan_create(program->entities[i]);
+        generate_entity_create(gen, program->entities[i], &plan);
+        generate_entity_spawn_many(gen, program->entities[i], &plan);
+        free_create_plan(&plan);
         generate_entity_update(gen, program->entities[i]);
         generate_entity_destroy(gen, program->entities[i], program);
         generate_entity_collision(gen, program->entities[i]);
@@ -1039,18 +3524,74 @@ void codegen_generate_program(CodeGen* gen, Program* program) {
     generate_game_cleanup(gen, program);
     generate_collision_dispatcher(gen, program);
     generate_instance_destroy(gen, program);
+    if (gen->options.profile) {
+        generate_profile_dump(gen, program);
+    }
+    if (gen->options.trace) {
+        generate_trace_write(gen);
+    }
 }
 
-void codegen_write_files(CodeGen* gen, const char* header_path, const char* source_path) {
-    FILE* f = fopen(header_path, "w");
-    if (!f) error(error_messages[ERROR_FILELOAD].message);
-    fprintf(f, "%s", gen->header_output);
-    fclose(f);
-    printf("Wrote: %s\n", header_path);
+// Leaves the file (and its mtime) alone when the content is already there,
+// so the game build doesn't recompile untouched output.
+static bool write_bytes_if_changed(const char* path, const void* content, size_t length) {
+    FILE* f = fopen(path, "rb");
+    if (f) {
+        fseek(f, 0, SEEK_END);
+        long existing = ftell(f);
+        fseek(f, 0, SEEK_SET);
+
+        bool same = false;
+        if (existing == (long)length) {
+            char* old = malloc(length + 1);
+            if (!old) error(error_messages[ERROR_MALLOCFAIL].message);
+            same = fread(old, 1, length, f) == length && memcmp(old, content, length) == 0;
+            free(old);
+        }
+        fclose(f);
+        if (same) return false;
+    }
 
-    f = fopen(source_path, "w");
+    f = fopen(path, "wb");
     if (!f) error(error_messages[ERROR_FILELOAD].message);
-    fprintf(f, "%s", gen->source_output);
+    fwrite(content, 1, length, f);
     fclose(f);
-    printf("Wrote: %s\n", source_path);
+    return true;
+}
+
+static bool write_if_changed(const char* path, const char* content) {
+    return write_bytes_if_changed(path, content, strlen(content));
+}
+
+// The spawn blob sits next to the generated source.
+static void spawn_blob_path(CodeGen* gen, const char* source_path, char* out, size_t size) {
+    const char* slash = strrchr(source_path, '/');
+    if (slash) {
+        snprintf(out, size, "%.*s/%s", (int)(slash - source_path), source_path, gen->options.spawn_blob_name);
+    } else {
+        snprintf(out, size, "%s", gen->options.spawn_blob_name);
+    }
+}
+
+void codegen_write_files(CodeGen* gen, const char* header_path, const char* source_path) {
+    printf("%s: %s\n", write_if_changed(header_path, gen->header_output) ? "Wrote" : "Unchanged", header_path);
+    printf("%s: %s\n", write_if_changed(source_path, gen->source_output) ? "Wrote" : "Unchanged", source_path);
+    if (gen->spawn_blob) {
+        char blob_path[1024];
+        spawn_blob_path(gen, source_path, blob_path, sizeof(blob_path));
+        printf("%s: %s\n", write_bytes_if_changed(blob_path, gen->spawn_blob, gen->spawn_blob_length) ? "Wrote" : "Unchanged", blob_path);
+    }
+}
+
+// Quiet variant for batch builds; returns how many files were rewritten.
+int codegen_write_changed(CodeGen* gen, const char* header_path, const char* source_path) {
+    int written = 0;
+    if (write_if_changed(header_path, gen->header_output)) written++;
+    if (write_if_changed(source_path, gen->source_output)) written++;
+    if (gen->spawn_blob) {
+        char blob_path[1024];
+        spawn_blob_path(gen, source_path, blob_path, sizeof(blob_path));
+        if (write_bytes_if_changed(blob_path, gen->spawn_blob, gen->spawn_blob_length)) written++;
+    }
+    return written;
 }
@@ -1,12 +1,40 @@
 #ifndef CODEGEN_H
 #define CODEGEN_H
 
+#include <stdbool.h>
 #include "stmt.h"
 #include "expr.h"
 #include "entity_ast.h"
 #include "parser.h"
+#include "profile_data.h"
 
 typedef struct {
+    const char* header_name; // what the generated source #includes
+    const char* source_name; // the generated source itself, for #line
+    bool line_directives;    // map hook statements back to their .wsk lines
+    bool profile;            // count calls and cycles per entity type and hook
+    bool trace;              // record begin/end events for game_trace_write
+    bool strict_float;       // warn where hook code would still do double math
+    bool parallel;           // run self-contained update hooks on a thread pool
+    bool spawn_blob;         // load game-block spawns from a binary file at startup
+    const char* spawn_blob_name; // that file, next to the generated source
+    bool bake;               // compile the game block's initial state in as data
+    ProfileData* profile_use; // nullable: lay out hooks from a recorded profile
+} CodeGenOptions;
+
+#define CODEGEN_MAX_CSE 8
+
+// An `if` inside a hook; profiled builds count how often it is taken.
+typedef struct {
+    Stmt* stmt;
+    EntityDecl* entity;
+    HookKind hook;
+    int ordinal; // among the ifs of this entity's hook, in source order
+} BranchSite;
+
+typedef struct {
+    CodeGenOptions options;
+
     char* header_output;
     int header_capacity;
     int header_length;
@@ -14,15 +42,40 @@ typedef struct {
     char* source_output;
     int source_capacity;
     int source_length;
+    int source_lines;      // newlines written to source_output so far
 
     int indent_level;
+    const char* line_file; // script of the hook being generated, when mapping lines
+    EntityDecl* hook_entity;
+    HookKind hook_kind;
+
+    BranchSite* branches;
+    int branch_count;
+    int branch_capacity;
+
+    // Component pointers bound once at the top of the current hook.
+    bool bind_transform;   // transform_t* tf
+    bool bind_renderable;  // Renderable* rd
+
+    // Repeated subexpressions of the current statement, hoisted into _cseN.
+    Expr* cse[CODEGEN_MAX_CSE];
+    int cse_ids[CODEGEN_MAX_CSE];
+    int cse_count;
+    int cse_active;        // only the first cse_active are substituted
+    int cse_next;          // next temp number in this hook
+
+    // --spawn-blob: the game block's spawn table, written next to the source.
+    unsigned char* spawn_blob;
+    size_t spawn_blob_length;
 } CodeGen;
 
 
+CodeGenOptions codegen_default_options(void);
 CodeGen codegen_create(void);
 void codegen_free(CodeGen* gen);
 void codegen_generate_program(CodeGen* gen, Program* program);
 char* codegen_get_output(CodeGen* gen);
 void codegen_write_files(CodeGen* gen, const char* header_path, const char* source_path);
+int codegen_write_changed(CodeGen* gen, const char* header_path, const char* source_path);
 
 #endif
@@ -0,0 +1,179 @@
+#include "effects.h"
+#include <string.h>
+
+typedef struct {
+    const char* name;
+    unsigned effects;
+    unsigned component_reads;
+} BuiltinEffects;
+
+static const BuiltinEffects builtin_effects[] = {
+    {"place_meeting", EFFECT_QUERY, COMPONENT_COLLISION},
+    {"keyboard_check", EFFECT_INPUT, 0},
+    {"instance_destroy", EFFECT_DESTROY, 0},
+    {NULL, 0, 0}
+};
+
+typedef struct {
+    EntityDecl* entity; // NULL when only the effect bits are wanted
+    HookKind hook;
+    HookEffects* out;
+} Analysis;
+
+static uint64_t field_bit(EntityDecl* entity, const char* name) {
+    if (!entity) return 0;
+    for (int i = 0; i < entity->field_count; i++) {
+        if (strcmp(entity->fields[i].name.lexeme, name) == 0) {
+            return 1ull << (i < 63 ? i : 63);
+        }
+    }
+    return 0;
+}
+
+static unsigned component_bit(const char* name) {
+    if (strcmp(name, "transform") == 0) return COMPONENT_TRANSFORM;
+    if (strcmp(name, "renderable") == 0) return COMPONENT_RENDERABLE;
+    if (strcmp(name, "collision") == 0) return COMPONENT_COLLISION;
+    return 0;
+}
+
+static bool has_suffix(const char* s, const char* suffix) {
+    size_t length = strlen(s);
+    size_t suffix_length = strlen(suffix);
+    return length >= suffix_length && strcmp(s + length - suffix_length, suffix) == 0;
+}
+
+static void analyze_expr(Analysis* a, Expr* expr);
+
+// self.name or component.name, read or written.
+static void analyze_member(Analysis* a, Expr* object, Token name, bool write) {
+    if (object->type != EXPR_VARIABLE) {
+        analyze_expr(a, object);
+        return;
+    }
+
+    const char* owner = object->as.variable.name.lexeme;
+    if (strcmp(owner, "self") == 0) {
+        if (write) a->out->field_writes |= field_bit(a->entity, name.lexeme);
+        else a->out->field_reads |= field_bit(a->entity, name.lexeme);
+    } else if (component_bit(owner)) {
+        if (write) a->out->component_writes |= component_bit(owner);
+        else a->out->component_reads |= component_bit(owner);
+    } else {
+        analyze_expr(a, object);
+    }
+}
+
+static void analyze_call(Analysis* a, Expr* expr) {
+    for (int i = 0; i < expr->as.call.argc; i++) {
+        analyze_expr(a, expr->as.call.argv[i]);
+    }
+
+    Expr* callee = expr->as.call.callee;
+    if (callee->type != EXPR_VARIABLE) {
+        a->out->effects |= EFFECT_UNKNOWN;
+        return;
+    }
+
+    const char* name = callee->as.variable.name.lexeme;
+    for (int i = 0; builtin_effects[i].name; i++) {
+        if (strcmp(builtin_effects[i].name, name) == 0) {
+            a->out->effects |= builtin_effects[i].effects;
+            a->out->component_reads |= builtin_effects[i].component_reads;
+            return;
+        }
+    }
+
+    // player_create(...) and friends.
+    a->out->effects |= has_suffix(name, "_create") ? EFFECT_SPAWN : EFFECT_UNKNOWN;
+}
+
+static void analyze_expr(Analysis* a, Expr* expr) {
+    if (!expr) return;
+
+    switch (expr->type) {
+        case EXPR_LITERAL:
+            break;
+        case EXPR_VARIABLE:
+            if (a->entity && a->hook == HOOK_COLLISION && a->entity->collision_param.lexeme &&
+                strcmp(expr->as.variable.name.lexeme, a->entity->collision_param.lexeme) == 0) {
+                a->out->effects |= EFFECT_OTHER;
+            }
+            break;
+        case EXPR_GROUPING:
+            analyze_expr(a, expr->as.grouping.expression);
+            break;
+        case EXPR_UNARY:
+            analyze_expr(a, expr->as.unary.right);
+            break;
+        case EXPR_BINARY:
+            analyze_expr(a, expr->as.binary.left);
+            analyze_expr(a, expr->as.binary.right);
+            break;
+        case EXPR_ASSIGN:
+            analyze_expr(a, expr->as.assign.value);
+            break;
+        case EXPR_GET:
+            analyze_member(a, expr->as.get.object, expr->as.get.name, false);
+            break;
+        case EXPR_SET:
+            analyze_member(a, expr->as.set.object, expr->as.set.name, true);
+            analyze_expr(a, expr->as.set.value);
+            break;
+        case EXPR_CALL:
+            analyze_call(a, expr);
+            break;
+    }
+}
+
+static void analyze_stmt(Analysis* a, Stmt* stmt) {
+    if (!stmt) return;
+
+    switch (stmt->type) {
+        case STMT_EXPRESSION:
+            analyze_expr(a, stmt->as.expr.expr);
+            break;
+        case STMT_PRINT:
+            analyze_expr(a, stmt->as.print.expr);
+            break;
+        case STMT_VAR:
+            analyze_expr(a, stmt->as.var.initializer);
+            break;
+        case STMT_BLOCK:
+            for (int i = 0; i < stmt->as.block.count; i++) {
+                analyze_stmt(a, stmt->as.block.statements[i]);
+            }
+            break;
+        case STMT_IF:
+            analyze_expr(a, stmt->as.if_stmt.condition);
+            analyze_stmt(a, stmt->as.if_stmt.then_branch);
+            analyze_stmt(a, stmt->as.if_stmt.else_branch);
+            break;
+        case STMT_WHILE:
+            analyze_expr(a, stmt->as.while_stmt.condition);
+            analyze_stmt(a, stmt->as.while_stmt.body);
+            break;
+    }
+}
+
+unsigned expr_effects(Expr* expr) {
+    HookEffects effects = {0};
+    Analysis a = {NULL, HOOK_UPDATE, &effects};
+    analyze_expr(&a, expr);
+    return effects.effects;
+}
+
+void effects_analyze_entity(EntityDecl* entity) {
+    Stmt* hooks[HOOK_COUNT] = {entity->on_create, entity->on_update, entity->on_destroy, entity->on_collision};
+    for (int i = 0; i < HOOK_COUNT; i++) {
+        entity->effects[i] = (HookEffects){0};
+        Analysis a = {entity, (HookKind)i, &entity->effects[i]};
+        analyze_stmt(&a, hooks[i]);
+    }
+}
+
+void effects_analyze_program(Program* program) {
+    for (int i = 0; i < program->entity_count; i++) {
+        effects_analyze_entity(program->entities[i]);
+    }
+}
@@ -0,0 +1,20 @@
+#ifndef EFFECTS_H
+#define EFFECTS_H
+
+#include "entity_ast.h"
+#include "parser.h"
+
+// Effects after which component pointers and entity arrays may have moved.
+// instance_destroy is deferred to game_flush_destroys, so it is not one.
+#define EFFECTS_MOVING (EFFECT_SPAWN | EFFECT_UNKNOWN)
+
+// Fills in entity->effects for every hook: which self fields and components
+// it reads and writes, and which global effects it has. Run after optimize,
+// so pruned code does not count.
+void effects_analyze_program(Program* program);
+void effects_analyze_entity(EntityDecl* entity);
+
+// The EffectBits of one expression, for codegen decisions within a hook.
+unsigned expr_effects(Expr* expr);
+
+#endif
@@ -1,6 +1,7 @@
 #include "entity_ast.h"
 #include "error.h"
 #include <stdlib.h>
+#include <string.h>
 
 EntityDecl* entity_decl_create(Token name, EntityField* fields, int field_count,
     Stmt* init, Stmt* on_create, Stmt* on_update, Stmt* on_destroy, Stmt* on_collision, Token collision_param) {
@@ -16,6 +17,11 @@ EntityDecl* entity_decl_create(Token name, EntityField* fields, int field_count,
     entity->on_destroy = on_destroy;
     entity->on_collision = on_collision;
     entity->collision_param = collision_param;
+    entity->path = NULL;
+    entity->capacity = 0;
+    entity->pooled = false;
+    entity->singleton = false;
+    memset(entity->effects, 0, sizeof(entity->effects));
 
     return entity;
 }
@@ -37,3 +43,13 @@ void entity_decl_free(EntityDecl* entity) {
     }
     free(entity);
 }
+
+const char* hook_kind_name(HookKind hook) {
+    switch (hook) {
+        case HOOK_CREATE: return "create";
+        case HOOK_UPDATE: return "update";
+        case HOOK_DESTROY: return "destroy";
+        case HOOK_COLLISION: return "collision";
+        default: return "unknown";
+    }
+}
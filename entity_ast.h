@@ -1,21 +1,53 @@
 #ifndef ENTITY_AST_H
 #define ENTITY_AST_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "token.h"
 #include "stmt.h"
-
-typedef enum {
-    TYPE_FLOAT,
-    TYPE_INT,
-    TYPE_BOOL,
-    TYPE_UINT32
-} FieldType;
+#include "types.h"
 
 typedef struct {
     Token name;
     FieldType type;
 } EntityField;
 
+// Lifecycle hooks that become generated functions.
+typedef enum {
+    HOOK_CREATE,
+    HOOK_UPDATE,
+    HOOK_DESTROY,
+    HOOK_COLLISION,
+    HOOK_COUNT
+} HookKind;
+
+// Engine components a hook can touch, as bits.
+typedef enum {
+    COMPONENT_TRANSFORM = 1 << 0,
+    COMPONENT_RENDERABLE = 1 << 1,
+    COMPONENT_COLLISION = 1 << 2
+} ComponentBits;
+
+// Effects beyond the entity's own fields and components, as bits.
+typedef enum {
+    EFFECT_DESTROY = 1 << 0,  // instance_destroy
+    EFFECT_SPAWN = 1 << 1,    // creates entities
+    EFFECT_INPUT = 1 << 2,    // keyboard_check
+    EFFECT_QUERY = 1 << 3,    // place_meeting: reads other entities' shapes
+    EFFECT_OTHER = 1 << 4,    // uses another entity's id
+    EFFECT_UNKNOWN = 1 << 5   // calls C code we know nothing about
+} EffectBits;
+
+// What one hook reads and writes, filled in by effects_analyze_program.
+// Bit i of the field masks is fields[i]; fields past 63 share bit 63.
+typedef struct {
+    uint64_t field_reads;
+    uint64_t field_writes;
+    unsigned component_reads;
+    unsigned component_writes;
+    unsigned effects;
+} HookEffects;
+
 typedef struct {
     Token name;              // entity name
     EntityField* fields;     // array of fields
@@ -26,6 +58,11 @@ typedef struct {
     Stmt* on_destroy;
     Stmt* on_collision;
     Token collision_param; // other member in collision
+    const char* path;      // script it was declared in, set by the module loader - nullable.
+    int capacity;          // `capacity N;` - instances to preallocate, 0 for the default.
+    bool pooled;           // `entity Name pooled` - destroyed instances are parked for reuse.
+    bool singleton;        // `entity Name singleton` - at most one instance, embedded in GameState.
+    HookEffects effects[HOOK_COUNT];
 } EntityDecl;
 
 typedef struct {
@@ -35,5 +72,6 @@ typedef struct {
 
 EntityDecl* entity_decl_create(Token name, EntityField* fields, int field_count, Stmt* init, Stmt* on_create, Stmt* on_update, Stmt* on_destroy, Stmt* on_collision, Token collision_param);
 void entity_decl_free(EntityDecl* entity);
+const char* hook_kind_name(HookKind hook);
 
 #endif
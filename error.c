@@ -2,17 +2,56 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+// Innermost recovery point of this thread; build workers each have their own.
+static __thread ErrorRecovery* recovery_top = NULL;
+
+void error_push_recovery(ErrorRecovery* recovery) {
+    recovery->message[0] = '\0';
+    recovery->line_offset = 0;
+    recovery->previous = recovery_top;
+    recovery_top = recovery;
+}
+
+void error_pop_recovery(ErrorRecovery* recovery) {
+    recovery_top = recovery->previous;
+}
+
+static void recover(void) {
+    ErrorRecovery* recovery = recovery_top;
+    recovery_top = recovery->previous;
+    longjmp(recovery->jump, 1);
+}
+
 void error(const char* message) {
+    if (recovery_top) {
+        snprintf(recovery_top->message, sizeof(recovery_top->message), "%s", message);
+        recover();
+    }
     printf("%s", message);
     exit(1);
 }
 
 void error_at_line(int line, const char* message) {
+    if (recovery_top) {
+        snprintf(recovery_top->message, sizeof(recovery_top->message), "[line %d] Error: %s",
+                 line + recovery_top->line_offset, message);
+        recover();
+    }
     fprintf(stderr, "[line %d] Error: %s\n", line, message);
     exit(1);  // Just die immediately
 }
 
 void error_at_token(Token token, const char* message) {
+    if (recovery_top) {
+        snprintf(recovery_top->message, sizeof(recovery_top->message), "[line %d] Error at '%s': %s",
+                 token.line + recovery_top->line_offset, token.lexeme, message);
+        recover();
+    }
     fprintf(stderr, "[line %d] Error at '%s': %s\n", token.line, token.lexeme, message);
     exit(1);
 }
+
+void warning_at_line(int line, const char* message) {
+    if (recovery_top) line += recovery_top->line_offset;
+    fprintf(stderr, "[line %d] Warning: %s\n", line, message);
+}
@@ -1,5 +1,6 @@
 #ifndef ERROR_H
 #define ERROR_H
+#include <setjmp.h>
 #include "token.h"
 
 typedef enum {
@@ -25,8 +26,29 @@ static const ErrorMessageMap error_messages[] = {
     { ERROR_ARGC, "Wrong argument amount." },
 };
 
+// Somewhere to land instead of exiting. While a recovery point is pushed on
+// the calling thread, error(), error_at_line() and error_at_token() leave
+// their message in it and longjmp back instead of printing and exiting:
+//
+//     ErrorRecovery recovery;
+//     error_push_recovery(&recovery);
+//     if (setjmp(recovery.jump) == 0) { ...anything that may fail... }
+//     error_pop_recovery(&recovery);
+//
+// Whatever the failed work had allocated so far is not freed.
+typedef struct ErrorRecovery {
+    jmp_buf jump;
+    char message[512];
+    int line_offset; // added to reported lines, for text lexed from mid-file; 0 on push
+    struct ErrorRecovery* previous;
+} ErrorRecovery;
+
+void error_push_recovery(ErrorRecovery* recovery);
+void error_pop_recovery(ErrorRecovery* recovery);
+
 void error(const char* message);
 void error_at_line(int line, const char* message);
 void error_at_token(Token token, const char* message);
+void warning_at_line(int line, const char* message);
 
 #endif
@@ -7,6 +7,7 @@ Expr* expr_binary(Expr* left, Token oprt, Expr* right) {
     if (!expr) error(error_messages[ERROR_MALLOCFAIL].message);
 
     expr->type = EXPR_BINARY;
+    expr->value_type = TYPE_UNKNOWN;
     expr->as.binary.left = left;
     expr->as.binary.oprt = oprt;
     expr->as.binary.right = right;
@@ -19,6 +20,7 @@ Expr* expr_unary(Token oprt, Expr* right) {
     if (!expr) error(error_messages[ERROR_MALLOCFAIL].message);
 
     expr->type = EXPR_UNARY;
+    expr->value_type = TYPE_UNKNOWN;
     expr->as.unary.oprt = oprt;
     expr->as.unary.right = right;
 
@@ -30,7 +32,9 @@ Expr* expr_literal(Literal value) {
     if (!expr) error(error_messages[ERROR_MALLOCFAIL].message);
 
     expr->type = EXPR_LITERAL;
+    expr->value_type = TYPE_UNKNOWN;
     expr->as.literal.value = value;
+    expr->as.literal.integer = false;
 
     return expr;
 }
@@ -40,6 +44,7 @@ Expr* expr_grouping(Expr* expression) {
     if (!expr) error(error_messages[ERROR_MALLOCFAIL].message);
 
     expr->type = EXPR_GROUPING;
+    expr->value_type = TYPE_UNKNOWN;
     expr->as.grouping.expression = expression;
 
     return expr;
@@ -50,6 +55,7 @@ Expr* expr_variable(Token name) {
     if (!expr) error(error_messages[ERROR_MALLOCFAIL].message);
 
     expr->type = EXPR_VARIABLE;
+    expr->value_type = TYPE_UNKNOWN;
     expr->as.variable.name = token_copy(name);  // <-- own the string
     return expr;
 }
@@ -59,6 +65,7 @@ Expr* expr_assign(Token name, Expr* value) {
     if (!expr) error(error_messages[ERROR_MALLOCFAIL].message);
 
     expr->type = EXPR_ASSIGN;
+    expr->value_type = TYPE_UNKNOWN;
     expr->as.assign.name = token_copy(name);
     expr->as.assign.value = value;
 
@@ -70,6 +77,7 @@ Expr* expr_get(Expr* object, Token name) {
     if (!expr) error(error_messages[ERROR_MALLOCFAIL].message);
 
     expr->type = EXPR_GET;
+    expr->value_type = TYPE_UNKNOWN;
     expr->as.get.object = object;
     expr->as.get.name = token_copy(name);
 
@@ -81,6 +89,7 @@ Expr* expr_set(Expr* object, Token name, Expr* value) {
     if (!expr) error(error_messages[ERROR_MALLOCFAIL].message);
 
     expr->type = EXPR_SET;
+    expr->value_type = TYPE_UNKNOWN;
     expr->as.set.object = object;
     expr->as.set.name = token_copy(name);
     expr->as.set.value = value;
@@ -93,6 +102,7 @@ Expr* expr_call(Expr* callee, int argc, Expr** argv) {
     if (!expr) error(error_messages[ERROR_MALLOCFAIL].message);
 
     expr->type = EXPR_CALL;
+    expr->value_type = TYPE_UNKNOWN;
     expr->as.call.callee = callee;
     expr->as.call.argv = argv;
     expr->as.call.argc = argc;
@@ -3,6 +3,7 @@
 
 #include "token.h"
 #include "literal.h"
+#include "types.h"
 
 typedef struct Expr Expr;
 
@@ -31,6 +32,7 @@ typedef struct {
 
 typedef struct {
     Literal value;
+    bool integer; // number written without a decimal point
 } LiteralExpr;
 
 typedef struct {
@@ -65,6 +67,7 @@ typedef struct {
 
 struct Expr {
     ExprType type;
+    FieldType value_type; // filled in by the type checker
     union {
         BinaryExpr binary;
         UnaryExpr unary;
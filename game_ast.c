@@ -8,6 +8,7 @@ GameDecl* game_decl_create(SpawnCall* spawns, int spawn_count) {
     
     game->spawns = spawns;
     game->spawn_count = spawn_count;
+    game->capacity = 0;
     return game;
 }
 
@@ -12,6 +12,7 @@ typedef struct {
 typedef struct {
     SpawnCall* spawns;
     int spawn_count;
+    int capacity; // `capacity N;` - live entities to preallocate for, 0 for the default.
 } GameDecl;
 
 GameDecl* game_decl_create(SpawnCall* spawns, int spawn_count);
@@ -0,0 +1,578 @@
+#include "incremental.h"
+#include "effects.h"
+#include "entity_ast.h"
+#include "error.h"
+#include "game_ast.h"
+#include "optimize.h"
+#include "scanner.h"
+#include "stmt.h"
+#include "typecheck.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void free_decl(TopLevelDecl* decl) {
+    switch (decl->kind) {
+        case DECL_ENTITY:
+            entity_decl_free(decl->as.entity);
+            break;
+        case DECL_GAME:
+            game_decl_free(decl->as.game);
+            break;
+        case DECL_STMT:
+            stmt_free(decl->as.stmt);
+            break;
+        case DECL_IMPORT:
+            free(decl->as.import.lexeme);
+            free(decl->as.import.literal.as.string);
+            break;
+    }
+}
+
+static void free_region(DeclRegion* region) {
+    free_decl(&region->decl);
+    free_token_list(&region->tokens);
+}
+
+// Frees tokens[first..] and the list itself; the ones before belong to regions.
+static void free_tokens_from(TokenList* tokens, int first) {
+    for (int i = first; i < tokens->count; i++) {
+        free(tokens->data[i].lexeme);
+        if (tokens->data[i].literal.type == LITERAL_STRING) free(tokens->data[i].literal.as.string);
+    }
+    free(tokens->data);
+}
+
+static void set_error(IncrementalDoc* doc, const char* message) {
+    doc->has_error = true;
+    snprintf(doc->error_message, sizeof(doc->error_message), "%s", message);
+}
+
+static int count_lines(const char* text, int length) {
+    int lines = 0;
+    for (int i = 0; i < length; i++) {
+        if (text[i] == '\n') lines++;
+    }
+    return lines;
+}
+
+// Lexes `text` as if it started on line 1; errors still name document line
+// `line`. The scanner is on the heap so that its tokens can still be freed
+// after a lexing error jumps out of it.
+static bool relex(IncrementalDoc* doc, const char* text, int length, int line, TokenList* out) {
+    char* slice = my_strndup(text, length);
+    Scanner* scanner = malloc(sizeof(Scanner));
+    if (!scanner) error(error_messages[ERROR_MALLOCFAIL].message);
+    *scanner = scanner_create(slice);
+
+    ErrorRecovery recovery;
+    error_push_recovery(&recovery);
+    recovery.line_offset = line - 1;
+    if (setjmp(recovery.jump) != 0) {
+        free_token_list(&scanner->tokens);
+        free(scanner);
+        free(slice);
+        set_error(doc, recovery.message);
+        return false;
+    }
+    *out = scan_tokens(scanner);
+    error_pop_recovery(&recovery);
+
+    free(scanner);
+    free(slice);
+    return true;
+}
+
+// An edit that removes a closing brace makes the declaration run on into the
+// next region, so the damaged range must grow until the braces balance again.
+static bool braces_balanced(TokenList* tokens) {
+    int depth = 0;
+    for (int i = 0; i < tokens->count; i++) {
+        if (tokens->data[i].type == TOKEN_LEFT_BRACE) depth++;
+        if (tokens->data[i].type == TOKEN_RIGHT_BRACE) depth--;
+    }
+    return depth <= 0;
+}
+
+// What split_regions has built so far. It lives on the heap so that it is
+// still intact after an error jumps out of the parser or the checkers.
+typedef struct {
+    TokenList tokens;
+    DeclRegion* regions;
+    int count;
+    int capacity;
+    int consumed;         // tokens before this one belong to regions
+    TopLevelDecl pending; // parsed but not yet checked
+    bool has_pending;
+} Split;
+
+static void split_into(Split* split, int base, int line) {
+    TokenList tokens = split->tokens;
+    Parser parser = parser_create(tokens);
+    while (!parser_at_end(&parser)) {
+        int first = parser.current;
+        split->pending = parse_top_level(&parser);
+        split->has_pending = true;
+        int last = parser.current;
+        TopLevelDecl decl = split->pending;
+        if (decl.kind == DECL_ENTITY) {
+            typecheck_entity(decl.as.entity);
+            optimize_entity(decl.as.entity);
+            effects_analyze_entity(decl.as.entity);
+        }
+
+        if (split->count >= split->capacity) {
+            split->capacity *= 2;
+            DeclRegion* new_regions = realloc(split->regions, sizeof(DeclRegion) * split->capacity);
+            if (!new_regions) error(error_messages[ERROR_REALLOCFAIL].message);
+            split->regions = new_regions;
+        }
+
+        DeclRegion* region = &split->regions[split->count++];
+        region->decl = decl;
+        // The first region also owns any leading whitespace and comments.
+        region->start = split->count == 1 ? base : base + tokens.data[first].offset;
+        region->line_base = line - 1;
+        region->line = split->count == 1 ? line : region->line_base + tokens.data[first].line;
+        region->tokens = create_token_list(last - first + 1);
+        for (int i = first; i < last; i++) {
+            add_token_list(&region->tokens, tokens.data[i]);
+        }
+        Token eof = {
+            .type = TOKEN_EOF,
+            .lexeme = my_strndup("", 0),
+            .line = tokens.data[last].line,
+            .offset = tokens.data[last].offset
+        };
+        add_token_list(&region->tokens, eof);
+        split->has_pending = false;
+        split->consumed = last;
+    }
+}
+
+// Parse the text relexed from document offset `base`, line `line`, into regions.
+// Consumes `tokens`: each region takes ownership of its own slice of them.
+// On an error everything parsed so far is freed and false is returned; the
+// subtree that was being parsed when it happened is leaked.
+static bool split_regions(IncrementalDoc* doc, TokenList tokens, int base, int length, int line,
+                          DeclRegion** out, int* out_count) {
+    Split* split = malloc(sizeof(Split));
+    if (!split) error(error_messages[ERROR_MALLOCFAIL].message);
+    *split = (Split){.tokens = tokens, .capacity = 4};
+    split->regions = malloc(sizeof(DeclRegion) * split->capacity);
+    if (!split->regions) error(error_messages[ERROR_MALLOCFAIL].message);
+
+    ErrorRecovery recovery;
+    error_push_recovery(&recovery);
+    recovery.line_offset = line - 1;
+    if (setjmp(recovery.jump) != 0) {
+        if (split->has_pending) free_decl(&split->pending);
+        for (int i = 0; i < split->count; i++) {
+            free_region(&split->regions[i]);
+        }
+        free(split->regions);
+        free_tokens_from(&split->tokens, split->consumed);
+        free(split);
+        set_error(doc, recovery.message);
+        return false;
+    }
+    split_into(split, base, line);
+    error_pop_recovery(&recovery);
+
+    DeclRegion* regions = split->regions;
+    int count = split->count;
+    for (int i = 0; i < count; i++) {
+        int end = (i + 1 < count) ? regions[i + 1].start : base + length;
+        regions[i].length = end - regions[i].start;
+    }
+
+    // Every token but the EOF marker now belongs to a region.
+    free_tokens_from(&split->tokens, tokens.count - 1);
+    free(split);
+
+    *out = regions;
+    *out_count = count;
+    return true;
+}
+
+static void shift_region(DeclRegion* region, int offset, int lines, const int* before) {
+    region->start += offset;
+    region->line += lines;
+    region->line_base += lines;
+    for (int k = 0; k < DECL_KINDS; k++) {
+        region->before[k] += before[k];
+    }
+}
+
+static void clear_shift(IncrementalDoc* doc) {
+    doc->shift_from = doc->region_count;
+    doc->shift_offset = 0;
+    doc->shift_lines = 0;
+    memset(doc->shift_before, 0, sizeof(doc->shift_before));
+}
+
+// Apply the pending shift to the regions before `upto`.
+static void settle(IncrementalDoc* doc, int upto) {
+    if (upto > doc->region_count) upto = doc->region_count;
+    for (int i = doc->shift_from; i < upto; i++) {
+        shift_region(&doc->regions[i], doc->shift_offset, doc->shift_lines, doc->shift_before);
+    }
+    if (upto >= doc->region_count) {
+        clear_shift(doc);
+    } else if (upto > doc->shift_from) {
+        doc->shift_from = upto;
+    }
+}
+
+// Move regions `from` onwards. Only the ones before the pending shift are
+// touched now; the rest pick it up when they are next settled.
+static void add_shift(IncrementalDoc* doc, int from, int offset, int lines, const int* before) {
+    for (int i = from; i < doc->shift_from; i++) {
+        shift_region(&doc->regions[i], offset, lines, before);
+    }
+    settle(doc, from);
+    if (doc->shift_from >= doc->region_count) return;
+    doc->shift_offset += offset;
+    doc->shift_lines += lines;
+    for (int k = 0; k < DECL_KINDS; k++) {
+        doc->shift_before[k] += before[k];
+    }
+}
+
+DeclRegion incremental_region(IncrementalDoc* doc, int index) {
+    DeclRegion region = doc->regions[index];
+    if (index >= doc->shift_from) shift_region(&region, doc->shift_offset, doc->shift_lines, doc->shift_before);
+    return region;
+}
+
+int incremental_line(IncrementalDoc* doc, int index, int line) {
+    int base = doc->regions[index].line_base;
+    return line + base + (index >= doc->shift_from ? doc->shift_lines : 0);
+}
+
+int incremental_region_at(IncrementalDoc* doc, int offset) {
+    int lo = 0;
+    int hi = doc->region_count - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        int start = doc->regions[mid].start + (mid >= doc->shift_from ? doc->shift_offset : 0);
+        if (start <= offset) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+// A second game block is reported, but the first one stays in `program`.
+static bool check_one_game(IncrementalDoc* doc) {
+    if (doc->game_count <= 1) return true;
+    int seen = 0;
+    for (int i = 0; i < doc->region_count; i++) {
+        if (doc->regions[i].decl.kind != DECL_GAME || ++seen < 2) continue;
+        char message[512];
+        snprintf(message, sizeof(message), "[line %d] Error at 'game': Only one 'game' block allowed.",
+                 incremental_region(doc, i).line);
+        set_error(doc, message);
+        break;
+    }
+    return false;
+}
+
+// Build `program` and the per-kind counts from scratch.
+static bool rebuild_program(IncrementalDoc* doc) {
+    Program* prog = &doc->program;
+    free(prog->statements);
+    free(prog->entities);
+    free(prog->imports);
+
+    int counts[DECL_KINDS] = {0};
+    for (int i = 0; i < doc->region_count; i++) {
+        memcpy(doc->regions[i].before, counts, sizeof(counts));
+        counts[doc->regions[i].decl.kind]++;
+    }
+
+    prog->statements = malloc(sizeof(Stmt*) * (counts[DECL_STMT] + 1));
+    prog->entities = malloc(sizeof(EntityDecl*) * (counts[DECL_ENTITY] + 1));
+    prog->imports = malloc(sizeof(Token) * (counts[DECL_IMPORT] + 1));
+    if (!prog->statements || !prog->entities || !prog->imports) error(error_messages[ERROR_MALLOCFAIL].message);
+    prog->count = 0;
+    prog->entity_count = 0;
+    prog->import_count = 0;
+    prog->game = NULL;
+    doc->game_count = counts[DECL_GAME];
+    clear_shift(doc);
+
+    for (int i = 0; i < doc->region_count; i++) {
+        DeclRegion* region = &doc->regions[i];
+        switch (region->decl.kind) {
+            case DECL_ENTITY:
+                prog->entities[prog->entity_count++] = region->decl.as.entity;
+                break;
+            case DECL_GAME:
+                if (!prog->game) prog->game = region->decl.as.game;
+                break;
+            case DECL_STMT:
+                prog->statements[prog->count++] = region->decl.as.stmt;
+                break;
+            case DECL_IMPORT:
+                prog->imports[prog->import_count++] = region->decl.as.import;
+                break;
+        }
+    }
+    return check_one_game(doc);
+}
+
+// Make room for `added` items in place of `removed` at index `at`.
+static void splice(void** items, size_t size, int* count, int at, int removed, int added) {
+    if (removed == added) return;
+    int new_count = *count - removed + added;
+    if (added > removed) {
+        void* resized = realloc(*items, size * (new_count + 1));
+        if (!resized) error(error_messages[ERROR_REALLOCFAIL].message);
+        *items = resized;
+    }
+    char* data = *items;
+    memmove(data + size * (at + added), data + size * (at + removed), size * (*count - at - removed));
+    *count = new_count;
+}
+
+// Swap the entries of regions first..last in `program` for those of `fresh`,
+// leaving everything else where it is. The regions must be settled.
+static void patch_program(IncrementalDoc* doc, int first, int last, DeclRegion* fresh, int count) {
+    Program* prog = &doc->program;
+    int base[DECL_KINDS];
+    memcpy(base, doc->regions[first].before, sizeof(base));
+
+    int old_counts[DECL_KINDS] = {0};
+    int new_counts[DECL_KINDS] = {0};
+    for (int i = first; i <= last; i++) {
+        old_counts[doc->regions[i].decl.kind]++;
+    }
+    for (int i = 0; i < count; i++) {
+        for (int k = 0; k < DECL_KINDS; k++) {
+            fresh[i].before[k] = base[k] + new_counts[k];
+        }
+        new_counts[fresh[i].decl.kind]++;
+    }
+
+    splice((void**)&prog->entities, sizeof(EntityDecl*), &prog->entity_count, base[DECL_ENTITY],
+           old_counts[DECL_ENTITY], new_counts[DECL_ENTITY]);
+    splice((void**)&prog->statements, sizeof(Stmt*), &prog->count, base[DECL_STMT],
+           old_counts[DECL_STMT], new_counts[DECL_STMT]);
+    splice((void**)&prog->imports, sizeof(Token), &prog->import_count, base[DECL_IMPORT],
+           old_counts[DECL_IMPORT], new_counts[DECL_IMPORT]);
+
+    for (int i = 0; i < count; i++) {
+        TopLevelDecl* decl = &fresh[i].decl;
+        int at = fresh[i].before[decl->kind];
+        switch (decl->kind) {
+            case DECL_ENTITY:
+                prog->entities[at] = decl->as.entity;
+                break;
+            case DECL_GAME:
+                if (at == 0) prog->game = decl->as.game;
+                break;
+            case DECL_STMT:
+                prog->statements[at] = decl->as.stmt;
+                break;
+            case DECL_IMPORT:
+                prog->imports[at] = decl->as.import;
+                break;
+        }
+    }
+
+    doc->game_count += new_counts[DECL_GAME] - old_counts[DECL_GAME];
+    if (base[DECL_GAME] == 0 && old_counts[DECL_GAME] > 0 && new_counts[DECL_GAME] == 0) {
+        // The game block went away: the next one, if any, takes over.
+        prog->game = NULL;
+        for (int i = last + 1; i < doc->region_count; i++) {
+            if (doc->regions[i].decl.kind == DECL_GAME) {
+                prog->game = doc->regions[i].decl.as.game;
+                break;
+            }
+        }
+    }
+}
+
+// Replace regions [first, last] with `count` fresh ones.
+static void replace_regions(IncrementalDoc* doc, int first, int last, DeclRegion* fresh, int count) {
+    for (int i = first; i <= last; i++) {
+        free_region(&doc->regions[i]);
+    }
+
+    int removed = last - first + 1;
+    int new_count = doc->region_count - removed + count;
+    if (new_count > doc->region_capacity) {
+        doc->region_capacity = new_count * 2;
+        DeclRegion* new_regions = realloc(doc->regions, sizeof(DeclRegion) * doc->region_capacity);
+        if (!new_regions) error(error_messages[ERROR_REALLOCFAIL].message);
+        doc->regions = new_regions;
+    }
+
+    memmove(&doc->regions[first + count], &doc->regions[last + 1],
+            sizeof(DeclRegion) * (doc->region_count - last - 1));
+    memcpy(&doc->regions[first], fresh, sizeof(DeclRegion) * count);
+    doc->region_count = new_count;
+    if (doc->shift_from > last) doc->shift_from += count - removed;
+}
+
+// The text of regions first..last, now doc->source[start, end), did not
+// parse. They keep their old subtrees, so `program` is the last good parse;
+// the first one spans the new text and the rest shrink to nothing at its end.
+static void keep_stale(IncrementalDoc* doc, int first, int last, int start, int end) {
+    doc->regions[first].start = start;
+    doc->regions[first].length = end - start;
+    for (int i = first + 1; i <= last; i++) {
+        doc->regions[i].start = end;
+        doc->regions[i].length = 0;
+    }
+    doc->stale_first = first;
+    doc->stale_last = last;
+}
+
+// Parse the whole text into a document that has no regions yet.
+static bool parse_all(IncrementalDoc* doc) {
+    TokenList tokens;
+    DeclRegion* regions = NULL;
+    int count = 0;
+    bool parsed = relex(doc, doc->source, doc->length, 1, &tokens) &&
+                  split_regions(doc, tokens, 0, doc->length, 1, &regions, &count);
+
+    free(doc->regions);
+    doc->regions = regions;
+    doc->region_count = count;
+    doc->region_capacity = count;
+    doc->stale_first = 0;
+    doc->stale_last = -1;
+    return rebuild_program(doc) && parsed;
+}
+
+IncrementalDoc incremental_open(const char* source) {
+    IncrementalDoc doc = {0};
+    doc.length = strlen(source);
+    doc.capacity = doc.length + 1;
+    doc.source = my_strndup(source, doc.length);
+    doc.stale_last = -1;
+
+    parse_all(&doc);
+    return doc;
+}
+
+bool incremental_edit(IncrementalDoc* doc, int offset, int deleted, const char* inserted) {
+    doc->has_error = false;
+    doc->error_message[0] = '\0';
+    if (offset < 0 || deleted < 0 || offset + deleted > doc->length) {
+        set_error(doc, "Edit range is outside the document.");
+        return false;
+    }
+
+    int inserted_length = strlen(inserted);
+    int delta = inserted_length - deleted;
+    int line_delta = count_lines(inserted, inserted_length) - count_lines(doc->source + offset, deleted);
+
+    // Find the damaged regions before the text moves. One byte of context on
+    // each side catches edits that glue a token onto its neighbour. Text that
+    // failed to parse last time is reparsed as well.
+    int first = 0;
+    int last = doc->region_count - 1;
+    if (doc->region_count > 0) {
+        first = incremental_region_at(doc, offset > 0 ? offset - 1 : 0);
+        last = incremental_region_at(doc, offset + deleted);
+        if (doc->stale_first <= doc->stale_last) {
+            if (doc->stale_first < first) first = doc->stale_first;
+            if (doc->stale_last > last) last = doc->stale_last;
+        }
+    }
+
+    // Splice the text
+    if (doc->length + delta + 1 > doc->capacity) {
+        doc->capacity = (doc->length + delta + 1) * 2;
+        char* new_source = realloc(doc->source, doc->capacity);
+        if (!new_source) error(error_messages[ERROR_REALLOCFAIL].message);
+        doc->source = new_source;
+    }
+    memmove(doc->source + offset + inserted_length, doc->source + offset + deleted,
+            doc->length - offset - deleted + 1);
+    memcpy(doc->source + offset, inserted, inserted_length);
+    doc->length += delta;
+
+    if (doc->region_count == 0) {
+        // Nothing parsed yet (empty, comment-only or broken document): start over.
+        return parse_all(doc);
+    }
+
+    settle(doc, last + 1);
+    int start = doc->regions[first].start;
+    int line = doc->regions[first].line;
+    int end;
+    TokenList tokens;
+    bool lexed;
+    for (;;) {
+        end = doc->regions[last].start + doc->regions[last].length + delta;
+        lexed = relex(doc, doc->source + start, end - start, line, &tokens);
+        if (!lexed || braces_balanced(&tokens) || last == doc->region_count - 1) break;
+        free_token_list(&tokens);
+        last++;
+        settle(doc, last + 1);
+    }
+
+    // Regions after the damage keep their subtrees and only move.
+    int no_kinds[DECL_KINDS] = {0};
+    add_shift(doc, last + 1, delta, line_delta, no_kinds);
+
+    int count = 0;
+    DeclRegion* fresh = NULL;
+    if (!lexed || !split_regions(doc, tokens, start, end - start, line, &fresh, &count)) {
+        keep_stale(doc, first, last, start, end);
+        return false;
+    }
+    doc->stale_first = 0;
+    doc->stale_last = -1;
+
+    patch_program(doc, first, last, fresh, count);
+    int kind_delta[DECL_KINDS] = {0};
+    for (int i = first; i <= last; i++) {
+        kind_delta[doc->regions[i].decl.kind]--;
+    }
+    for (int i = 0; i < count; i++) {
+        kind_delta[fresh[i].decl.kind]++;
+    }
+
+    if (count == 0) {
+        // Only whitespace or comments are left: hand them to a neighbour.
+        if (first > 0) {
+            doc->regions[first - 1].length += end - start;
+        } else if (last + 1 < doc->region_count) {
+            settle(doc, last + 2);
+            DeclRegion* next = &doc->regions[last + 1];
+            next->length += next->start - start;
+            next->start = start;
+            next->line = line;
+        }
+    }
+
+    replace_regions(doc, first, last, fresh, count);
+    free(fresh);
+    add_shift(doc, first + count, 0, 0, kind_delta);
+
+    return check_one_game(doc);
+}
+
+void incremental_close(IncrementalDoc* doc) {
+    for (int i = 0; i < doc->region_count; i++) {
+        free_region(&doc->regions[i]);
+    }
+    free(doc->regions);
+    free(doc->program.statements);
+    free(doc->program.entities);
+    free(doc->program.imports);
+    free(doc->source);
+    doc->regions = NULL;
+    doc->region_count = 0;
+    doc->region_capacity = 0;
+    doc->source = NULL;
+    doc->length = 0;
+}
@@ -0,0 +1,72 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include "parser.h"
+#include "token.h"
+
+// Kinds of top-level declaration, for the per-kind counts below.
+#define DECL_KINDS (DECL_IMPORT + 1)
+
+// A slice of the document holding exactly one top-level declaration plus the
+// whitespace/comments that follow it, up to the next declaration.
+typedef struct {
+    int start;        // byte offset of the region in the document
+    int length;
+    int line;         // line the region starts on
+    int line_base;    // add to the lines stored in this region's tokens and AST
+    int before[DECL_KINDS]; // declarations of each kind in earlier regions
+    TokenList tokens; // owned; the AST borrows lexemes from these tokens
+    TopLevelDecl decl;
+} DeclRegion;
+
+// Editor-facing document that keeps the parsed Program in sync with text edits.
+// An edit only relexes and reparses the regions it touches and patches their
+// entries in `program`; every other declaration subtree is reused untouched.
+//
+// Lines stored in a region's tokens and AST nodes are relative to the text it
+// was lexed with, so an edit that adds or removes lines never rewrites them:
+// incremental_line() turns one into a document line. Moving the regions after
+// an edit is lazy too. Regions from shift_from on still owe the pending shift,
+// so read them through incremental_region() rather than `regions` directly.
+typedef struct {
+    char* source;
+    int length;
+    int capacity;
+
+    DeclRegion* regions;
+    int region_count;
+    int region_capacity;
+
+    int shift_from;
+    int shift_offset;
+    int shift_lines;
+    int shift_before[DECL_KINDS];
+
+    Program program; // views into the regions, in region order
+    int game_count;  // game blocks in the regions; more than one is an error
+
+    // When the text stops parsing, `program` keeps the last good parse and
+    // regions stale_first..stale_last (empty if stale_last < stale_first)
+    // hold the text that failed. The next edit reparses them along with
+    // whatever it touches.
+    bool has_error;
+    char error_message[512];
+    int stale_first;
+    int stale_last;
+} IncrementalDoc;
+
+// Neither exits on a syntax or type error: the document stays usable and
+// has_error/error_message say what went wrong. incremental_edit returns
+// false in that case.
+IncrementalDoc incremental_open(const char* source);
+bool incremental_edit(IncrementalDoc* doc, int offset, int deleted, const char* inserted);
+void incremental_close(IncrementalDoc* doc);
+
+// Region `index` with any pending shift applied.
+DeclRegion incremental_region(IncrementalDoc* doc, int index);
+// Index of the region holding document offset `offset`.
+int incremental_region_at(IncrementalDoc* doc, int offset);
+// Document line of `line` as stored in region `index`'s tokens or AST.
+int incremental_line(IncrementalDoc* doc, int index, int line);
+
+#endif
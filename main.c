@@ -1,30 +1,47 @@
 // https://craftinginterpreters.com/scanning.html
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "scanner.h"
 #include "parser.h"
 #include "token.h"
 #include "error.h"
 #include "entity_ast.h"
 #include "printer.h"
 #include "codegen.h"
+#include "module.h"
+#include "build.h"
+#include <sys/stat.h>
+#include <unistd.h>
 
 static char* output_dir = NULL;
+static char* cache_dir = NULL;
+static CodeGenOptions codegen_options;
+static ProfileData profile_use;
+
+int run_file(char* script) {
+    if (cache_dir) mkdir(cache_dir, 0755);
 
-int run(char* source) {
-    Scanner scanner = scanner_create(source);
-    TokenList tokens = scan_tokens(&scanner);
+    ModuleGraph graph = module_graph_load(script, cache_dir);
 
-    printf("=== TOKENS ===\n");
-    for (int i = 0; i < tokens.count; i++) {
-        printf("%s\n", token_to_string(tokens.data[i]));
+    printf("=== MODULES ===\n");
+    for (int i = 0; i < graph.count; i++) {
+        printf("%s%s\n", graph.modules[i].path, graph.modules[i].from_cache ? " (cached)" : "");
     }
     printf("\n");
 
-    Parser parser = parser_create(tokens);
-    Program program = parse(&parser);
+    Module* root = &graph.modules[0];
+    if (root->tokens.data) {
+        printf("=== TOKENS ===\n");
+        for (int i = 0; i < root->tokens.count; i++) {
+            printf("%s\n", token_to_string(root->tokens.data[i]));
+        }
+        printf("\n");
+    }
+
+    Program program = module_graph_link(&graph);
 
     printf("=== AST ===\n");
     print_program(program.statements, program.count);
@@ -39,6 +56,7 @@ int run(char* source) {
 
     printf("=== GENERATED C CODE ===\n");
     CodeGen codegen = codegen_create();
+    codegen.options = codegen_options;
     codegen_generate_program(&codegen, &program);
     printf("%s\n", codegen.header_output);
     printf("%s\n", codegen.source_output);
@@ -52,56 +70,99 @@ int run(char* source) {
     codegen_write_files(&codegen, header_path, source_path);
     codegen_free(&codegen);
 
-    free_token_list(&tokens);
-    free_program(&program);
+    free_linked_program(&program);
+    module_graph_free(&graph);
 
     return 0;
 }
 
-char* read_all_bytes(char* script) {
-    FILE* file = fopen(script, "rb");
-
-    if (!file) {
-        error(error_messages[ERROR_FILELOAD].message);
-    }
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    char* file_content_buffer = malloc( file_size + 1); // null terminator
-
-    //malloc can fail so
-    if (!file_content_buffer) {
-        fclose(file);
-        error(error_messages[ERROR_MALLOCFAIL].message);
-    }
-
-    size_t bytes_read = fread(file_content_buffer, 1, file_size, file);
-    file_content_buffer[bytes_read] = '\0';
-
-    fclose(file);
-    return file_content_buffer;
-}
-
-int run_file(char* script) {
-    char* file_contents = read_all_bytes(script);
-
-    run(file_contents);
-    free(file_contents);
-
-    return 0;
+static void usage(void) {
+    fprintf(stderr, "Usage: whisker [options] <file.wsk> [output_dir]\n");
+    fprintf(stderr, "       whisker build [options] <dir>\n");
+    fprintf(stderr, "  output_dir defaults to ../RatGameC/src/\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --cache <dir>   reuse parsed scripts from <dir>, keyed by source hash\n");
+    fprintf(stderr, "  --line-directives\n");
+    fprintf(stderr, "                  emit #line so debuggers and profilers point at the .wsk source\n");
+    fprintf(stderr, "  --profile       count calls and cycles per entity hook (see game_profile_dump)\n");
+    fprintf(stderr, "  --trace         record frame timeline events (see game_trace_write)\n");
+    fprintf(stderr, "  --profile-use <file>\n");
+    fprintf(stderr, "                  order dispatch and hint branches from a game_profile_dump file\n");
+    fprintf(stderr, "  --strict-float  warn where hook code would still fall back to double math\n");
+    fprintf(stderr, "  --parallel      run self-contained on_update hooks on a pthread pool\n");
+    fprintf(stderr, "  --spawn-blob    load game-block spawns from game_spawns.bin at startup\n");
+    fprintf(stderr, "  --bake          evaluate the game block at transpile time into a const image\n");
+    fprintf(stderr, "Build options:\n");
+    fprintf(stderr, "  -j <n>          transpile with n threads (default: one per CPU)\n");
+    fprintf(stderr, "  -o <dir>        write outputs under <dir> instead of next to each script\n");
 }
 
 int main(int argc, char** argv) {
-    if (argc < 2 || argc > 3) {
-        fprintf(stderr, "Usage: whisker <file.wsk> [output_dir]\n");
-        fprintf(stderr, "  output_dir defaults to ../RatGameC/src/\n");
+    char* positional[2];
+    int positional_count = 0;
+    bool build = argc > 1 && strcmp(argv[1], "build") == 0;
+    int jobs = 0;
+    char* build_output_dir = NULL;
+    codegen_options = codegen_default_options();
+
+    for (int i = build ? 2 : 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cache_dir = argv[++i];
+        } else if (strcmp(argv[i], "--line-directives") == 0) {
+            codegen_options.line_directives = true;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            codegen_options.profile = true;
+        } else if (strcmp(argv[i], "--trace") == 0) {
+            codegen_options.trace = true;
+        } else if (strcmp(argv[i], "--strict-float") == 0) {
+            codegen_options.strict_float = true;
+        } else if (strcmp(argv[i], "--parallel") == 0) {
+            codegen_options.parallel = true;
+        } else if (strcmp(argv[i], "--spawn-blob") == 0) {
+            codegen_options.spawn_blob = true;
+        } else if (strcmp(argv[i], "--bake") == 0) {
+            codegen_options.bake = true;
+        } else if (strcmp(argv[i], "--profile-use") == 0 && i + 1 < argc) {
+            profile_use = profile_data_load(argv[++i]);
+            codegen_options.profile_use = &profile_use;
+        } else if (build && strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+        } else if (build && strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            build_output_dir = argv[++i];
+        } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            usage();
+            return 1;
+        } else if (positional_count < 2) {
+            positional[positional_count++] = argv[i];
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    if (positional_count < 1 || (build && positional_count > 1)) {
+        usage();
         return 1;
     }
 
+    if (build) {
+        BuildOptions options = {0};
+        options.root_dir = positional[0];
+        options.output_dir = build_output_dir;
+        options.cache_dir = cache_dir;
+        options.jobs = jobs > 0 ? jobs : (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (options.jobs < 1) options.jobs = 1;
+        options.codegen = codegen_options;
+        int result = build_directory(&options);
+        profile_data_free(&profile_use);
+        return result;
+    }
+
     // Set output directory
-    output_dir = (argc == 3) ? argv[2] : "../RatGameC/src";
+    output_dir = (positional_count == 2) ? positional[1] : "../RatGameC/src";
 
-    run_file(argv[1]);
+    run_file(positional[0]);
+    profile_data_free(&profile_use);
 
     printf("Exited with no errors.");
     return 0;
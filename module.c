@@ -0,0 +1,201 @@
+#define _XOPEN_SOURCE 700
+
+#include "module.h"
+#include "ast_cache.h"
+#include "effects.h"
+#include "entity_ast.h"
+#include "error.h"
+#include "optimize.h"
+#include "scanner.h"
+#include "typecheck.h"
+#include "utils.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+static int find_module(ModuleGraph* graph, const char* path) {
+    for (int i = 0; i < graph->count; i++) {
+        if (strcmp(graph->modules[i].path, path) == 0) return i;
+    }
+    return -1;
+}
+
+// Imports are relative to the directory of the importing module.
+static char* resolve_import(const char* importer, Token import) {
+    const char* relative = import.literal.as.string;
+    char joined[PATH_MAX];
+
+    const char* slash = strrchr(importer, '/');
+    if (relative[0] == '/' || !slash) {
+        snprintf(joined, sizeof(joined), "%s", relative);
+    } else {
+        snprintf(joined, sizeof(joined), "%.*s/%s", (int)(slash - importer), importer, relative);
+    }
+
+    char* resolved = realpath(joined, NULL);
+    if (!resolved) error_at_token(import, "Cannot open imported module.");
+    return resolved;
+}
+
+static int load_module(ModuleGraph* graph, char* path) {
+    int existing = find_module(graph, path);
+    if (existing >= 0) {
+        free(path);
+        return existing;
+    }
+
+    if (graph->count >= graph->capacity) {
+        graph->capacity = graph->capacity == 0 ? 4 : graph->capacity * 2;
+        Module* new_modules = realloc(graph->modules, sizeof(Module) * graph->capacity);
+        if (!new_modules) error(error_messages[ERROR_REALLOCFAIL].message);
+        graph->modules = new_modules;
+    }
+
+    int index = graph->count++;
+    Module* module = &graph->modules[index];
+    memset(module, 0, sizeof(Module));
+    module->path = path;
+    module->source = read_all_bytes(path);
+    module->source_hash = hash_bytes(module->source, strlen(module->source));
+
+    char cache_path[PATH_MAX];
+    if (graph->cache_dir) {
+        ast_cache_path(cache_path, sizeof(cache_path), graph->cache_dir, module->source_hash);
+    }
+
+    if (graph->cache_dir && ast_cache_load(cache_path, module->source_hash, &module->program)) {
+        module->from_cache = true;
+        graph->cache_hits++;
+    } else {
+        Scanner scanner = scanner_create(module->source);
+        module->tokens = scan_tokens(&scanner);
+        Parser parser = parser_create(module->tokens);
+        module->program = parse(&parser);
+        typecheck_program(&module->program);
+        optimize_program(&module->program);
+        effects_analyze_program(&module->program);
+
+        if (graph->cache_dir) {
+            ast_cache_store(cache_path, module->source_hash, &module->program);
+        }
+    }
+
+    for (int i = 0; i < module->program.entity_count; i++) {
+        module->program.entities[i]->path = module->path;
+    }
+
+    // Loading imports may move graph->modules, so only keep the index around.
+    int import_count = module->program.import_count;
+    int* deps = malloc(sizeof(int) * (import_count + 1));
+    if (!deps) error(error_messages[ERROR_MALLOCFAIL].message);
+
+    for (int i = 0; i < import_count; i++) {
+        Token import = graph->modules[index].program.imports[i];
+        deps[i] = load_module(graph, resolve_import(graph->modules[index].path, import));
+    }
+
+    graph->modules[index].deps = deps;
+    graph->modules[index].dep_count = import_count;
+    return index;
+}
+
+ModuleGraph module_graph_load(const char* root_path, const char* cache_dir) {
+    ModuleGraph graph = {0};
+    graph.cache_dir = cache_dir;
+
+    char* path = realpath(root_path, NULL);
+    if (!path) error(error_messages[ERROR_FILELOAD].message);
+
+    load_module(&graph, path);
+    return graph;
+}
+
+// Imported modules come before the modules that import them.
+static void link_order(ModuleGraph* graph, int index, bool* visited, int* order, int* count) {
+    if (visited[index]) return;
+    visited[index] = true;
+
+    for (int i = 0; i < graph->modules[index].dep_count; i++) {
+        link_order(graph, graph->modules[index].deps[i], visited, order, count);
+    }
+    order[(*count)++] = index;
+}
+
+Program module_graph_link(ModuleGraph* graph) {
+    bool* visited = calloc(graph->count + 1, sizeof(bool));
+    int* order = malloc(sizeof(int) * (graph->count + 1));
+    if (!visited || !order) error(error_messages[ERROR_MALLOCFAIL].message);
+
+    int count = 0;
+    if (graph->count > 0) link_order(graph, 0, visited, order, &count);
+
+    int stmt_total = 0;
+    int entity_total = 0;
+    for (int i = 0; i < count; i++) {
+        stmt_total += graph->modules[order[i]].program.count;
+        entity_total += graph->modules[order[i]].program.entity_count;
+    }
+
+    Program linked = {0};
+    linked.statements = malloc(sizeof(Stmt*) * (stmt_total + 1));
+    linked.entities = malloc(sizeof(EntityDecl*) * (entity_total + 1));
+    if (!linked.statements || !linked.entities) error(error_messages[ERROR_MALLOCFAIL].message);
+
+    for (int i = 0; i < count; i++) {
+        Program* prog = &graph->modules[order[i]].program;
+
+        for (int j = 0; j < prog->count; j++) {
+            linked.statements[linked.count++] = prog->statements[j];
+        }
+
+        for (int j = 0; j < prog->entity_count; j++) {
+            EntityDecl* entity = prog->entities[j];
+            for (int k = 0; k < linked.entity_count; k++) {
+                if (strcmp(linked.entities[k]->name.lexeme, entity->name.lexeme) == 0) {
+                    error_at_token(entity->name, "Entity is already defined in another module.");
+                }
+            }
+            linked.entities[linked.entity_count++] = entity;
+        }
+
+        if (prog->game) {
+            if (linked.game) error("Only one 'game' block allowed across modules.");
+            linked.game = prog->game;
+        }
+    }
+
+    free(visited);
+    free(order);
+    return linked;
+}
+
+// The linked program only borrows nodes from the modules.
+void free_linked_program(Program* linked) {
+    free(linked->statements);
+    free(linked->entities);
+    linked->statements = NULL;
+    linked->entities = NULL;
+    linked->count = 0;
+    linked->entity_count = 0;
+    linked->game = NULL;
+}
+
+void module_graph_free(ModuleGraph* graph) {
+    for (int i = 0; i < graph->count; i++) {
+        Module* module = &graph->modules[i];
+        free_program(&module->program);
+        if (module->tokens.data) free_token_list(&module->tokens);
+        free(module->source);
+        free(module->path);
+        free(module->deps);
+    }
+    free(graph->modules);
+    graph->modules = NULL;
+    graph->count = 0;
+    graph->capacity = 0;
+}
@@ -0,0 +1,35 @@
+#ifndef MODULE_H
+#define MODULE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "parser.h"
+#include "token.h"
+
+// One .wsk file of a project. Each module owns its tokens and AST (or the
+// mapped cache image) and is parsed at most once per graph.
+typedef struct {
+    char* path;          // canonical path
+    char* source;
+    uint64_t source_hash;
+    TokenList tokens;    // empty when the program came from the AST cache
+    Program program;
+    bool from_cache;
+    int* deps;           // indices of imported modules
+    int dep_count;
+} Module;
+
+typedef struct {
+    Module* modules;
+    int count;
+    int capacity;
+    const char* cache_dir; // nullable: no on-disk parse cache
+    int cache_hits;
+} ModuleGraph;
+
+ModuleGraph module_graph_load(const char* root_path, const char* cache_dir);
+Program module_graph_link(ModuleGraph* graph);
+void free_linked_program(Program* linked);
+void module_graph_free(ModuleGraph* graph);
+
+#endif
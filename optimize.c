@@ -0,0 +1,420 @@
+#include "optimize.h"
+#include <limits.h>
+#include <stdlib.h>
+
+static Expr* fold_expr(Expr* expr);
+
+static bool is_number(Expr* expr) {
+    return expr->type == EXPR_LITERAL && expr->as.literal.value.type == LITERAL_NUMBER;
+}
+
+static bool is_number_value(Expr* expr, double value) {
+    return is_number(expr) && expr->as.literal.value.as.number == value;
+}
+
+static bool is_boolean(Expr* expr) {
+    return expr->type == EXPR_LITERAL && expr->as.literal.value.type == LITERAL_BOOLEAN;
+}
+
+static bool is_integral(FieldType type) {
+    return type == TYPE_INT || type == TYPE_UINT32;
+}
+
+static Expr* make_number(double value, FieldType type) {
+    Literal literal = {.type = LITERAL_NUMBER, .as.number = value};
+    Expr* expr = expr_literal(literal);
+    expr->as.literal.integer = type != TYPE_FLOAT;
+    expr->value_type = type;
+    return expr;
+}
+
+static Expr* make_boolean(bool value) {
+    Literal literal = {.type = LITERAL_BOOLEAN, .as.boolean = value};
+    Expr* expr = expr_literal(literal);
+    expr->value_type = TYPE_BOOL;
+    return expr;
+}
+
+// Frees expr except for the child in `slot`, which takes its place.
+static Expr* keep_child(Expr* expr, Expr** slot) {
+    Expr* child = *slot;
+    *slot = NULL;
+    expr_free(expr);
+    return child;
+}
+
+static Expr* replace(Expr* expr, Expr* with) {
+    expr_free(expr);
+    return with;
+}
+
+// No calls and no assignments: dropping it changes nothing.
+static bool is_pure(Expr* expr) {
+    switch (expr->type) {
+        case EXPR_LITERAL:
+        case EXPR_VARIABLE:
+            return true;
+        case EXPR_GROUPING:
+            return is_pure(expr->as.grouping.expression);
+        case EXPR_UNARY:
+            return is_pure(expr->as.unary.right);
+        case EXPR_BINARY:
+            return is_pure(expr->as.binary.left) && is_pure(expr->as.binary.right);
+        case EXPR_GET:
+            return is_pure(expr->as.get.object);
+        default:
+            return false;
+    }
+}
+
+// 1/x is exact only for powers of two.
+static bool is_power_of_two(double value) {
+    if (value < 0) value = -value;
+    if (value == 0 || value > 1e30 || value < 1e-30) return false;
+    while (value >= 2) value /= 2;
+    while (value < 1) value *= 2;
+    return value == 1;
+}
+
+static Expr* fold_arithmetic(Expr* expr, TokenType op, double a, double b) {
+    if (expr->value_type == TYPE_INT) {
+        long long x = (long long)a;
+        long long y = (long long)b;
+        long long result;
+        switch (op) {
+            case TOKEN_PLUS: result = x + y; break;
+            case TOKEN_MINUS: result = x - y; break;
+            case TOKEN_STAR: result = x * y; break;
+            case TOKEN_SLASH:
+                if (y == 0) return expr;
+                result = x / y;
+                break;
+            default: return expr;
+        }
+        if (result < INT_MIN || result > INT_MAX) return expr;
+        return replace(expr, make_number((double)result, TYPE_INT));
+    }
+
+    if (expr->value_type == TYPE_FLOAT) {
+        // Single precision, the way the generated C would compute it.
+        float x = (float)a;
+        float y = (float)b;
+        float result;
+        switch (op) {
+            case TOKEN_PLUS: result = x + y; break;
+            case TOKEN_MINUS: result = x - y; break;
+            case TOKEN_STAR: result = x * y; break;
+            case TOKEN_SLASH:
+                if (y == 0) return expr;
+                result = x / y;
+                break;
+            default: return expr;
+        }
+        return replace(expr, make_number(result, TYPE_FLOAT));
+    }
+
+    return expr;
+}
+
+static Expr* fold_comparison(Expr* expr, TokenType op, double a, double b) {
+    if (expr->as.binary.left->value_type == TYPE_FLOAT || expr->as.binary.right->value_type == TYPE_FLOAT) {
+        a = (float)a;
+        b = (float)b;
+    }
+
+    bool result;
+    switch (op) {
+        case TOKEN_GREATER: result = a > b; break;
+        case TOKEN_GREATER_EQUAL: result = a >= b; break;
+        case TOKEN_LESS: result = a < b; break;
+        case TOKEN_LESS_EQUAL: result = a <= b; break;
+        case TOKEN_EQUAL_EQUAL: result = a == b; break;
+        case TOKEN_BANG_EQUAL: result = a != b; break;
+        default: return expr;
+    }
+    return replace(expr, make_boolean(result));
+}
+
+static Expr* fold_logical(Expr* expr, TokenType op) {
+    Expr* left = expr->as.binary.left;
+    Expr* right = expr->as.binary.right;
+
+    if (is_boolean(left) && is_boolean(right)) {
+        bool a = left->as.literal.value.as.boolean;
+        bool b = right->as.literal.value.as.boolean;
+        switch (op) {
+            case TOKEN_AND: return replace(expr, make_boolean(a && b));
+            case TOKEN_OR: return replace(expr, make_boolean(a || b));
+            case TOKEN_EQUAL_EQUAL: return replace(expr, make_boolean(a == b));
+            case TOKEN_BANG_EQUAL: return replace(expr, make_boolean(a != b));
+            default: return expr;
+        }
+    }
+
+    // The right side of a short-circuited and/or never runs anyway.
+    if (is_boolean(left) && (op == TOKEN_AND || op == TOKEN_OR)) {
+        bool a = left->as.literal.value.as.boolean;
+        if (op == TOKEN_AND && !a) return replace(expr, make_boolean(false));
+        if (op == TOKEN_OR && a) return replace(expr, make_boolean(true));
+        if (right->value_type == TYPE_BOOL) return keep_child(expr, &expr->as.binary.right);
+    }
+
+    return expr;
+}
+
+static Expr* fold_binary(Expr* expr) {
+    expr->as.binary.left = fold_expr(expr->as.binary.left);
+    expr->as.binary.right = fold_expr(expr->as.binary.right);
+
+    Expr* left = expr->as.binary.left;
+    Expr* right = expr->as.binary.right;
+    TokenType op = expr->as.binary.oprt.type;
+    FieldType type = expr->value_type;
+    bool arithmetic = op == TOKEN_PLUS || op == TOKEN_MINUS || op == TOKEN_STAR || op == TOKEN_SLASH;
+
+    if (is_number(left) && is_number(right)) {
+        double a = left->as.literal.value.as.number;
+        double b = right->as.literal.value.as.number;
+        return arithmetic ? fold_arithmetic(expr, op, a, b) : fold_comparison(expr, op, a, b);
+    }
+
+    // A folded int next to a float is a float literal too, as in typecheck.
+    FieldType operands = arithmetic ? type : left->value_type == TYPE_FLOAT ? TYPE_FLOAT : right->value_type;
+    if (operands == TYPE_FLOAT) {
+        if (is_number(left)) left->value_type = TYPE_FLOAT;
+        if (is_number(right)) right->value_type = TYPE_FLOAT;
+    }
+
+    if (!arithmetic) return fold_logical(expr, op);
+    if (type != TYPE_FLOAT && !is_integral(type)) return expr;
+
+    // Identities. The operand that stays must already have the result's type,
+    // or `i * 1.0` would turn back into integer math.
+    if ((op == TOKEN_STAR || op == TOKEN_SLASH) && is_number_value(right, 1) && left->value_type == type) {
+        return keep_child(expr, &expr->as.binary.left);
+    }
+    if (op == TOKEN_STAR && is_number_value(left, 1) && right->value_type == type) {
+        return keep_child(expr, &expr->as.binary.right);
+    }
+    // x + 0 is not x for a float -0.0; x - 0 always is.
+    if ((op == TOKEN_MINUS || (op == TOKEN_PLUS && type != TYPE_FLOAT)) &&
+        is_number_value(right, 0) && left->value_type == type) {
+        return keep_child(expr, &expr->as.binary.left);
+    }
+    if (op == TOKEN_PLUS && type != TYPE_FLOAT && is_number_value(left, 0) && right->value_type == type) {
+        return keep_child(expr, &expr->as.binary.right);
+    }
+    // x * 0 is not 0 for a float NaN or infinity.
+    if (op == TOKEN_STAR && is_integral(type) &&
+        ((is_number_value(left, 0) && is_pure(right)) || (is_number_value(right, 0) && is_pure(left)))) {
+        return replace(expr, make_number(0, type));
+    }
+
+    // x / 4.0f is exactly x * 0.25f.
+    if (op == TOKEN_SLASH && type == TYPE_FLOAT && is_number(right) &&
+        right->value_type == TYPE_FLOAT && is_power_of_two(right->as.literal.value.as.number)) {
+        right->as.literal.value.as.number = 1.0 / right->as.literal.value.as.number;
+        expr->as.binary.oprt.type = TOKEN_STAR;
+        expr->as.binary.oprt.lexeme = "*";
+    }
+
+    return expr;
+}
+
+static Expr* fold_unary(Expr* expr) {
+    expr->as.unary.right = fold_expr(expr->as.unary.right);
+    Expr* right = expr->as.unary.right;
+
+    // -(-x) and !(!x) are parsed with the inner operator in parentheses.
+    Expr* inner = right->type == EXPR_GROUPING ? right->as.grouping.expression : right;
+    bool doubled = inner->type == EXPR_UNARY && inner->as.unary.oprt.type == expr->as.unary.oprt.type;
+
+    if (expr->as.unary.oprt.type == TOKEN_MINUS) {
+        if (is_number(right)) {
+            right->as.literal.value.as.number = -right->as.literal.value.as.number;
+            return keep_child(expr, &expr->as.unary.right);
+        }
+        if (doubled && inner->as.unary.right->value_type == expr->value_type) {
+            return keep_child(expr, &inner->as.unary.right);
+        }
+    } else if (expr->as.unary.oprt.type == TOKEN_BANG) {
+        if (is_boolean(right)) {
+            return replace(expr, make_boolean(!right->as.literal.value.as.boolean));
+        }
+        // !!x, when x is already a bool
+        if (doubled && inner->as.unary.right->value_type == TYPE_BOOL) {
+            return keep_child(expr, &inner->as.unary.right);
+        }
+    }
+
+    return expr;
+}
+
+static Expr* fold_expr(Expr* expr) {
+    if (!expr) return NULL;
+
+    switch (expr->type) {
+        case EXPR_BINARY:
+            return fold_binary(expr);
+
+        case EXPR_UNARY:
+            return fold_unary(expr);
+
+        case EXPR_GROUPING: {
+            expr->as.grouping.expression = fold_expr(expr->as.grouping.expression);
+            // Parentheses around a single operand are noise.
+            ExprType inner = expr->as.grouping.expression->type;
+            if (inner == EXPR_LITERAL || inner == EXPR_VARIABLE || inner == EXPR_GET ||
+                inner == EXPR_CALL || inner == EXPR_GROUPING) {
+                return keep_child(expr, &expr->as.grouping.expression);
+            }
+            return expr;
+        }
+
+        case EXPR_ASSIGN:
+            expr->as.assign.value = fold_expr(expr->as.assign.value);
+            return expr;
+
+        case EXPR_GET:
+            expr->as.get.object = fold_expr(expr->as.get.object);
+            return expr;
+
+        case EXPR_SET:
+            expr->as.set.object = fold_expr(expr->as.set.object);
+            expr->as.set.value = fold_expr(expr->as.set.value);
+            return expr;
+
+        case EXPR_CALL:
+            for (int i = 0; i < expr->as.call.argc; i++) {
+                expr->as.call.argv[i] = fold_expr(expr->as.call.argv[i]);
+            }
+            return expr;
+
+        case EXPR_LITERAL:
+        case EXPR_VARIABLE:
+            return expr;
+    }
+
+    return expr;
+}
+
+static void optimize_stmt(Stmt* stmt) {
+    if (!stmt) return;
+
+    switch (stmt->type) {
+        case STMT_EXPRESSION:
+            stmt->as.expr.expr = fold_expr(stmt->as.expr.expr);
+            break;
+        case STMT_PRINT:
+            stmt->as.print.expr = fold_expr(stmt->as.print.expr);
+            break;
+        case STMT_VAR:
+            stmt->as.var.initializer = fold_expr(stmt->as.var.initializer);
+            break;
+        case STMT_BLOCK:
+            for (int i = 0; i < stmt->as.block.count; i++) {
+                optimize_stmt(stmt->as.block.statements[i]);
+            }
+            break;
+        case STMT_IF:
+            stmt->as.if_stmt.condition = fold_expr(stmt->as.if_stmt.condition);
+            optimize_stmt(stmt->as.if_stmt.then_branch);
+            optimize_stmt(stmt->as.if_stmt.else_branch);
+            break;
+        case STMT_WHILE:
+            stmt->as.while_stmt.condition = fold_expr(stmt->as.while_stmt.condition);
+            optimize_stmt(stmt->as.while_stmt.body);
+            break;
+    }
+}
+
+static bool is_boolean_value(Expr* expr, bool value) {
+    return is_boolean(expr) && expr->as.literal.value.as.boolean == value;
+}
+
+// Replaces stmt by one of its branches: detaches `keep` and frees the rest.
+static Stmt* keep_branch(Stmt* stmt, Stmt** slot) {
+    Stmt* branch = *slot;
+    *slot = NULL;
+    stmt_free(stmt);
+    return branch;
+}
+
+// Drops what can never run or has no effect. Returns NULL when nothing of
+// stmt is left.
+static Stmt* prune_stmt(Stmt* stmt) {
+    if (!stmt) return NULL;
+
+    switch (stmt->type) {
+        case STMT_EXPRESSION:
+            if (is_pure(stmt->as.expr.expr)) {
+                stmt_free(stmt);
+                return NULL;
+            }
+            return stmt;
+
+        case STMT_BLOCK: {
+            int count = 0;
+            for (int i = 0; i < stmt->as.block.count; i++) {
+                Stmt* kept = prune_stmt(stmt->as.block.statements[i]);
+                if (kept) stmt->as.block.statements[count++] = kept;
+            }
+            stmt->as.block.count = count;
+            if (count == 0) {
+                stmt_free(stmt);
+                return NULL;
+            }
+            return stmt;
+        }
+
+        case STMT_IF:
+            if (is_boolean_value(stmt->as.if_stmt.condition, true)) {
+                return prune_stmt(keep_branch(stmt, &stmt->as.if_stmt.then_branch));
+            }
+            if (is_boolean_value(stmt->as.if_stmt.condition, false)) {
+                return prune_stmt(keep_branch(stmt, &stmt->as.if_stmt.else_branch));
+            }
+
+            stmt->as.if_stmt.then_branch = prune_stmt(stmt->as.if_stmt.then_branch);
+            stmt->as.if_stmt.else_branch = prune_stmt(stmt->as.if_stmt.else_branch);
+            if (!stmt->as.if_stmt.then_branch && !stmt->as.if_stmt.else_branch &&
+                is_pure(stmt->as.if_stmt.condition)) {
+                stmt_free(stmt);
+                return NULL;
+            }
+            if (!stmt->as.if_stmt.then_branch) stmt->as.if_stmt.then_branch = stmt_block(NULL, 0);
+            return stmt;
+
+        case STMT_WHILE:
+            if (is_boolean_value(stmt->as.while_stmt.condition, false)) {
+                stmt_free(stmt);
+                return NULL;
+            }
+            // An empty loop still spins until its condition changes.
+            stmt->as.while_stmt.body = prune_stmt(stmt->as.while_stmt.body);
+            if (!stmt->as.while_stmt.body) stmt->as.while_stmt.body = stmt_block(NULL, 0);
+            return stmt;
+
+        case STMT_PRINT:
+        case STMT_VAR:
+            return stmt;
+    }
+
+    return stmt;
+}
+
+// A hook with nothing left in it is dropped, so codegen leaves the type out
+// of the per-frame loops and dispatch switches.
+void optimize_entity(EntityDecl* entity) {
+    Stmt** hooks[] = {&entity->on_create, &entity->on_update, &entity->on_destroy, &entity->on_collision};
+    for (int i = 0; i < HOOK_COUNT; i++) {
+        optimize_stmt(*hooks[i]);
+        *hooks[i] = prune_stmt(*hooks[i]);
+    }
+}
+
+void optimize_program(Program* program) {
+    for (int i = 0; i < program->entity_count; i++) {
+        optimize_entity(program->entities[i]);
+    }
+}
@@ -0,0 +1,14 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include "entity_ast.h"
+#include "parser.h"
+
+// Folds constant arithmetic and comparisons in entity hooks, drops identities
+// (x * 1, x + 0 for ints, -(-x)) and turns float division by a power of two
+// into a multiplication, then prunes dead branches, loops and statements.
+// Hooks left empty become NULL. Needs the types from typecheck_program.
+void optimize_program(Program* program);
+void optimize_entity(EntityDecl* entity);
+
+#endif
@@ -1,10 +1,12 @@
 #include "parser.h"
+#include "ast_cache.h"
 #include "entity_ast.h"
 #include "error.h"
 #include "game_ast.h"
 #include "token.h"
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
 Parser parser_create(TokenList tokens) {
     Parser parser = {
@@ -65,6 +67,16 @@ static Token consume(Parser* parser, TokenType type, const char* message) {
     return peek(parser); // unreachable
 }
 
+// Words like `capacity` that only mean something in one place stay plain
+// identifiers everywhere else.
+static bool match_word(Parser* parser, const char* word) {
+    if (check(parser, TOKEN_IDENTIFIER) && strcmp(peek(parser).lexeme, word) == 0) {
+        advance(parser);
+        return true;
+    }
+    return false;
+}
+
 // ========= Grammar Rules ==========
 static Expr* expression(Parser* parser);
 static Expr* assignment(Parser* parser);
@@ -83,7 +95,9 @@ static Stmt* declaration(Parser* parser);
 static Stmt* statement(Parser* parser);
 static Stmt* print_statement(Parser* parser);
 static Stmt* expression_statement(Parser* parser);
-static Stmt* var_declaration(Parser* parser);
+static Stmt* var_declaration(Parser* parser, FieldType type);
+static bool check_type(Parser* parser);
+static FieldType parse_field_type(Parser* parser);
 static Stmt* block_statement(Parser* parser);
 static Stmt* if_statement(Parser* parser);
 static Stmt* while_statement(Parser* parser);
@@ -100,7 +114,9 @@ static Expr* primary(Parser* parser) {
     }
 
     if (match(parser, TOKEN_NUMBER)) {
-        return expr_literal(previous(parser).literal);
+        Expr* expr = expr_literal(previous(parser).literal);
+        expr->as.literal.integer = strchr(previous(parser).lexeme, '.') == NULL;
+        return expr;
     }
     if (match(parser, TOKEN_STRING)) {
         return expr_literal(previous(parser).literal);
@@ -275,12 +291,16 @@ static Expr* assignment(Parser* parser) {
         Expr* value = assignment(parser);
 
         if (expr->type == EXPR_VARIABLE) {
-            Token name = expr->as.variable.name;
+            // expr_assign copies the name, so free the variable afterwards
+            Expr* assign = expr_assign(expr->as.variable.name, value);
             expr_free(expr);
-            return expr_assign(name, value);
+            return assign;
         } else if (expr->type == EXPR_GET) {
             // convert get to set: self.hsp = 5
-            return expr_set(expr->as.get.object, expr->as.get.name, value);
+            Expr* set = expr_set(expr->as.get.object, expr->as.get.name, value);
+            free(expr->as.get.name.lexeme);
+            free(expr);
+            return set;
         }
 
         error_at_token(equals, "Invalid assignment target.");
@@ -345,6 +365,8 @@ static Stmt* while_statement(Parser* parser) {
 }
 
 static Stmt* for_statement(Parser* parser) {
+    // The desugared pieces all map back to the 'for' line.
+    int line = previous(parser).line;
     consume(parser, TOKEN_LEFT_PAREN, "Expect '(' after 'for'.");
 
     // Initializer: var i = 0; OR i = 0; OR nothing
@@ -352,10 +374,15 @@ static Stmt* for_statement(Parser* parser) {
     if (match(parser, TOKEN_SEMICOLON)) {
         initializer = NULL;  // No initializer
     } else if (match(parser, TOKEN_VAR)) {
-        initializer = var_declaration(parser);
+        initializer = var_declaration(parser, TYPE_UNKNOWN);
+    } else if (check_type(parser)) {
+        FieldType type = parse_field_type(parser);
+        initializer = var_declaration(parser, type);
     } else {
         initializer = expression_statement(parser);
+        initializer->as.expr.declares = true;
     }
+    if (initializer) initializer->line = line;
 
     // Condition: i < 10
     Expr* condition = NULL;
@@ -376,6 +403,7 @@ static Stmt* for_statement(Parser* parser) {
     // Desugar: attach increment to end of body
     if (increment) {
         Stmt* inc_stmt = stmt_expression(increment);
+        inc_stmt->line = line;
         Stmt** stmts = malloc(sizeof(Stmt*) * 2);
         stmts[0] = body;
         stmts[1] = inc_stmt;
@@ -389,6 +417,7 @@ static Stmt* for_statement(Parser* parser) {
         condition = expr_literal(lit);
     }
     body = stmt_while(condition, body);
+    body->line = line;
 
     // Desugar: prepend initializer
     if (initializer) {
@@ -401,7 +430,7 @@ static Stmt* for_statement(Parser* parser) {
     return body;
 }
 
-static Stmt* var_declaration(Parser* parser) {
+static Stmt* var_declaration(Parser* parser, FieldType type) {
     Token name = consume(parser, TOKEN_IDENTIFIER, "Expect variable name.");
 
     Expr* initializer = NULL;
@@ -410,7 +439,7 @@ static Stmt* var_declaration(Parser* parser) {
     }
 
     consume(parser, TOKEN_SEMICOLON, "Expect ';' after variable declaration.");
-    return stmt_var(name, initializer);
+    return stmt_var(name, type, initializer);
 }
 
 static Stmt* print_statement(Parser* parser) {
@@ -426,19 +455,40 @@ static Stmt* expression_statement(Parser* parser) {
 }
 
 static Stmt* statement(Parser* parser) {
-    if (match(parser, TOKEN_IF)) return if_statement(parser);
-    if (match(parser, TOKEN_WHILE)) return while_statement(parser);
-    if (match(parser, TOKEN_FOR)) return for_statement(parser);
-    if (match(parser, TOKEN_LEFT_BRACE)) return block_statement(parser);
+    int line = peek(parser).line;
+    Stmt* stmt;
 
-    return expression_statement(parser);
+    if (match(parser, TOKEN_IF)) stmt = if_statement(parser);
+    else if (match(parser, TOKEN_WHILE)) stmt = while_statement(parser);
+    else if (match(parser, TOKEN_FOR)) stmt = for_statement(parser);
+    else if (match(parser, TOKEN_LEFT_BRACE)) stmt = block_statement(parser);
+    else stmt = expression_statement(parser);
+
+    stmt->line = line;
+    return stmt;
 }
 
 static Stmt* declaration(Parser* parser) {
-    if (match(parser, TOKEN_VAR)) return var_declaration(parser);
+    int line = peek(parser).line;
+    if (match(parser, TOKEN_VAR)) {
+        Stmt* stmt = var_declaration(parser, TYPE_UNKNOWN);
+        stmt->line = line;
+        return stmt;
+    }
+    if (check_type(parser)) {
+        FieldType type = parse_field_type(parser);
+        Stmt* stmt = var_declaration(parser, type);
+        stmt->line = line;
+        return stmt;
+    }
     return statement(parser);
 }
 
+static bool check_type(Parser* parser) {
+    return check(parser, TOKEN_FLOAT) || check(parser, TOKEN_INT) ||
+           check(parser, TOKEN_BOOL) || check(parser, TOKEN_UINT32);
+}
+
 static FieldType parse_field_type(Parser* parser) {
     if (match(parser, TOKEN_FLOAT)) return TYPE_FLOAT;
     if (match(parser, TOKEN_INT)) return TYPE_INT;
@@ -449,8 +499,28 @@ static FieldType parse_field_type(Parser* parser) {
     return TYPE_FLOAT; // unreachable
 }
 
+#define MAX_CAPACITY 16777216
+
+// The N of `capacity N;`, after the word itself.
+static int capacity_declaration(Parser* parser, int current) {
+    Token keyword = previous(parser);
+    if (current != 0) error_at_token(keyword, "Capacity is already declared.");
+
+    Token count = consume(parser, TOKEN_NUMBER, "Expect instance count after 'capacity'.");
+    double value = count.literal.as.number;
+    if (value < 1 || value > MAX_CAPACITY || value != (int)value) {
+        error_at_token(count, "Capacity must be a whole number from 1 to 16777216.");
+    }
+    consume(parser, TOKEN_SEMICOLON, "Expect ';' after capacity.");
+    return (int)value;
+}
+
 static EntityDecl* entity_declaration(Parser* parser) {
     Token name = consume(parser, TOKEN_IDENTIFIER, "Expect entity name.");
+    bool pooled = match_word(parser, "pooled");
+    bool singleton = match_word(parser, "singleton");
+    if (singleton && !pooled) pooled = match_word(parser, "pooled");
+    if (pooled && singleton) error_at_token(previous(parser), "An entity cannot be both pooled and a singleton.");
     consume(parser, TOKEN_LEFT_BRACE, "Expect '{' after entity name.");
 
     // Parse fields
@@ -458,6 +528,7 @@ static EntityDecl* entity_declaration(Parser* parser) {
     int field_count = 0;
     EntityField* fields = malloc(sizeof(EntityField) * field_capacity);
     if (!fields) error(error_messages[ERROR_MALLOCFAIL].message);
+    int capacity = 0;
 
     while (!check(parser, TOKEN_RIGHT_BRACE) &&
             !check(parser, TOKEN_INIT) &&
@@ -465,6 +536,11 @@ static EntityDecl* entity_declaration(Parser* parser) {
             !check(parser, TOKEN_ON_UPDATE) &&
             !check(parser, TOKEN_ON_DESTROY) &&
             !is_at_end(parser)) {
+        if (match_word(parser, "capacity")) {
+            capacity = capacity_declaration(parser, capacity);
+            continue;
+        }
+
         if (field_count >= field_capacity) {
             field_capacity *= 2;
             EntityField* new_fields = realloc(fields, sizeof(EntityField) * field_capacity);
@@ -506,10 +582,12 @@ static EntityDecl* entity_declaration(Parser* parser) {
             on_destroy = block_statement(parser);
         } else if (match(parser, TOKEN_ON_COLLISION)) {
             consume(parser, TOKEN_LEFT_PAREN, "Expect '(' after on_collision.");
-            collision_param = consume(parser, TOKEN_IDENTIFIER, "Expect parameter name.");
+            collision_param = token_copy(consume(parser, TOKEN_IDENTIFIER, "Expect parameter name."));
             consume(parser, TOKEN_RIGHT_PAREN, "Expect ')' after parameter.");
             consume(parser, TOKEN_LEFT_BRACE, "Expect '{' after on_collision.");
             on_collision = block_statement(parser);
+        } else if (match_word(parser, "capacity")) {
+            capacity = capacity_declaration(parser, capacity);
         } else {
             error_at_token(peek(parser), "Expect on_create, on_update, or on_destroy.");
         }
@@ -517,7 +595,12 @@ static EntityDecl* entity_declaration(Parser* parser) {
 
     consume(parser, TOKEN_RIGHT_BRACE, "Expect '}' after entity body.");
 
-    return entity_decl_create(token_copy(name), fields, field_count, init, on_create, on_update, on_destroy, on_collision, collision_param);
+    EntityDecl* entity = entity_decl_create(token_copy(name), fields, field_count, init, on_create, on_update, on_destroy, on_collision, collision_param);
+    entity->capacity = capacity;
+    entity->pooled = pooled;
+    entity->singleton = singleton;
+    if (singleton && capacity != 0) error_at_token(name, "A singleton entity cannot declare a capacity.");
+    return entity;
 }
 
 static GameDecl* game_declaration(Parser* parser) {
@@ -527,8 +610,14 @@ static GameDecl* game_declaration(Parser* parser) {
     int count = 0;
     SpawnCall* spawns = malloc(sizeof(SpawnCall) * capacity);
     if (!spawns) error(error_messages[ERROR_MALLOCFAIL].message);
+    int entity_capacity = 0;
 
     while (!check(parser, TOKEN_RIGHT_BRACE) && !is_at_end(parser)) {
+        if (match_word(parser, "capacity")) {
+            entity_capacity = capacity_declaration(parser, entity_capacity);
+            continue;
+        }
+
         consume(parser, TOKEN_SPAWN, "Expect 'spawn' in game block.");
 
         Token entity_name = consume(parser, TOKEN_IDENTIFIER, "Expect entity name after 'spawn'.");
@@ -561,7 +650,35 @@ static GameDecl* game_declaration(Parser* parser) {
     }
 
     consume(parser, TOKEN_RIGHT_BRACE, "Expect '}' after game block.");
-    return game_decl_create(spawns, count);
+    GameDecl* game = game_decl_create(spawns, count);
+    game->capacity = entity_capacity;
+    return game;
+}
+
+bool parser_at_end(Parser* parser) {
+    return is_at_end(parser);
+}
+
+TopLevelDecl parse_top_level(Parser* parser) {
+    TopLevelDecl decl;
+
+    if (match(parser, TOKEN_ENTITY)) {
+        decl.kind = DECL_ENTITY;
+        decl.as.entity = entity_declaration(parser);
+    } else if (match(parser, TOKEN_GAME)) {
+        decl.kind = DECL_GAME;
+        decl.as.game = game_declaration(parser);
+    } else if (match(parser, TOKEN_IMPORT)) {
+        decl.kind = DECL_IMPORT;
+        decl.as.import = token_copy(consume(parser, TOKEN_STRING, "Expect module path after 'import'."));
+        consume(parser, TOKEN_SEMICOLON, "Expect ';' after import.");
+    } else {
+        // Regular statement
+        decl.kind = DECL_STMT;
+        decl.as.stmt = declaration(parser);
+    }
+
+    return decl;
 }
 
 Program parse(Parser* parser) {
@@ -579,9 +696,16 @@ Program parse(Parser* parser) {
         error(error_messages[ERROR_MALLOCFAIL].message);
     }
 
+    int import_capacity = 4;
+    int import_count = 0;
+    Token* imports = malloc(sizeof(Token) * import_capacity);
+    if (!imports) error(error_messages[ERROR_MALLOCFAIL].message);
+
     while (!is_at_end(parser)) {
-        // Check if it's an entity declaration
-        if (match(parser, TOKEN_ENTITY)) {
+        Token start = peek(parser);
+        TopLevelDecl decl = parse_top_level(parser);
+
+        if (decl.kind == DECL_ENTITY) {
             if (entity_count >= entity_capacity) {
                 entity_capacity *= 2;
                 EntityDecl** new_entities = realloc(entities, sizeof(EntityDecl*) * entity_capacity);
@@ -592,12 +716,19 @@ Program parse(Parser* parser) {
                 }
                 entities = new_entities;
             }
-            entities[entity_count++] = entity_declaration(parser);
-        } else if (match(parser, TOKEN_GAME)) {
-            if (game) error_at_token(peek(parser), "Only one 'game' block allowed.");
-            game = game_declaration(parser);
+            entities[entity_count++] = decl.as.entity;
+        } else if (decl.kind == DECL_GAME) {
+            if (game) error_at_token(start, "Only one 'game' block allowed.");
+            game = decl.as.game;
+        } else if (decl.kind == DECL_IMPORT) {
+            if (import_count >= import_capacity) {
+                import_capacity *= 2;
+                Token* new_imports = realloc(imports, sizeof(Token) * import_capacity);
+                if (!new_imports) error(error_messages[ERROR_REALLOCFAIL].message);
+                imports = new_imports;
+            }
+            imports[import_count++] = decl.as.import;
         } else {
-            // Regular statement
             if (stmt_count >= stmt_capacity) {
                 stmt_capacity *= 2;
                 Stmt** new_stmts = realloc(statements, sizeof(Stmt*) * stmt_capacity);
@@ -608,7 +739,7 @@ Program parse(Parser* parser) {
                 }
                 statements = new_stmts;
             }
-            statements[stmt_count++] = declaration(parser);
+            statements[stmt_count++] = decl.as.stmt;
         }
     }
 
@@ -617,12 +748,22 @@ Program parse(Parser* parser) {
         .count = stmt_count,
         .entities = entities,
         .entity_count = entity_count,
-        .game = game //GAME IS GAME
+        .game = game, //GAME IS GAME
+        .imports = imports,
+        .import_count = import_count,
+        .mapped = NULL,
+        .mapped_size = 0
     };
     return prog;
 }
 
 void free_program(Program* prog) {
+    if (prog->mapped) {
+        // Nodes were never allocated one by one, the mapping owns all of them.
+        ast_cache_unmap(prog);
+        return;
+    }
+
     game_decl_free(prog->game);
     for (int i = 0; i < prog->count; i++) {
         stmt_free(prog->statements[i]);
@@ -633,4 +774,10 @@ void free_program(Program* prog) {
         entity_decl_free(prog->entities[i]);
     }
     free(prog->entities);
+
+    for (int i = 0; i < prog->import_count; i++) {
+        free(prog->imports[i].lexeme);
+        free(prog->imports[i].literal.as.string);
+    }
+    free(prog->imports);
 }
@@ -6,6 +6,7 @@
 #include "expr.h"
 #include "stmt.h"
 #include "game_ast.h"
+#include <stddef.h>
 
 typedef struct {
     Token* tokens;
@@ -13,15 +14,41 @@ typedef struct {
     int count;
 } Parser;
 
+typedef enum {
+    DECL_ENTITY,
+    DECL_GAME,
+    DECL_STMT,
+    DECL_IMPORT
+} DeclKind;
+
+// One top-level item of a script: an entity, the game block, an import or a loose statement.
+typedef struct {
+    DeclKind kind;
+    union {
+        EntityDecl* entity;
+        GameDecl* game;
+        Stmt* stmt;
+        Token import; // the path string token, owned
+    } as;
+} TopLevelDecl;
+
 typedef struct {
     Stmt** statements;
     int count;
     EntityDecl** entities;
     int entity_count;
     GameDecl* game; // nullable
+    Token* imports;  // import "path"; directives, in source order
+    int import_count;
+
+    // Set when the whole tree lives inside a mapped AST cache file.
+    void* mapped;
+    size_t mapped_size;
 } Program;
 
 Parser parser_create(TokenList tokens);
+bool parser_at_end(Parser* parser);
+TopLevelDecl parse_top_level(Parser* parser);
 Program parse(Parser* parser);
 void free_program(Program* prog);
 
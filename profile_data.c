@@ -0,0 +1,109 @@
+#include "profile_data.h"
+#include "error.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool parse_hook(const char* name, HookKind* out) {
+    for (int i = 0; i < HOOK_COUNT; i++) {
+        if (strcmp(name, hook_kind_name((HookKind)i)) == 0) {
+            *out = (HookKind)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void* grow(void* data, int count, int* capacity, size_t size) {
+    if (count < *capacity) return data;
+    *capacity = *capacity == 0 ? 8 : *capacity * 2;
+    void* new_data = realloc(data, size * *capacity);
+    if (!new_data) error(error_messages[ERROR_REALLOCFAIL].message);
+    return new_data;
+}
+
+ProfileData profile_data_load(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) error("Cannot open profile file.");
+
+    ProfileData data = {0};
+    int type_capacity = 0;
+    int hook_capacity = 0;
+    int branch_capacity = 0;
+
+    char line[512];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_number++;
+        char type[256];
+        char hook_name[32];
+        unsigned long long a;
+        unsigned long long b;
+        int ordinal;
+        int source_line;
+        HookKind hook;
+
+        if (line_number == 1) {
+            int version;
+            if (sscanf(line, "whisker-profile %d", &version) != 1 || version != 2) {
+                error("Not a whisker profile (expected 'whisker-profile 2'); record it again with this version.");
+            }
+        } else if (sscanf(line, "type %255s instances %llu peak %llu", type, &a, &b) == 3) {
+            data.types = grow(data.types, data.type_count, &type_capacity, sizeof(TypeSample));
+            data.types[data.type_count++] = (TypeSample){my_strndup(type, strlen(type)), a, b};
+        } else if (sscanf(line, "hook %255s %31s calls %llu cycles %llu", type, hook_name, &a, &b) == 4 &&
+                   parse_hook(hook_name, &hook)) {
+            data.hooks = grow(data.hooks, data.hook_count, &hook_capacity, sizeof(HookSample));
+            data.hooks[data.hook_count++] = (HookSample){my_strndup(type, strlen(type)), hook, a, b};
+        } else if (sscanf(line, "branch %255s %31s %d line %d taken %llu total %llu",
+                          type, hook_name, &ordinal, &source_line, &a, &b) == 6 &&
+                   parse_hook(hook_name, &hook)) {
+            data.branches = grow(data.branches, data.branch_count, &branch_capacity, sizeof(BranchSample));
+            data.branches[data.branch_count++] = (BranchSample){my_strndup(type, strlen(type)), hook, ordinal, source_line, a, b};
+        } else if (line[0] != '\n' && line[0] != '#') {
+            error_at_line(line_number, "Malformed line in profile file.");
+        }
+    }
+
+    fclose(f);
+    return data;
+}
+
+void profile_data_free(ProfileData* data) {
+    for (int i = 0; i < data->type_count; i++) free(data->types[i].name);
+    for (int i = 0; i < data->hook_count; i++) free(data->hooks[i].type);
+    for (int i = 0; i < data->branch_count; i++) free(data->branches[i].type);
+    free(data->types);
+    free(data->hooks);
+    free(data->branches);
+    *data = (ProfileData){0};
+}
+
+// Most instances of `type` alive at once; 0 if the profile never saw one.
+uint64_t profile_type_peak(ProfileData* data, const char* type) {
+    for (int i = 0; i < data->type_count; i++) {
+        if (strcmp(data->types[i].name, type) == 0) return data->types[i].peak;
+    }
+    return 0;
+}
+
+uint64_t profile_hook_calls(ProfileData* data, const char* type, HookKind hook) {
+    for (int i = 0; i < data->hook_count; i++) {
+        if (data->hooks[i].hook == hook && strcmp(data->hooks[i].type, type) == 0) {
+            return data->hooks[i].calls;
+        }
+    }
+    return 0;
+}
+
+// The sample for a hook's ordinal-th if, unless the script has moved it since.
+BranchSample* profile_branch(ProfileData* data, const char* type, HookKind hook, int ordinal, int line) {
+    for (int i = 0; i < data->branch_count; i++) {
+        BranchSample* branch = &data->branches[i];
+        if (branch->hook == hook && branch->ordinal == ordinal && strcmp(branch->type, type) == 0) {
+            return branch->line == line ? branch : NULL;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,47 @@
+#ifndef PROFILE_DATA_H
+#define PROFILE_DATA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "entity_ast.h"
+
+// A game_profile_dump() file read back for --profile-use.
+typedef struct {
+    char* name;
+    uint64_t instances; // alive when the profile was dumped
+    uint64_t peak;      // most alive at once; 0 if the type never spawned
+} TypeSample;
+
+typedef struct {
+    char* type;
+    HookKind hook;
+    uint64_t calls;
+    uint64_t cycles;
+} HookSample;
+
+typedef struct {
+    char* type;
+    HookKind hook;
+    int ordinal; // which if of the hook, in source order
+    int line;    // where it was, to spot a profile of an older script
+    uint64_t taken;
+    uint64_t total;
+} BranchSample;
+
+typedef struct {
+    TypeSample* types; // every type the profile saw, even with no hook calls
+    int type_count;
+    HookSample* hooks;
+    int hook_count;
+    BranchSample* branches;
+    int branch_count;
+} ProfileData;
+
+ProfileData profile_data_load(const char* path);
+void profile_data_free(ProfileData* data);
+
+uint64_t profile_type_peak(ProfileData* data, const char* type);
+uint64_t profile_hook_calls(ProfileData* data, const char* type, HookKind hook);
+BranchSample* profile_branch(ProfileData* data, const char* type, HookKind hook, int ordinal, int line);
+
+#endif
@@ -22,6 +22,7 @@ static void add_token_literal(Scanner* scanner, TokenType type, Literal literal)
         .type = type,
         .lexeme = text,
         .line = scanner->line,
+        .offset = scanner->start,
         .literal = literal
     };
 
@@ -205,7 +206,8 @@ TokenList scan_tokens(Scanner* scanner) {
     Token token = {
       .type = TOKEN_EOF,
       .lexeme = my_strndup("", 0),
-      .line = scanner->line
+      .line = scanner->line,
+      .offset = scanner->current
     };
     add_token_list(&scanner->tokens, token);
 
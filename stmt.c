@@ -7,7 +7,9 @@ Stmt* stmt_expression(Expr* expression) {
     if (!stmt) error(error_messages[ERROR_MALLOCFAIL].message);
 
     stmt->type = STMT_EXPRESSION;
+    stmt->line = 0;
     stmt->as.expr.expr = expression;
+    stmt->as.expr.declares = false;
 
     return stmt;
 }
@@ -17,17 +19,20 @@ Stmt* stmt_print(Expr* expression) {
     if (!stmt) error(error_messages[ERROR_MALLOCFAIL].message);
 
     stmt->type = STMT_PRINT;
+    stmt->line = 0;
     stmt->as.print.expr = expression;
 
     return stmt;
 }
 
-Stmt* stmt_var(Token name, Expr* initializer) {
+Stmt* stmt_var(Token name, FieldType type, Expr* initializer) {
     Stmt* stmt = malloc(sizeof(Stmt));
     if (!stmt) error(error_messages[ERROR_MALLOCFAIL].message);
 
     stmt->type = STMT_VAR;
+    stmt->line = 0;
     stmt->as.var.name = token_copy(name);
+    stmt->as.var.type = type;
     stmt->as.var.initializer = initializer;
 
     return stmt;
@@ -38,6 +43,7 @@ Stmt* stmt_block(Stmt** statements, int count) {
     if (!stmt) error(error_messages[ERROR_MALLOCFAIL].message);
 
     stmt->type = STMT_BLOCK;
+    stmt->line = 0;
     stmt->as.block.statements = statements;
     stmt->as.block.count = count;
 
@@ -49,6 +55,7 @@ Stmt* stmt_if(Expr* condition, Stmt* then_branch, Stmt* else_branch) {
     if (!stmt) error(error_messages[ERROR_MALLOCFAIL].message);
 
     stmt->type = STMT_IF;
+    stmt->line = 0;
     stmt->as.if_stmt.condition = condition;
     stmt->as.if_stmt.then_branch = then_branch;
     stmt->as.if_stmt.else_branch = else_branch;
@@ -61,6 +68,7 @@ Stmt* stmt_while(Expr* condition, Stmt* body) {
     if (!stmt) error(error_messages[ERROR_MALLOCFAIL].message);
 
     stmt->type = STMT_WHILE;
+    stmt->line = 0;
     stmt->as.while_stmt.condition = condition;
     stmt->as.while_stmt.body = body;
 
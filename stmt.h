@@ -3,6 +3,7 @@
 
 #include "expr.h"
 #include "token.h"
+#include "types.h"
 
 typedef struct Stmt Stmt;
 
@@ -17,6 +18,7 @@ typedef enum {
 
 typedef struct {
     Expr* expr;
+    bool declares; // a 'for' initializer: assigning to an unknown name declares it
 } ExprStmt;
 
 typedef struct {
@@ -25,6 +27,7 @@ typedef struct {
 
 typedef struct {
     Token name;
+    FieldType type;    // TYPE_UNKNOWN for `var` until the type checker infers it
     Expr* initializer; // nullable
 } VarStmt;
 
@@ -46,6 +49,7 @@ typedef struct {
 
 struct Stmt {
     StmtType type;
+    int line; // script line the statement starts on, 0 when synthesized
     union {
         ExprStmt expr;
         PrintStmt print;
@@ -58,7 +62,7 @@ struct Stmt {
 
 Stmt* stmt_expression(Expr* expr);
 Stmt* stmt_print(Expr* expr);
-Stmt* stmt_var(Token name, Expr* initializer);
+Stmt* stmt_var(Token name, FieldType type, Expr* initializer);
 Stmt* stmt_block(Stmt** statements, int count);
 Stmt* stmt_if(Expr* condition, Stmt* then_branch, Stmt* else_branch);
 Stmt* stmt_while(Expr* condition, Stmt* body);
@@ -0,0 +1,12 @@
+// Test stand-in for the engine's collision.h: only what generated code uses.
+#ifndef COLLISION_H
+#define COLLISION_H
+#include <stdint.h>
+typedef enum { COLLISION_NONE, COLLISION_RECT, COLLISION_CIRC } CollisionType;
+typedef struct { float x, y, width, height; } Rectangle;
+typedef struct { float x, y; } Vector2;
+typedef struct { uint32_t owner_id; Rectangle rect; } RectWrapper;
+typedef struct { uint32_t owner_id; Vector2 position; float radius; } Circle;
+typedef struct { RectWrapper* data; int count; int capacity; } RectangleArray;
+typedef struct { Circle* data; int count; int capacity; } CircleArray;
+#endif
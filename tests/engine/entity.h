@@ -0,0 +1,12 @@
+// Test stand-in for the engine's entity.h: only what generated code uses.
+#ifndef ENTITY_H
+#define ENTITY_H
+#include <stdint.h>
+#include "transform.h"
+#include "renderable.h"
+#include "collision.h"
+typedef struct { int count; int capacity; CollisionType* collision; } EntityRegistry;
+uint32_t entity_create(EntityRegistry* r, TransformArray* t, RenderableArray* rd, CircleArray* c, RectangleArray* rc);
+int entity_destroy(EntityRegistry* r, uint32_t id, TransformArray* t, RenderableArray* rd, CircleArray* c, RectangleArray* rc);
+void entity_set_collision(EntityRegistry* r, uint32_t id, CollisionType type);
+#endif
@@ -0,0 +1,4 @@
+// Test stand-in for the engine's forward.h: only what generated code uses.
+#ifndef FORWARD_H
+#define FORWARD_H
+#endif
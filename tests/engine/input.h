@@ -0,0 +1,7 @@
+// Test stand-in for the engine's input.h: only what generated code uses.
+#ifndef INPUT_H
+#define INPUT_H
+#include <stdbool.h>
+enum { KEY_RIGHT, KEY_LEFT, KEY_UP, KEY_DOWN, KEY_SPACE, KEY_A, KEY_Z };
+bool keyboard_check(int key);
+#endif
@@ -0,0 +1,6 @@
+// Test stand-in for the engine's renderable.h: only what generated code uses.
+#ifndef RENDERABLE_H
+#define RENDERABLE_H
+typedef struct { int current_sprite_id; int image_index; float frame_counter; float image_speed; } Renderable;
+typedef struct { Renderable* data; int count; int capacity; } RenderableArray;
+#endif
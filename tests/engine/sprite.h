@@ -0,0 +1,5 @@
+// Test stand-in for the engine's sprite.h: only what generated code uses.
+#ifndef SPRITE_H
+#define SPRITE_H
+enum { SPRITE_NONE, SPRITE_YELLOW, SPRITE_WALL, SPRITE_CLOUD, SPRITE_BULLET };
+#endif
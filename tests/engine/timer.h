@@ -0,0 +1,5 @@
+// Test stand-in for the engine's timer.h: only what generated code uses.
+#ifndef TIMER_H
+#define TIMER_H
+typedef struct { int count; } TimerArray;
+#endif
@@ -0,0 +1,6 @@
+// Test stand-in for the engine's transform.h: only what generated code uses.
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+typedef struct { float x, y, image_xscale, image_yscale; int up, right; float rotation_rad; } transform_t;
+typedef struct { transform_t* data; int count; int capacity; } TransformArray;
+#endif
@@ -0,0 +1,201 @@
+// AST cache: a stored program maps back intact, and a damaged file is a
+// cache miss rather than a crash.
+
+#include "ast_cache.h"
+#include "codegen.h"
+#include "scanner.h"
+#include "utils.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+static const char* script =
+    "entity Player {\n"
+    "    float hsp;\n"
+    "    float vsp;\n"
+    "    on_update {\n"
+    "        if (keyboard_check(KEY_RIGHT)) {\n"
+    "            transform.x = transform.x + self.hsp;\n"
+    "        }\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "game {\n"
+    "    spawn Player(64, 64);\n"
+    "    spawn Player(96, 64);\n"
+    "}\n";
+
+static const char* cache_path = "tests/test_ast_cache.wskc";
+
+typedef struct {
+    char* data;
+    size_t size;
+} Image;
+
+static Program parse_script(char** source, TokenList* tokens) {
+    *source = malloc(strlen(script) + 1);
+    strcpy(*source, script);
+    Scanner scanner = scanner_create(*source);
+    *tokens = scan_tokens(&scanner);
+    Parser parser = parser_create(*tokens);
+    return parse(&parser);
+}
+
+static char* generate(Program* program) {
+    CodeGen gen = codegen_create();
+    codegen_generate_program(&gen, program);
+    size_t length = strlen(gen.header_output) + strlen(gen.source_output);
+    char* out = malloc(length + 1);
+    snprintf(out, length + 1, "%s%s", gen.header_output, gen.source_output);
+    codegen_free(&gen);
+    return out;
+}
+
+static Image read_image(void) {
+    Image image = {0};
+    FILE* f = fopen(cache_path, "rb");
+    if (!f) return image;
+    fseek(f, 0, SEEK_END);
+    image.size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    image.data = malloc(image.size);
+    if (fread(image.data, 1, image.size, f) != image.size) image.size = 0;
+    fclose(f);
+    return image;
+}
+
+static void write_image(Image image) {
+    FILE* f = fopen(cache_path, "wb");
+    fwrite(image.data, 1, image.size, f);
+    fclose(f);
+}
+
+static void* at(Image image, uint64_t offset) {
+    return image.data + offset;
+}
+
+static Program* program_record(Image image) {
+    return at(image, ((AstCacheHeader*)image.data)->program);
+}
+
+static EntityDecl* first_entity(Image image) {
+    uintptr_t entities = (uintptr_t)program_record(image)->entities;
+    return at(image, *(uintptr_t*)at(image, entities));
+}
+
+// Store the damaged copy and check the loader turns it away.
+static void expect_miss(Image image, uint64_t hash) {
+    write_image(image);
+    Program program;
+    CHECK(!ast_cache_load(cache_path, hash, &program));
+}
+
+static void test_round_trip(uint64_t hash) {
+    char* source;
+    TokenList tokens;
+    Program parsed = parse_script(&source, &tokens);
+    ast_cache_store(cache_path, hash, &parsed);
+
+    Program cached;
+    CHECK(ast_cache_load(cache_path, hash, &cached));
+    CHECK(cached.mapped != NULL);
+    CHECK(cached.entity_count == 1);
+    CHECK(cached.game && cached.game->spawn_count == 2);
+
+    char* expected = generate(&parsed);
+    char* actual = generate(&cached);
+    CHECK(strcmp(expected, actual) == 0);
+
+    free(expected);
+    free(actual);
+    free_program(&cached);
+    free_program(&parsed);
+    free_token_list(&tokens);
+    free(source);
+}
+
+static void test_damaged_counts(uint64_t hash) {
+    Image pristine = read_image();
+    CHECK(pristine.size > sizeof(AstCacheHeader));
+    Image image = { malloc(pristine.size), pristine.size };
+
+    memcpy(image.data, pristine.data, image.size);
+    first_entity(image)->field_count = 1 << 20;
+    expect_miss(image, hash);
+
+    memcpy(image.data, pristine.data, image.size);
+    first_entity(image)->field_count = -1;
+    expect_miss(image, hash);
+
+    memcpy(image.data, pristine.data, image.size);
+    program_record(image)->entity_count = 1 << 20;
+    expect_miss(image, hash);
+
+    uint64_t game = (uintptr_t)program_record(pristine)->game;
+    memcpy(image.data, pristine.data, image.size);
+    ((GameDecl*)at(image, game))->spawn_count = 1 << 20;
+    expect_miss(image, hash);
+
+    free(image.data);
+    free(pristine.data);
+}
+
+static void test_damaged_offsets(uint64_t hash) {
+    Image pristine = read_image();
+    Image image = { malloc(pristine.size), pristine.size };
+
+    // A node that starts inside the file but runs off its end.
+    memcpy(image.data, pristine.data, image.size);
+    program_record(image)->game = (GameDecl*)(uintptr_t)((image.size - sizeof(GameDecl) / 2) & ~(size_t)7);
+    expect_miss(image, hash);
+
+    // A misaligned node.
+    memcpy(image.data, pristine.data, image.size);
+    program_record(image)->game = (GameDecl*)((uintptr_t)program_record(image)->game + 1);
+    expect_miss(image, hash);
+
+    // The program record itself hanging off the end.
+    memcpy(image.data, pristine.data, image.size);
+    ((AstCacheHeader*)image.data)->program = image.size - 8;
+    expect_miss(image, hash);
+
+    // A required node stored as NULL.
+    memcpy(image.data, pristine.data, image.size);
+    first_entity(image)->name.lexeme = NULL;
+    expect_miss(image, hash);
+
+    // A string with no terminator before the end of the file.
+    // The last bytes are the Program record's unused mapping fields.
+    memcpy(image.data, pristine.data, image.size);
+    first_entity(image)->name.lexeme = (char*)(uintptr_t)(image.size - 16);
+    memset(image.data + image.size - 16, 'x', 16);
+    expect_miss(image, hash);
+
+    free(image.data);
+    free(pristine.data);
+}
+
+int main(void) {
+    uint64_t hash = hash_bytes(script, strlen(script));
+    test_round_trip(hash);
+    test_damaged_counts(hash);
+    test_damaged_offsets(hash);
+    remove(cache_path);
+
+    if (failures > 0) {
+        fprintf(stderr, "test_ast_cache: %d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("test_ast_cache: ok\n");
+    return 0;
+}
@@ -0,0 +1,177 @@
+// Generated C must build as plain -std=c99 against the engine headers, with
+// nothing defined on the command line, whatever options produced it.
+// tests/engine stands in for the engine.
+
+#include "codegen.h"
+#include "effects.h"
+#include "optimize.h"
+#include "scanner.h"
+#include "typecheck.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures = 0;
+
+static const char* script =
+    "entity Player {\n"
+    "    float hsp;\n"
+    "    init {\n"
+    "        collision.type = COLLISION_RECT;\n"
+    "        collision.width = 16;\n"
+    "        collision.height = 16;\n"
+    "    }\n"
+    "    on_update {\n"
+    "        if (keyboard_check(KEY_RIGHT)) {\n"
+    "            self.hsp = 2;\n"
+    "        }\n"
+    "        transform.x = transform.x + self.hsp;\n"
+    "    }\n"
+    "    on_collision(other) {\n"
+    "        instance_destroy(other);\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "entity Wall {\n"
+    "    init {\n"
+    "        collision.type = COLLISION_RECT;\n"
+    "        collision.width = 8;\n"
+    "        collision.height = 8;\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "entity Bullet pooled {\n"
+    "    int t;\n"
+    "    on_update {\n"
+    "        self.t = self.t + 1;\n"
+    "        transform.x = transform.x + 4;\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "entity Boss singleton {\n"
+    "    float hp;\n"
+    "    on_create {\n"
+    "        self.hp = 3;\n"
+    "    }\n"
+    "    on_update {\n"
+    "        transform.y = transform.y + 1;\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "game {\n"
+    "    spawn Player(64, 64);\n"
+    "    spawn Wall(32, 32);\n"
+    "    spawn Boss(128, 16);\n"
+    "}\n";
+
+static const char* header_path = "tests/c99_generated.h";
+static const char* source_path = "tests/c99_generated.c";
+
+static void replace_all(char** text, const char* from, const char* to) {
+    char* found;
+    while ((found = strstr(*text, from)) != NULL) {
+        size_t before = found - *text;
+        size_t length = strlen(*text) - strlen(from) + strlen(to);
+        char* out = malloc(length + 1);
+        snprintf(out, length + 1, "%.*s%s%s", (int)before, *text, to, found + strlen(from));
+        free(*text);
+        *text = out;
+    }
+}
+
+static void write_text(const char* path, const char* text) {
+    FILE* f = fopen(path, "w");
+    fputs(text, f);
+    fclose(f);
+}
+
+// One way of generating the fixture. `marker` must show up in the source,
+// so a variant that quietly fell back to the plain output fails. With
+// portable_clock the rdtsc branch of the profile clock is switched off, as on
+// non-x86 targets.
+typedef struct {
+    const char* name;
+    bool line_directives;
+    bool profile;
+    bool trace;
+    bool parallel;
+    bool spawn_blob;
+    bool bake;
+    bool portable_clock;
+    const char* marker;
+} Variant;
+
+static const Variant variants[] = {
+    {"plain", .marker = "void game_init("},
+    {"profile", .profile = true, .marker = "game_profile_dump"},
+    {"profile, portable clock", .profile = true, .portable_clock = true, .marker = "game_profile_dump"},
+    {"trace", .trace = true, .marker = "whisker_trace("},
+    {"line directives", .line_directives = true, .marker = "#line "},
+    {"parallel", .parallel = true, .marker = "whisker_parallel_for("},
+    {"spawn blob", .spawn_blob = true, .marker = "\"WSKS\""},
+    {"bake", .bake = true, .marker = "whisker_baked_bosss"},
+};
+
+// Generate the variant and syntax-check the source.
+static bool compiles_as_c99(const Variant* variant) {
+    char* source = malloc(strlen(script) + 1);
+    strcpy(source, script);
+    Scanner scanner = scanner_create(source);
+    TokenList tokens = scan_tokens(&scanner);
+    Parser parser = parser_create(tokens);
+    Program program = parse(&parser);
+    for (int i = 0; i < program.entity_count; i++) {
+        program.entities[i]->path = "c99_fixture.wsk"; // as the module loader would
+    }
+    typecheck_program(&program);
+    optimize_program(&program);
+    effects_analyze_program(&program);
+
+    CodeGen gen = codegen_create();
+    gen.options.header_name = "c99_generated.h";
+    gen.options.source_name = source_path;
+    gen.options.line_directives = variant->line_directives;
+    gen.options.profile = variant->profile;
+    gen.options.trace = variant->trace;
+    gen.options.parallel = variant->parallel;
+    gen.options.spawn_blob = variant->spawn_blob;
+    gen.options.bake = variant->bake;
+    codegen_generate_program(&gen, &program);
+
+    char* c = malloc(strlen(gen.source_output) + 1);
+    strcpy(c, gen.source_output);
+    if (variant->portable_clock) {
+        replace_all(&c, "#if defined(__x86_64__) || defined(__i386__)", "#if 0");
+    }
+    bool generated = strstr(c, variant->marker) != NULL;
+    write_text(header_path, gen.header_output);
+    write_text(source_path, c);
+
+    int status = system("cc -std=c99 -pedantic-errors -Werror=implicit-function-declaration "
+                        "-fsyntax-only -Itests/engine tests/c99_generated.c");
+
+    remove(header_path);
+    remove(source_path);
+    free(c);
+    codegen_free(&gen);
+    free_program(&program);
+    free_token_list(&tokens);
+    free(source);
+    return generated && status == 0;
+}
+
+int main(void) {
+    for (size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); i++) {
+        if (!compiles_as_c99(&variants[i])) {
+            fprintf(stderr, "test_generated_c99: %s output is not plain C99\n", variants[i].name);
+            failures++;
+        }
+    }
+
+    if (failures > 0) {
+        fprintf(stderr, "test_generated_c99: %d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("test_generated_c99: ok\n");
+    return 0;
+}
@@ -0,0 +1,243 @@
+// Incremental reparsing: edits must only reparse what they touch, survive
+// syntax errors, and end up with the same program a full parse gives.
+
+#include "codegen.h"
+#include "effects.h"
+#include "incremental.h"
+#include "optimize.h"
+#include "scanner.h"
+#include "typecheck.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+static const char* script =
+    "// two entities and a game\n"
+    "entity Player {\n"
+    "    float hsp;\n"
+    "    on_update {\n"
+    "        transform.x = transform.x + self.hsp;\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "entity Wall {\n"
+    "    init {\n"
+    "        collision.type = COLLISION_RECT;\n"
+    "        collision.width = 8;\n"
+    "        collision.height = 8;\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "game {\n"
+    "    spawn Player(64, 64);\n"
+    "    spawn Wall(32, 32);\n"
+    "}\n";
+
+static int offset_of(IncrementalDoc* doc, const char* needle) {
+    const char* found = strstr(doc->source, needle);
+    if (!found) {
+        fprintf(stderr, "missing \"%s\" in the document\n", needle);
+        exit(1);
+    }
+    return (int)(found - doc->source);
+}
+
+static bool edit(IncrementalDoc* doc, const char* needle, int skip, int deleted, const char* inserted) {
+    return incremental_edit(doc, offset_of(doc, needle) + skip, deleted, inserted);
+}
+
+static char* generate(Program* program) {
+    CodeGen gen = codegen_create();
+    codegen_generate_program(&gen, program);
+    size_t length = strlen(gen.header_output) + strlen(gen.source_output);
+    char* out = malloc(length + 1);
+    snprintf(out, length + 1, "%s%s", gen.header_output, gen.source_output);
+    codegen_free(&gen);
+    return out;
+}
+
+// The document's program generates the same C as a full parse of its text.
+static bool matches_full_parse(IncrementalDoc* doc) {
+    char* source = malloc(doc->length + 1);
+    memcpy(source, doc->source, doc->length + 1);
+    Scanner scanner = scanner_create(source);
+    TokenList tokens = scan_tokens(&scanner);
+    Parser parser = parser_create(tokens);
+    Program full = parse(&parser);
+    typecheck_program(&full);
+    optimize_program(&full);
+    effects_analyze_program(&full);
+
+    char* expected = generate(&full);
+    char* actual = generate(&doc->program);
+    bool same = strcmp(expected, actual) == 0;
+
+    free(expected);
+    free(actual);
+    free_program(&full);
+    free_token_list(&tokens);
+    free(source);
+    return same;
+}
+
+static void test_edit_inside_entity(void) {
+    IncrementalDoc doc = incremental_open(script);
+    CHECK(!doc.has_error);
+    CHECK(doc.program.entity_count == 2);
+    EntityDecl* player = doc.program.entities[0];
+    EntityDecl* wall = doc.program.entities[1];
+    GameDecl* game = doc.program.game;
+
+    CHECK(edit(&doc, "float hsp;", 0, 0, "float vsp;\n    "));
+    CHECK(!doc.has_error);
+    CHECK(doc.program.entities[0] != player);
+    CHECK(doc.program.entities[0]->field_count == 2);
+    CHECK(doc.program.entities[1] == wall);
+    CHECK(doc.program.game == game);
+    CHECK(matches_full_parse(&doc));
+    incremental_close(&doc);
+}
+
+static void test_brace_balance(void) {
+    IncrementalDoc doc = incremental_open(script);
+    EntityDecl* player = doc.program.entities[0];
+
+    // Opening a block runs the entity on into the next region: Wall becomes
+    // part of it and no longer parses as an entity of its own.
+    CHECK(!edit(&doc, "transform.x = transform.x", 0, 0, "if (self.hsp > 0) { "));
+    CHECK(doc.has_error);
+    CHECK(doc.program.entities[0] == player);
+
+    // Closing it again brings everything back.
+    CHECK(edit(&doc, "self.hsp;\n", 9, 0, " }"));
+    CHECK(!doc.has_error);
+    CHECK(doc.program.entity_count == 2);
+    CHECK(matches_full_parse(&doc));
+
+    // Deleting an entity's closing brace swallows the next declaration.
+    int brace = offset_of(&doc, "}\n\nentity Wall");
+    CHECK(!incremental_edit(&doc, brace, 1, ""));
+    CHECK(doc.program.entity_count == 2);
+    CHECK(incremental_edit(&doc, brace, 0, "}"));
+    CHECK(doc.program.entity_count == 2);
+    CHECK(matches_full_parse(&doc));
+    incremental_close(&doc);
+}
+
+static void test_error_then_fix(void) {
+    IncrementalDoc doc = incremental_open(script);
+    EntityDecl* player = doc.program.entities[0];
+    EntityDecl* wall = doc.program.entities[1];
+
+    CHECK(!edit(&doc, "collision.width = 8;", 0, 0, "collision.width = ;\n        "));
+    CHECK(doc.has_error);
+    CHECK(strstr(doc.error_message, "Error") != NULL);
+    // The last good program is still there, untouched.
+    CHECK(doc.program.entity_count == 2);
+    CHECK(doc.program.entities[0] == player);
+    CHECK(doc.program.entities[1] == wall);
+
+    // An edit elsewhere still works and brings the broken text along.
+    CHECK(!edit(&doc, "spawn Wall", 0, 0, "spawn Wall(0, 0);\n    "));
+    CHECK(doc.program.entities[1] == wall);
+
+    // A type error is reported the same way.
+    CHECK(edit(&doc, "collision.width = ;\n        ", 0, 28, ""));
+    CHECK(!doc.has_error);
+    CHECK(!edit(&doc, "self.hsp;", 0, 8, "self.nope"));
+    CHECK(doc.has_error);
+
+    CHECK(edit(&doc, "self.nope", 0, 9, "self.hsp"));
+    CHECK(!doc.has_error);
+    CHECK(doc.program.game->spawn_count == 3);
+    CHECK(matches_full_parse(&doc));
+
+    // A document that never parsed recovers on its first good edit.
+    IncrementalDoc broken = incremental_open("entity Bad { float ; }\n");
+    CHECK(broken.has_error);
+    CHECK(broken.program.entity_count == 0);
+    CHECK(incremental_edit(&broken, offset_of(&broken, ";"), 0, "x"));
+    CHECK(broken.program.entity_count == 1);
+    CHECK(matches_full_parse(&broken));
+    incremental_close(&broken);
+
+    CHECK(!incremental_edit(&doc, doc.length + 1, 0, "x"));
+    CHECK(doc.has_error);
+    incremental_close(&doc);
+}
+
+static void test_matches_full_parse(void) {
+    IncrementalDoc doc = incremental_open(script);
+    CHECK(matches_full_parse(&doc));
+
+    CHECK(edit(&doc, "game {", 0, 0, "entity Cloud {\n    float drift;\n}\n\n"));
+    CHECK(edit(&doc, "spawn Wall", 0, 0, "spawn Cloud(1, 2);\n    "));
+    CHECK(edit(&doc, "collision.width = 8", 18, 1, "4 * 4"));
+    CHECK(edit(&doc, "// two entities", 0, 0, "\n\n"));
+    CHECK(edit(&doc, "entity Wall {", 0, 0, "// the walls\n"));
+    CHECK(doc.program.entity_count == 3);
+    CHECK(matches_full_parse(&doc));
+
+    // Every declaration reparsed from scratch gives the same program too.
+    IncrementalDoc fresh = incremental_open(doc.source);
+    CHECK(fresh.region_count == doc.region_count);
+    for (int i = 0; i < doc.region_count && i < fresh.region_count; i++) {
+        DeclRegion expected = incremental_region(&fresh, i);
+        DeclRegion actual = incremental_region(&doc, i);
+        CHECK(actual.start == expected.start);
+        CHECK(actual.length == expected.length);
+        CHECK(actual.line == expected.line);
+        CHECK(memcmp(actual.before, expected.before, sizeof(actual.before)) == 0);
+        CHECK(incremental_region_at(&doc, actual.start) == i);
+    }
+    incremental_close(&fresh);
+    incremental_close(&doc);
+}
+
+// Adding lines above a declaration leaves its stored lines alone; they are
+// mapped to the document when read.
+static void test_lines_stay_relative(void) {
+    IncrementalDoc doc = incremental_open(script);
+    Stmt* collide = doc.program.entities[1]->init->as.block.statements[0];
+    int stored = collide->line;
+    CHECK(incremental_line(&doc, 1, stored) == 11);
+
+    CHECK(edit(&doc, "float hsp;", 0, 0, "\n\n\n"));
+    CHECK(doc.program.entities[1]->init->as.block.statements[0] == collide);
+    CHECK(collide->line == stored);
+    CHECK(incremental_line(&doc, 1, stored) == 14);
+    CHECK(incremental_region(&doc, 1).line == 12);
+
+    // A second game block is an error at its line; removing it recovers.
+    CHECK(!edit(&doc, "entity Wall", 0, 0, "game {\n}\n"));
+    CHECK(strstr(doc.error_message, "[line 22]") != NULL);
+    CHECK(doc.game_count == 2);
+    CHECK(edit(&doc, "game {\n}\n", 0, 9, ""));
+    CHECK(doc.game_count == 1);
+    CHECK(matches_full_parse(&doc));
+    incremental_close(&doc);
+}
+
+int main(void) {
+    test_edit_inside_entity();
+    test_brace_balance();
+    test_error_then_fix();
+    test_matches_full_parse();
+    test_lines_stay_relative();
+
+    if (failures > 0) {
+        fprintf(stderr, "test_incremental: %d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("test_incremental: ok\n");
+    return 0;
+}
@@ -0,0 +1,112 @@
+// --profile-use: hooks are only marked cold for types that had instances
+// alive during the recorded run.
+
+#include "codegen.h"
+#include "effects.h"
+#include "optimize.h"
+#include "profile_data.h"
+#include "scanner.h"
+#include "typecheck.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+static const char* script =
+    "entity Player {\n"
+    "    float hsp;\n"
+    "    on_update {\n"
+    "        transform.x = transform.x + self.hsp;\n"
+    "    }\n"
+    "    on_destroy {\n"
+    "        self.hsp = 0;\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "entity Ghost {\n"
+    "    float vsp;\n"
+    "    on_update {\n"
+    "        transform.y = transform.y + self.vsp;\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "game {\n"
+    "    spawn Player(64, 64);\n"
+    "}\n";
+
+// Ghost is in the dump like every type, but was never spawned.
+static const char* profile =
+    "whisker-profile 2\n"
+    "type Player instances 1 peak 1\n"
+    "type Ghost instances 0 peak 0\n"
+    "hook Player update calls 600 cycles 48000\n";
+
+static const char* profile_path = "tests/test_profile_use.txt";
+
+static char* generate_with(ProfileData* data) {
+    char* source = malloc(strlen(script) + 1);
+    strcpy(source, script);
+    Scanner scanner = scanner_create(source);
+    TokenList tokens = scan_tokens(&scanner);
+    Parser parser = parser_create(tokens);
+    Program program = parse(&parser);
+    typecheck_program(&program);
+    optimize_program(&program);
+    effects_analyze_program(&program);
+
+    CodeGen gen = codegen_create();
+    gen.options.profile_use = data;
+    codegen_generate_program(&gen, &program);
+    char* out = malloc(strlen(gen.source_output) + 1);
+    strcpy(out, gen.source_output);
+
+    codegen_free(&gen);
+    free_program(&program);
+    free_token_list(&tokens);
+    free(source);
+    return out;
+}
+
+static void test_load(ProfileData* data) {
+    CHECK(data->type_count == 2);
+    CHECK(profile_type_peak(data, "Player") == 1);
+    CHECK(profile_type_peak(data, "Ghost") == 0);
+    CHECK(profile_type_peak(data, "Missing") == 0);
+    CHECK(profile_hook_calls(data, "Player", HOOK_UPDATE) == 600);
+}
+
+static void test_cold_hooks(ProfileData* data) {
+    char* c = generate_with(data);
+    CHECK(strstr(c, "WHISKER_COLD void player_destroy(") != NULL);
+    CHECK(strstr(c, "WHISKER_COLD void player_update(") == NULL);
+    CHECK(strstr(c, "void ghost_update(") != NULL);
+    CHECK(strstr(c, "WHISKER_COLD void ghost_update(") == NULL);
+    free(c);
+}
+
+int main(void) {
+    FILE* f = fopen(profile_path, "w");
+    fputs(profile, f);
+    fclose(f);
+    ProfileData data = profile_data_load(profile_path);
+    remove(profile_path);
+
+    test_load(&data);
+    test_cold_hooks(&data);
+    profile_data_free(&data);
+
+    if (failures > 0) {
+        fprintf(stderr, "test_profile_use: %d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("test_profile_use: ok\n");
+    return 0;
+}
@@ -102,6 +102,8 @@ char* token_type_to_string(TokenType type) {
             return "game";
         case TOKEN_SPAWN:
             return "spawn";
+        case TOKEN_IMPORT:
+            return "import";
         case TOKEN_INIT:
             return "init";
     }
@@ -19,7 +19,7 @@ typedef enum {
 
     // Keywords.
     TOKEN_AND, TOKEN_ELSE, TOKEN_FALSE, TOKEN_FOR, TOKEN_IF, TOKEN_OR,
-    TOKEN_TRUE, TOKEN_VAR, TOKEN_WHILE, TOKEN_GAME, TOKEN_SPAWN,
+    TOKEN_TRUE, TOKEN_VAR, TOKEN_WHILE, TOKEN_GAME, TOKEN_SPAWN, TOKEN_IMPORT,
 
     // Entity keywords.
     TOKEN_ENTITY, TOKEN_INIT, TOKEN_ON_CREATE, TOKEN_ON_UPDATE, TOKEN_ON_DESTROY, TOKEN_ON_COLLISION, TOKEN_SELF, TOKEN_FLOAT, TOKEN_INT,
@@ -34,6 +34,7 @@ typedef enum {
 typedef struct {
     TokenType type;
     int line;
+    int offset; // byte offset of the lexeme in the scanned source
     char *lexeme;
     Literal literal;
 } Token;
@@ -49,7 +50,7 @@ typedef struct {
     TokenType type;
 } KeywordMap;
 
-#define KEYWORD_COUNT 25
+#define KEYWORD_COUNT 26
 
 static const KeywordMap keywords[] = {
     {"and" , TOKEN_AND},
@@ -76,7 +77,8 @@ static const KeywordMap keywords[] = {
     {"renderable", TOKEN_RENDERABLE},
     {"collision", TOKEN_COLLISION},
     {"game", TOKEN_GAME},
-    {"spawn", TOKEN_SPAWN}
+    {"spawn", TOKEN_SPAWN},
+    {"import", TOKEN_IMPORT}
 };
 
 //helpers
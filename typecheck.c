@@ -0,0 +1,515 @@
+#include "typecheck.h"
+#include "error.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// One per var statement in the hook. Locals outlive a single pass so that
+// inferred types can keep widening until nothing changes.
+typedef struct {
+    Stmt* decl;
+    FieldType type;  // declared, or inferred so far (TYPE_UNKNOWN: no info yet)
+    bool inferred;   // declared with `var`
+} Local;
+
+typedef struct {
+    EntityDecl* entity;
+    HookKind hook;
+
+    Local* locals;
+    int local_count;
+    int local_capacity;
+
+    int* scope;      // indices into locals, innermost last
+    int scope_count;
+    int scope_capacity;
+    int block_start; // first scope slot of the current block
+
+    bool changed;    // an inferred type widened during this pass
+} Checker;
+
+typedef struct {
+    const char* name;
+    FieldType type;
+} ComponentField;
+
+static const ComponentField transform_fields[] = {
+    {"x", TYPE_FLOAT}, {"y", TYPE_FLOAT},
+    {"image_xscale", TYPE_FLOAT}, {"image_yscale", TYPE_FLOAT},
+    {"up", TYPE_INT}, {"right", TYPE_INT},
+    {"rotation_rad", TYPE_FLOAT},
+    {NULL, TYPE_UNKNOWN}
+};
+
+static const ComponentField renderable_fields[] = {
+    {"current_sprite_id", TYPE_INT}, {"image_index", TYPE_INT},
+    {"frame_counter", TYPE_FLOAT}, {"image_speed", TYPE_FLOAT},
+    {NULL, TYPE_UNKNOWN}
+};
+
+static const ComponentField collision_fields[] = {
+    {"type", TYPE_INT}, {"width", TYPE_FLOAT}, {"height", TYPE_FLOAT},
+    {NULL, TYPE_UNKNOWN}
+};
+
+typedef struct {
+    const char* name;
+    int arity;
+    FieldType params[3];
+    FieldType result;
+} Builtin;
+
+static const Builtin builtins[] = {
+    {"place_meeting", 3, {TYPE_FLOAT, TYPE_FLOAT, TYPE_INT}, TYPE_BOOL},
+    {"instance_destroy", 1, {TYPE_UINT32}, TYPE_VOID},
+    {"keyboard_check", 1, {TYPE_INT}, TYPE_BOOL},
+    {NULL, 0, {TYPE_UNKNOWN}, TYPE_UNKNOWN}
+};
+
+static FieldType check_expr(Checker* c, Expr* expr);
+static void check_stmt(Checker* c, Stmt* stmt);
+
+static bool is_numeric(FieldType type) {
+    return type == TYPE_FLOAT || type == TYPE_INT || type == TYPE_BOOL ||
+           type == TYPE_UINT32 || type == TYPE_UNKNOWN;
+}
+
+// Usual arithmetic conversions, with anything we cannot see treated as float
+// (what every local used to be).
+static FieldType join(FieldType a, FieldType b) {
+    if (a == TYPE_UNKNOWN || b == TYPE_UNKNOWN) return TYPE_FLOAT;
+    if (a == TYPE_FLOAT || b == TYPE_FLOAT) return TYPE_FLOAT;
+    if (a == TYPE_UINT32 && b == TYPE_UINT32) return TYPE_UINT32;
+    return TYPE_INT;
+}
+
+// A number literal where a float is needed is emitted as a float literal, so
+// the C compiler never sees an int or a double there.
+static void coerce(Expr* expr, FieldType want) {
+    if (want != TYPE_FLOAT) return;
+
+    switch (expr->type) {
+        case EXPR_LITERAL:
+            if (expr->as.literal.value.type == LITERAL_NUMBER) expr->value_type = TYPE_FLOAT;
+            break;
+        case EXPR_GROUPING:
+            coerce(expr->as.grouping.expression, want);
+            expr->value_type = expr->as.grouping.expression->value_type;
+            break;
+        case EXPR_UNARY:
+            if (expr->as.unary.oprt.type == TOKEN_MINUS) {
+                coerce(expr->as.unary.right, want);
+                expr->value_type = expr->as.unary.right->value_type;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+bool is_constant_name(const char* name) {
+    bool letter = false;
+    for (const char* p = name; *p; p++) {
+        if (*p >= 'a' && *p <= 'z') return false;
+        if (*p >= 'A' && *p <= 'Z') letter = true;
+    }
+    return letter;
+}
+
+static int find_local(Checker* c, Stmt* decl) {
+    for (int i = 0; i < c->local_count; i++) {
+        if (c->locals[i].decl == decl) return i;
+    }
+
+    if (c->local_count >= c->local_capacity) {
+        c->local_capacity = c->local_capacity == 0 ? 8 : c->local_capacity * 2;
+        Local* new_locals = realloc(c->locals, sizeof(Local) * c->local_capacity);
+        if (!new_locals) error(error_messages[ERROR_REALLOCFAIL].message);
+        c->locals = new_locals;
+    }
+
+    c->locals[c->local_count] = (Local){decl, decl->as.var.type, decl->as.var.type == TYPE_UNKNOWN};
+    return c->local_count++;
+}
+
+static int lookup(Checker* c, const char* name) {
+    for (int i = c->scope_count - 1; i >= 0; i--) {
+        if (strcmp(c->locals[c->scope[i]].decl->as.var.name.lexeme, name) == 0) return c->scope[i];
+    }
+    return -1;
+}
+
+static int declare(Checker* c, Stmt* decl) {
+    for (int i = c->block_start; i < c->scope_count; i++) {
+        if (strcmp(c->locals[c->scope[i]].decl->as.var.name.lexeme, decl->as.var.name.lexeme) == 0) {
+            error_at_token(decl->as.var.name, "Variable is already declared in this scope.");
+        }
+    }
+
+    if (c->scope_count >= c->scope_capacity) {
+        c->scope_capacity = c->scope_capacity == 0 ? 8 : c->scope_capacity * 2;
+        int* new_scope = realloc(c->scope, sizeof(int) * c->scope_capacity);
+        if (!new_scope) error(error_messages[ERROR_REALLOCFAIL].message);
+        c->scope = new_scope;
+    }
+
+    int index = find_local(c, decl);
+    c->scope[c->scope_count++] = index;
+    return index;
+}
+
+// Flow the type of an assigned value into a local.
+static void assign_local(Checker* c, int index, FieldType value, Token at) {
+    Local* local = &c->locals[index];
+    if (value == TYPE_VOID) error_at_token(at, "Cannot assign the result of a function that returns nothing.");
+
+    FieldType current = local->type;
+    if ((current == TYPE_STRING) != (value == TYPE_STRING) && current != TYPE_UNKNOWN) {
+        error_at_token(at, "Cannot mix strings and numbers in one variable.");
+    }
+    if (!local->inferred) return;
+
+    FieldType widened;
+    if (current == TYPE_UNKNOWN) {
+        widened = value == TYPE_UNKNOWN ? TYPE_FLOAT : value;
+    } else if (current == TYPE_STRING) {
+        widened = TYPE_STRING;
+    } else {
+        widened = current == value ? current : join(current, value);
+    }
+
+    if (widened != current) {
+        local->type = widened;
+        c->changed = true;
+    }
+}
+
+static FieldType component_field(const ComponentField* fields, const char* name) {
+    for (int i = 0; fields[i].name; i++) {
+        if (strcmp(fields[i].name, name) == 0) return fields[i].type;
+    }
+    return TYPE_UNKNOWN;
+}
+
+// Type of object.name, for self and the built-in components.
+static FieldType member_type(Checker* c, Expr* object, Token name) {
+    if (object->type != EXPR_VARIABLE) {
+        check_expr(c, object);
+        return TYPE_UNKNOWN;
+    }
+
+    const char* owner = object->as.variable.name.lexeme;
+    object->value_type = TYPE_UNKNOWN;
+
+    if (strcmp(owner, "self") == 0) {
+        for (int i = 0; i < c->entity->field_count; i++) {
+            if (strcmp(c->entity->fields[i].name.lexeme, name.lexeme) == 0) {
+                return c->entity->fields[i].type;
+            }
+        }
+        error_at_token(name, "Entity has no field with this name.");
+    }
+    if (strcmp(owner, "transform") == 0) return component_field(transform_fields, name.lexeme);
+    if (strcmp(owner, "renderable") == 0) return component_field(renderable_fields, name.lexeme);
+    if (strcmp(owner, "collision") == 0) return component_field(collision_fields, name.lexeme);
+
+    check_expr(c, object);
+    return TYPE_UNKNOWN;
+}
+
+// Names the hook provides without a declaration: eid, the collision
+// parameter, x and y in on_create, the components and engine constants.
+static bool hook_name_type(Checker* c, const char* n, FieldType* type) {
+    *type = TYPE_UNKNOWN;
+    if (strcmp(n, "eid") == 0) *type = TYPE_UINT32;
+    else if (c->hook == HOOK_COLLISION && c->entity->collision_param.lexeme &&
+             strcmp(n, c->entity->collision_param.lexeme) == 0) *type = TYPE_UINT32;
+    else if (c->hook == HOOK_CREATE && (strcmp(n, "x") == 0 || strcmp(n, "y") == 0)) *type = TYPE_FLOAT;
+    else if (is_constant_name(n)) *type = TYPE_INT;
+    else if (strcmp(n, "self") != 0 && strcmp(n, "transform") != 0 &&
+             strcmp(n, "renderable") != 0 && strcmp(n, "collision") != 0) return false;
+    return true;
+}
+
+static FieldType variable_type(Checker* c, Token name) {
+    int index = lookup(c, name.lexeme);
+    if (index >= 0) {
+        FieldType type = c->locals[index].type;
+        return type == TYPE_UNKNOWN ? TYPE_FLOAT : type;
+    }
+
+    FieldType type;
+    if (hook_name_type(c, name.lexeme, &type)) return type;
+    error_at_token(name, "Undefined variable.");
+    return TYPE_UNKNOWN; // unreachable
+}
+
+// Report a call error at the name being called, when the callee has one.
+static void call_error(Expr* call, const char* message) {
+    Expr* callee = call->as.call.callee;
+    for (;;) {
+        if (callee->type == EXPR_VARIABLE) error_at_token(callee->as.variable.name, message);
+        if (callee->type == EXPR_GET) error_at_token(callee->as.get.name, message);
+        if (callee->type == EXPR_CALL) callee = callee->as.call.callee;
+        else if (callee->type == EXPR_GROUPING) callee = callee->as.grouping.expression;
+        else error(message);
+    }
+}
+
+static FieldType check_call(Checker* c, Expr* expr) {
+    for (int i = 0; i < expr->as.call.argc; i++) {
+        if (check_expr(c, expr->as.call.argv[i]) == TYPE_VOID) {
+            call_error(expr, "Cannot pass the result of a function that returns nothing.");
+        }
+    }
+
+    Expr* callee = expr->as.call.callee;
+    if (callee->type != EXPR_VARIABLE) return TYPE_UNKNOWN;
+
+    for (int i = 0; builtins[i].name; i++) {
+        if (strcmp(builtins[i].name, callee->as.variable.name.lexeme) != 0) continue;
+
+        if (expr->as.call.argc != builtins[i].arity) {
+            char message[128];
+            snprintf(message, sizeof(message), "Expected %d argument%s but got %d.",
+                     builtins[i].arity, builtins[i].arity == 1 ? "" : "s", expr->as.call.argc);
+            error_at_token(callee->as.variable.name, message);
+        }
+        for (int j = 0; j < expr->as.call.argc; j++) {
+            coerce(expr->as.call.argv[j], builtins[i].params[j]);
+        }
+        return builtins[i].result;
+    }
+
+    // Engine or C functions we have no signature for.
+    return TYPE_UNKNOWN;
+}
+
+static FieldType check_binary(Checker* c, Expr* expr) {
+    FieldType left = check_expr(c, expr->as.binary.left);
+    FieldType right = check_expr(c, expr->as.binary.right);
+    Token op = expr->as.binary.oprt;
+
+    switch (op.type) {
+        case TOKEN_PLUS:
+        case TOKEN_MINUS:
+        case TOKEN_STAR:
+        case TOKEN_SLASH:
+            if (!is_numeric(left) || !is_numeric(right)) error_at_token(op, "Operands must be numbers.");
+            if (left == right && left != TYPE_BOOL && left != TYPE_UNKNOWN) return left;
+            coerce(expr->as.binary.left, join(left, right));
+            coerce(expr->as.binary.right, join(left, right));
+            return join(left, right);
+
+        case TOKEN_GREATER:
+        case TOKEN_GREATER_EQUAL:
+        case TOKEN_LESS:
+        case TOKEN_LESS_EQUAL:
+            if (!is_numeric(left) || !is_numeric(right)) error_at_token(op, "Operands must be numbers.");
+            coerce(expr->as.binary.left, join(left, right));
+            coerce(expr->as.binary.right, join(left, right));
+            return TYPE_BOOL;
+
+        case TOKEN_EQUAL_EQUAL:
+        case TOKEN_BANG_EQUAL:
+            if (is_numeric(left) && is_numeric(right)) {
+                coerce(expr->as.binary.left, join(left, right));
+                coerce(expr->as.binary.right, join(left, right));
+            }
+            // fallthrough
+        case TOKEN_AND:
+        case TOKEN_OR:
+            if (left == TYPE_VOID || right == TYPE_VOID) {
+                error_at_token(op, "Cannot use the result of a function that returns nothing.");
+            }
+            return TYPE_BOOL;
+
+        default:
+            return TYPE_UNKNOWN;
+    }
+}
+
+static FieldType check_expr(Checker* c, Expr* expr) {
+    FieldType type = TYPE_UNKNOWN;
+
+    switch (expr->type) {
+        case EXPR_LITERAL:
+            switch (expr->as.literal.value.type) {
+                case LITERAL_NUMBER: type = expr->as.literal.integer ? TYPE_INT : TYPE_FLOAT; break;
+                case LITERAL_STRING: type = TYPE_STRING; break;
+                case LITERAL_BOOLEAN: type = TYPE_BOOL; break;
+                default: break;
+            }
+            break;
+
+        case EXPR_GROUPING:
+            type = check_expr(c, expr->as.grouping.expression);
+            break;
+
+        case EXPR_VARIABLE:
+            type = variable_type(c, expr->as.variable.name);
+            break;
+
+        case EXPR_ASSIGN: {
+            FieldType value = check_expr(c, expr->as.assign.value);
+            int index = lookup(c, expr->as.assign.name.lexeme);
+            if (index < 0) error_at_token(expr->as.assign.name, "Undefined variable.");
+            assign_local(c, index, value, expr->as.assign.name);
+            type = c->locals[index].type;
+            coerce(expr->as.assign.value, type);
+            break;
+        }
+
+        case EXPR_UNARY: {
+            FieldType right = check_expr(c, expr->as.unary.right);
+            if (expr->as.unary.oprt.type == TOKEN_BANG) {
+                type = TYPE_BOOL;
+            } else {
+                if (!is_numeric(right)) error_at_token(expr->as.unary.oprt, "Operand must be a number.");
+                type = right == TYPE_FLOAT || right == TYPE_UNKNOWN ? TYPE_FLOAT : TYPE_INT;
+            }
+            break;
+        }
+
+        case EXPR_BINARY:
+            type = check_binary(c, expr);
+            break;
+
+        case EXPR_GET:
+            type = member_type(c, expr->as.get.object, expr->as.get.name);
+            break;
+
+        case EXPR_SET: {
+            FieldType value = check_expr(c, expr->as.set.value);
+            if (value == TYPE_VOID) {
+                error_at_token(expr->as.set.name, "Cannot assign the result of a function that returns nothing.");
+            }
+            type = member_type(c, expr->as.set.object, expr->as.set.name);
+            coerce(expr->as.set.value, type);
+            break;
+        }
+
+        case EXPR_CALL:
+            type = check_call(c, expr);
+            break;
+    }
+
+    expr->value_type = type;
+    return type;
+}
+
+// `for (i = 0; ...)` with no `i` in scope declares it.
+static void declare_from_assignment(Stmt* stmt) {
+    Expr* assign = stmt->as.expr.expr;
+    Token name = assign->as.assign.name;
+    Expr* value = assign->as.assign.value;
+    free(assign);
+
+    stmt->type = STMT_VAR;
+    stmt->as.var.name = name;
+    stmt->as.var.type = TYPE_UNKNOWN;
+    stmt->as.var.initializer = value;
+}
+
+// Statements nested in a block, if or while get their own scope.
+static void check_scoped(Checker* c, Stmt* stmt) {
+    int scope_count = c->scope_count;
+    int block_start = c->block_start;
+    c->block_start = scope_count;
+
+    if (stmt->type == STMT_BLOCK) {
+        for (int i = 0; i < stmt->as.block.count; i++) {
+            check_stmt(c, stmt->as.block.statements[i]);
+        }
+    } else {
+        check_stmt(c, stmt);
+    }
+
+    c->scope_count = scope_count;
+    c->block_start = block_start;
+}
+
+static void check_stmt(Checker* c, Stmt* stmt) {
+    if (!stmt) return;
+
+    FieldType provided;
+    if (stmt->type == STMT_EXPRESSION && stmt->as.expr.declares &&
+        stmt->as.expr.expr->type == EXPR_ASSIGN &&
+        lookup(c, stmt->as.expr.expr->as.assign.name.lexeme) < 0 &&
+        !hook_name_type(c, stmt->as.expr.expr->as.assign.name.lexeme, &provided)) {
+        declare_from_assignment(stmt);
+    }
+
+    switch (stmt->type) {
+        case STMT_EXPRESSION:
+            check_expr(c, stmt->as.expr.expr);
+            break;
+
+        case STMT_PRINT:
+            check_expr(c, stmt->as.print.expr);
+            break;
+
+        case STMT_VAR: {
+            FieldType value = TYPE_UNKNOWN;
+            if (stmt->as.var.initializer) value = check_expr(c, stmt->as.var.initializer);
+            int index = declare(c, stmt);
+            if (stmt->as.var.initializer) {
+                assign_local(c, index, value, stmt->as.var.name);
+                coerce(stmt->as.var.initializer, c->locals[index].type);
+            }
+            break;
+        }
+
+        case STMT_BLOCK:
+            check_scoped(c, stmt);
+            break;
+
+        case STMT_IF:
+            check_expr(c, stmt->as.if_stmt.condition);
+            check_scoped(c, stmt->as.if_stmt.then_branch);
+            if (stmt->as.if_stmt.else_branch) check_scoped(c, stmt->as.if_stmt.else_branch);
+            break;
+
+        case STMT_WHILE:
+            check_expr(c, stmt->as.while_stmt.condition);
+            check_scoped(c, stmt->as.while_stmt.body);
+            break;
+    }
+}
+
+static void check_hook(EntityDecl* entity, HookKind hook, Stmt* body) {
+    if (!body) return;
+
+    Checker c = {0};
+    c.entity = entity;
+    c.hook = hook;
+
+    // Types only ever widen, so this settles after a few passes.
+    do {
+        c.changed = false;
+        c.scope_count = 0;
+        c.block_start = 0;
+        check_scoped(&c, body);
+    } while (c.changed);
+
+    for (int i = 0; i < c.local_count; i++) {
+        FieldType type = c.locals[i].type;
+        c.locals[i].decl->as.var.type = type == TYPE_UNKNOWN ? TYPE_FLOAT : type;
+    }
+
+    free(c.locals);
+    free(c.scope);
+}
+
+void typecheck_entity(EntityDecl* entity) {
+    check_hook(entity, HOOK_CREATE, entity->on_create);
+    check_hook(entity, HOOK_UPDATE, entity->on_update);
+    check_hook(entity, HOOK_DESTROY, entity->on_destroy);
+    check_hook(entity, HOOK_COLLISION, entity->on_collision);
+}
+
+void typecheck_program(Program* program) {
+    for (int i = 0; i < program->entity_count; i++) {
+        typecheck_entity(program->entities[i]);
+    }
+}
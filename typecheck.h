@@ -0,0 +1,20 @@
+#ifndef TYPECHECK_H
+#define TYPECHECK_H
+
+#include "entity_ast.h"
+#include "parser.h"
+
+// Infers a type for every `var` local and annotates each expression in the
+// entity hooks with its value_type. Reports unknown self fields, undefined
+// variables, builtin arity and type mismatches as errors.
+//
+// Assigning to a name that is not declared yet, as a statement of its own
+// (`i = 0;`), declares it there, the way the for-loop examples use it.
+void typecheck_program(Program* program);
+void typecheck_entity(EntityDecl* entity);
+
+// Engine constants (KEY_RIGHT, SPRITE_YELLOW, ENTITY_TYPE_WALL, ...): names
+// with no lowercase letters.
+bool is_constant_name(const char* name);
+
+#endif
@@ -0,0 +1,219 @@
+#include "typeinfo.h"
+#include "error.h"
+#include "typecheck.h"
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_INIT_LOCALS 32
+
+typedef struct {
+    const char* name;  // an engine constant, or NULL for a number
+    double number;
+    bool integer;      // int arithmetic, like the generated C would do
+} InitValue;
+
+typedef struct {
+    EntityDecl* entity;
+    TypeInfo info;
+    int line;          // statement being evaluated, for errors
+    const char* local_names[MAX_INIT_LOCALS];
+    InitValue locals[MAX_INIT_LOCALS];
+    int local_count;
+} Evaluator;
+
+static void fail(Evaluator* e, const char* message) {
+    char full[256];
+    snprintf(full, sizeof(full), "%s init: %s", e->entity->name.lexeme, message);
+    error_at_line(e->line, full);
+}
+
+static InitValue number(double value, bool integer) {
+    return (InitValue){NULL, value, integer};
+}
+
+static double numeric(Evaluator* e, InitValue value) {
+    if (value.name) fail(e, "Engine constants cannot be used in arithmetic.");
+    return value.number;
+}
+
+static InitValue* find_local(Evaluator* e, const char* name) {
+    for (int i = 0; i < e->local_count; i++) {
+        if (strcmp(e->local_names[i], name) == 0) return &e->locals[i];
+    }
+    return NULL;
+}
+
+static void set_local(Evaluator* e, const char* name, InitValue value) {
+    InitValue* local = find_local(e, name);
+    if (local) {
+        *local = value;
+        return;
+    }
+    if (e->local_count >= MAX_INIT_LOCALS) fail(e, "Too many locals.");
+    e->local_names[e->local_count] = name;
+    e->locals[e->local_count++] = value;
+}
+
+static InitValue eval_expr(Evaluator* e, Expr* expr);
+
+static InitValue eval_binary(Evaluator* e, Expr* expr) {
+    InitValue left = eval_expr(e, expr->as.binary.left);
+    InitValue right = eval_expr(e, expr->as.binary.right);
+    double a = numeric(e, left);
+    double b = numeric(e, right);
+    bool integer = left.integer && right.integer;
+
+    switch (expr->as.binary.oprt.type) {
+        case TOKEN_PLUS: return number(a + b, integer);
+        case TOKEN_MINUS: return number(a - b, integer);
+        case TOKEN_STAR: return number(a * b, integer);
+        case TOKEN_SLASH:
+            if (b == 0) fail(e, "Division by zero.");
+            return number(integer ? (double)((long long)a / (long long)b) : a / b, integer);
+        case TOKEN_GREATER: return number(a > b, true);
+        case TOKEN_GREATER_EQUAL: return number(a >= b, true);
+        case TOKEN_LESS: return number(a < b, true);
+        case TOKEN_LESS_EQUAL: return number(a <= b, true);
+        case TOKEN_EQUAL_EQUAL: return number(a == b, true);
+        case TOKEN_BANG_EQUAL: return number(a != b, true);
+        case TOKEN_AND: return number(a != 0 && b != 0, true);
+        case TOKEN_OR: return number(a != 0 || b != 0, true);
+        default:
+            fail(e, "Unsupported operator.");
+            return number(0, true);
+    }
+}
+
+// collision.* and renderable.current_sprite_id, as set so far.
+static InitValue eval_property(Evaluator* e, const char* owner, const char* field) {
+    TypeInfo* info = &e->info;
+    if (strcmp(owner, "collision") == 0) {
+        if (strcmp(field, "type") == 0) {
+            return (InitValue){info->shape == SHAPE_RECT ? "COLLISION_RECT" :
+                               info->shape == SHAPE_CIRC ? "COLLISION_CIRC" : "COLLISION_NONE", 0, true};
+        }
+        if (strcmp(field, "width") == 0 || strcmp(field, "radius") == 0) return number(info->width, false);
+        if (strcmp(field, "height") == 0) return number(info->height, false);
+    } else if (strcmp(owner, "renderable") == 0 && strcmp(field, "current_sprite_id") == 0) {
+        if (!info->has_sprite) return (InitValue){"SPRITE_NONE", 0, true};
+        return (InitValue){info->sprite, info->sprite_number, true};
+    }
+    fail(e, "Only collision.type, width, height, radius and renderable.current_sprite_id can be used here.");
+    return number(0, true);
+}
+
+static InitValue eval_expr(Evaluator* e, Expr* expr) {
+    switch (expr->type) {
+        case EXPR_LITERAL:
+            if (expr->as.literal.value.type == LITERAL_NUMBER) {
+                return number(expr->as.literal.value.as.number, expr->as.literal.integer);
+            }
+            if (expr->as.literal.value.type == LITERAL_BOOLEAN) {
+                return number(expr->as.literal.value.as.boolean, true);
+            }
+            fail(e, "Strings cannot be used here.");
+            break;
+        case EXPR_GROUPING:
+            return eval_expr(e, expr->as.grouping.expression);
+        case EXPR_UNARY: {
+            InitValue value = eval_expr(e, expr->as.unary.right);
+            double x = numeric(e, value);
+            if (expr->as.unary.oprt.type == TOKEN_MINUS) return number(-x, value.integer);
+            return number(x == 0, true);
+        }
+        case EXPR_BINARY:
+            return eval_binary(e, expr);
+        case EXPR_VARIABLE: {
+            const char* name = expr->as.variable.name.lexeme;
+            InitValue* local = find_local(e, name);
+            if (local) return *local;
+            if (is_constant_name(name)) return (InitValue){name, 0, true};
+            fail(e, "Only constants and locals can be used here.");
+            break;
+        }
+        case EXPR_GET:
+            if (expr->as.get.object->type == EXPR_VARIABLE) {
+                return eval_property(e, expr->as.get.object->as.variable.name.lexeme, expr->as.get.name.lexeme);
+            }
+            fail(e, "Only constants and locals can be used here.");
+            break;
+        default:
+            fail(e, "Init blocks can only hold constant expressions.");
+            break;
+    }
+    return number(0, true);
+}
+
+static void set_property(Evaluator* e, Expr* set) {
+    TypeInfo* info = &e->info;
+    Expr* object = set->as.set.object;
+    const char* owner = object->type == EXPR_VARIABLE ? object->as.variable.name.lexeme : "";
+    const char* field = set->as.set.name.lexeme;
+    InitValue value = eval_expr(e, set->as.set.value);
+
+    if (strcmp(owner, "collision") == 0 && strcmp(field, "type") == 0) {
+        if (value.name && strcmp(value.name, "COLLISION_RECT") == 0) info->shape = SHAPE_RECT;
+        else if (value.name && strcmp(value.name, "COLLISION_CIRC") == 0) info->shape = SHAPE_CIRC;
+        else if (value.name && strcmp(value.name, "COLLISION_NONE") == 0) info->shape = SHAPE_NONE;
+        else fail(e, "collision.type must be COLLISION_RECT, COLLISION_CIRC or COLLISION_NONE.");
+    } else if (strcmp(owner, "collision") == 0 && (strcmp(field, "width") == 0 || strcmp(field, "radius") == 0)) {
+        info->width = (float)numeric(e, value);
+    } else if (strcmp(owner, "collision") == 0 && strcmp(field, "height") == 0) {
+        info->height = (float)numeric(e, value);
+    } else if (strcmp(owner, "renderable") == 0 && strcmp(field, "current_sprite_id") == 0) {
+        info->has_sprite = true;
+        info->sprite = value.name;
+        info->sprite_number = (int)value.number;
+    } else {
+        fail(e, "Only collision.type, width, height, radius and renderable.current_sprite_id can be set here.");
+    }
+}
+
+static void exec_stmt(Evaluator* e, Stmt* stmt) {
+    if (!stmt) return;
+    if (stmt->line > 0) e->line = stmt->line;
+
+    switch (stmt->type) {
+        case STMT_EXPRESSION: {
+            Expr* expr = stmt->as.expr.expr;
+            if (expr->type == EXPR_SET) {
+                set_property(e, expr);
+            } else if (expr->type == EXPR_ASSIGN) {
+                set_local(e, expr->as.assign.name.lexeme, eval_expr(e, expr->as.assign.value));
+            } else {
+                fail(e, "Only assignments can be made here.");
+            }
+            break;
+        }
+        case STMT_VAR: {
+            InitValue value = stmt->as.var.initializer ? eval_expr(e, stmt->as.var.initializer) : number(0, true);
+            if (stmt->as.var.type == TYPE_INT) value = number((double)(long long)numeric(e, value), true);
+            if (stmt->as.var.type == TYPE_FLOAT) value.integer = false;
+            set_local(e, stmt->as.var.name.lexeme, value);
+            break;
+        }
+        case STMT_BLOCK:
+            for (int i = 0; i < stmt->as.block.count; i++) {
+                exec_stmt(e, stmt->as.block.statements[i]);
+            }
+            break;
+        case STMT_IF:
+            if (numeric(e, eval_expr(e, stmt->as.if_stmt.condition)) != 0) {
+                exec_stmt(e, stmt->as.if_stmt.then_branch);
+            } else {
+                exec_stmt(e, stmt->as.if_stmt.else_branch);
+            }
+            break;
+        default:
+            fail(e, "Init blocks cannot loop or print.");
+            break;
+    }
+}
+
+TypeInfo type_info_evaluate(EntityDecl* entity) {
+    Evaluator e = {0};
+    e.entity = entity;
+    e.line = entity->name.line;
+    exec_stmt(&e, entity->init);
+    return e.info;
+}
@@ -0,0 +1,30 @@
+#ifndef TYPEINFO_H
+#define TYPEINFO_H
+
+#include <stdbool.h>
+#include "entity_ast.h"
+
+typedef enum {
+    SHAPE_NONE,
+    SHAPE_RECT,
+    SHAPE_CIRC
+} ShapeKind;
+
+// An entity type's static metadata, as its init block sets it up.
+typedef struct {
+    ShapeKind shape;
+    float width;         // the radius, for circles
+    float height;
+    bool has_sprite;     // renderable.current_sprite_id is set:
+    const char* sprite;  // to an engine constant,
+    int sprite_number;   // or to a number, when sprite is NULL
+} TypeInfo;
+
+// Evaluates an init block at compile time. It may assign collision.type,
+// collision.width, collision.height, collision.radius and
+// renderable.current_sprite_id, declare locals, and branch on constant
+// conditions; values are constant arithmetic over numbers, those locals and
+// what it has already set. Anything else is reported as an error.
+TypeInfo type_info_evaluate(EntityDecl* entity);
+
+#endif
@@ -0,0 +1,14 @@
+#include "types.h"
+
+const char* field_type_name(FieldType type) {
+    switch (type) {
+        case TYPE_FLOAT: return "float";
+        case TYPE_INT: return "int";
+        case TYPE_BOOL: return "bool";
+        case TYPE_UINT32: return "uint32";
+        case TYPE_STRING: return "string";
+        case TYPE_VOID: return "void";
+        case TYPE_UNKNOWN: return "unknown";
+    }
+    return "unknown";
+}
@@ -0,0 +1,17 @@
+#ifndef TYPES_H
+#define TYPES_H
+
+// Types of entity fields, locals and (after type checking) expressions.
+typedef enum {
+    TYPE_FLOAT,
+    TYPE_INT,
+    TYPE_BOOL,
+    TYPE_UINT32,
+    TYPE_STRING,
+    TYPE_VOID,   // result of a call that returns nothing
+    TYPE_UNKNOWN // not declared or not inferred (yet)
+} FieldType;
+
+const char* field_type_name(FieldType type);
+
+#endif
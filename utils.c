@@ -1,6 +1,7 @@
 #include "utils.h"
 #include "error.h"
 #include <string.h>
+#include <stdio.h>
 
 char* my_strndup(const char* s, size_t n) {
     char* result = malloc(n + 1);
@@ -10,4 +11,37 @@ char* my_strndup(const char* s, size_t n) {
     memcpy(result, s, n);
     result[n] = '\0';
     return result;
-}
\ No newline at end of file
+}
+
+uint64_t hash_bytes(const char* data, size_t n) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < n; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+char* read_all_bytes(const char* script) {
+    FILE* file = fopen(script, "rb");
+
+    if (!file) {
+        error(error_messages[ERROR_FILELOAD].message);
+    }
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* file_content_buffer = malloc( file_size + 1); // null terminator
+
+    //malloc can fail so
+    if (!file_content_buffer) {
+        fclose(file);
+        error(error_messages[ERROR_MALLOCFAIL].message);
+    }
+
+    size_t bytes_read = fread(file_content_buffer, 1, file_size, file);
+    file_content_buffer[bytes_read] = '\0';
+
+    fclose(file);
+    return file_content_buffer;
+}
@@ -1,7 +1,10 @@
 #ifndef UTILS_H
 #define UTILS_H
 #include <stdlib.h>
+#include <stdint.h>
 
 char* my_strndup(const char* s, size_t n);
+uint64_t hash_bytes(const char* data, size_t n); // FNV-1a
+char* read_all_bytes(const char* script);
 
 #endif